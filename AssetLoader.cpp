@@ -0,0 +1,372 @@
+#include "AssetLoader.h"
+#include "Profiler.h"
+#include "JobSystem.h"
+#include "Mesh.h"
+#include "SimpleShader.h"
+#include "DDSTextureLoader.h"
+#include <wincodec.h>
+#include <fstream>
+#include <stdio.h>
+
+#pragma comment(lib, "windowscodecs.lib")
+
+using namespace DirectX;
+
+static const char* assetTypeNames[] = { "Textures", "DDS", "Shaders", "Meshes" };
+
+AssetLoader::AssetLoader(ID3D11Device* device, ID3D11DeviceContext* context, JobSystem* jobs)
+{
+	this->device = device;
+	this->context = context;
+	this->jobs = jobs;
+
+	__int64 perfFreq;
+	QueryPerformanceFrequency((LARGE_INTEGER*)&perfFreq);
+	perfCounterSeconds = 1.0 / (double)perfFreq;
+
+	cpuWallSeconds = 0;
+	gpuSeconds = 0;
+	for (int i = 0; i < ASSET_TYPE_COUNT; i++)
+	{
+		cpuSecondsByType[i] = 0;
+		gpuSecondsByType[i] = 0;
+		countByType[i] = 0;
+	}
+}
+
+AssetLoader::~AssetLoader()
+{
+	for (unsigned int i = 0; i < requests.size(); i++)
+	{
+		if (requests[i]->Blob)
+			requests[i]->Blob->Release();
+		delete requests[i];
+	}
+}
+
+double AssetLoader::Now()
+{
+	__int64 now;
+	QueryPerformanceCounter((LARGE_INTEGER*)&now);
+	return now * perfCounterSeconds;
+}
+
+AssetLoader::AssetRequest* AssetLoader::AddRequest(AssetType type)
+{
+	AssetRequest* r = new AssetRequest();
+	r->Type = type;
+	r->SRV = 0;
+	r->Shader = 0;
+	r->MeshResult = 0;
+	r->KeepCPUCopy = false;
+	r->Loaded = false;
+	r->Width = 0;
+	r->Height = 0;
+	r->Blob = 0;
+	r->CPUSeconds = 0;
+
+	requests.push_back(r);
+	return r;
+}
+
+void AssetLoader::LoadTexture(const wchar_t* file, ID3D11ShaderResourceView** srv)
+{
+	AssetRequest* r = AddRequest(ASSET_TEXTURE);
+	r->WideFile = file;
+	r->SRV = srv;
+}
+
+void AssetLoader::LoadDDSTexture(const wchar_t* file, ID3D11ShaderResourceView** srv)
+{
+	AssetRequest* r = AddRequest(ASSET_DDS);
+	r->WideFile = file;
+	r->SRV = srv;
+}
+
+void AssetLoader::LoadShader(const wchar_t* file, ISimpleShader* shader)
+{
+	AssetRequest* r = AddRequest(ASSET_SHADER);
+	r->WideFile = file;
+	r->Shader = shader;
+}
+
+void AssetLoader::LoadMesh(const char* file, Mesh** mesh, bool keepCPUCopy)
+{
+	AssetRequest* r = AddRequest(ASSET_MESH);
+	r->File = file;
+	r->MeshResult = mesh;
+	r->KeepCPUCopy = keepCPUCopy;
+}
+
+// --------------------------------------------------------
+// Runs every CPU half (in parallel if we have workers),
+// then creates the GPU resources in request order
+// --------------------------------------------------------
+void AssetLoader::Finish()
+{
+	PROFILE_FUNCTION();
+
+	double start = Now();
+
+	if (jobs)
+	{
+		JobCounter counter;
+		for (unsigned int i = 0; i < requests.size(); i++)
+		{
+			AssetRequest* r = requests[i];
+			jobs->Run([this, r]() { LoadCPU(r); }, &counter);
+		}
+
+		// Don't help out here - a big decode would stall the
+		// message pump, which is the whole point of loading async
+		while (counter.Value > 0)
+		{
+			PumpMessages();
+			MsgWaitForMultipleObjects(0, 0, FALSE, 1, QS_ALLINPUT);
+		}
+	}
+	else
+	{
+		for (unsigned int i = 0; i < requests.size(); i++)
+		{
+			LoadCPU(requests[i]);
+			PumpMessages();
+		}
+	}
+
+	double cpuDone = Now();
+	cpuWallSeconds = cpuDone - start;
+
+	// D3D11 resource creation happens here, on one thread
+	for (unsigned int i = 0; i < requests.size(); i++)
+	{
+		double gpuStart = Now();
+		CreateGPU(requests[i]);
+
+		AssetType type = requests[i]->Type;
+		countByType[type]++;
+		cpuSecondsByType[type] += requests[i]->CPUSeconds;
+		gpuSecondsByType[type] += Now() - gpuStart;
+	}
+
+	gpuSeconds = Now() - cpuDone;
+}
+
+// --------------------------------------------------------
+// Keeps the window alive while we wait on the workers.
+// A quit request is put back so the game loop sees it.
+// --------------------------------------------------------
+void AssetLoader::PumpMessages()
+{
+	MSG msg = {};
+	while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE))
+	{
+		if (msg.message == WM_QUIT)
+		{
+			PostQuitMessage((int)msg.wParam);
+			return;
+		}
+
+		TranslateMessage(&msg);
+		DispatchMessage(&msg);
+	}
+}
+
+// --------------------------------------------------------
+// The thread-safe half of a load.  No D3D calls in here!
+// --------------------------------------------------------
+void AssetLoader::LoadCPU(AssetRequest* r)
+{
+	PROFILE_FUNCTION();
+
+	double start = Now();
+
+	switch (r->Type)
+	{
+	case ASSET_TEXTURE:
+		r->Loaded = DecodeImage(r);
+		break;
+
+	case ASSET_DDS:
+		r->Loaded = ReadWholeFile(r);
+		break;
+
+	case ASSET_SHADER:
+		r->Loaded = D3DReadFileToBlob(r->WideFile.c_str(), &r->Blob) == S_OK;
+		break;
+
+	case ASSET_MESH:
+		r->Loaded = Mesh::LoadOBJ(r->File.c_str(), r->Vertices, r->Indices);
+		break;
+	}
+
+	r->CPUSeconds = Now() - start;
+}
+
+// --------------------------------------------------------
+// Decodes an image file to 32-bit RGBA pixels with WIC
+// --------------------------------------------------------
+bool AssetLoader::DecodeImage(AssetRequest* r)
+{
+	// WIC needs COM on whichever thread we happen to be on
+	HRESULT comResult = CoInitializeEx(0, COINIT_MULTITHREADED);
+
+	IWICImagingFactory* factory = 0;
+	IWICBitmapDecoder* decoder = 0;
+	IWICBitmapFrameDecode* frame = 0;
+	IWICFormatConverter* converter = 0;
+
+	HRESULT hr = CoCreateInstance(CLSID_WICImagingFactory, 0, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&factory));
+	if (SUCCEEDED(hr))
+		hr = factory->CreateDecoderFromFilename(r->WideFile.c_str(), 0, GENERIC_READ, WICDecodeMetadataCacheOnDemand, &decoder);
+	if (SUCCEEDED(hr))
+		hr = decoder->GetFrame(0, &frame);
+	if (SUCCEEDED(hr))
+		hr = factory->CreateFormatConverter(&converter);
+	if (SUCCEEDED(hr))
+		hr = converter->Initialize(frame, GUID_WICPixelFormat32bppRGBA, WICBitmapDitherTypeNone, 0, 0.0, WICBitmapPaletteTypeCustom);
+	if (SUCCEEDED(hr))
+		hr = converter->GetSize(&r->Width, &r->Height);
+	if (SUCCEEDED(hr))
+	{
+		UINT pitch = r->Width * 4;
+		r->Bytes.resize(pitch * r->Height);
+		hr = converter->CopyPixels(0, pitch, (UINT)r->Bytes.size(), &r->Bytes[0]);
+	}
+
+	if (converter) converter->Release();
+	if (frame) frame->Release();
+	if (decoder) decoder->Release();
+	if (factory) factory->Release();
+
+	if (comResult == S_OK || comResult == S_FALSE)
+		CoUninitialize();
+
+	return SUCCEEDED(hr);
+}
+
+bool AssetLoader::ReadWholeFile(AssetRequest* r)
+{
+	std::ifstream file(r->WideFile.c_str(), std::ios::binary | std::ios::ate);
+	if (!file.is_open())
+		return false;
+
+	std::streamoff size = file.tellg();
+	if (size <= 0)
+		return false;
+
+	r->Bytes.resize((size_t)size);
+	file.seekg(0);
+	file.read((char*)&r->Bytes[0], size);
+	return file.good();
+}
+
+// --------------------------------------------------------
+// The D3D half of a load.  Must run on the thread that
+// owns the immediate context.
+// --------------------------------------------------------
+void AssetLoader::CreateGPU(AssetRequest* r)
+{
+	PROFILE_FUNCTION();
+
+	switch (r->Type)
+	{
+	case ASSET_TEXTURE:
+	{
+		// Missing textures become plain white rather than
+		// a null SRV, so they still draw (and release) fine
+		if (!r->Loaded)
+		{
+			printf("Failed to load texture %ls - using white\n", r->WideFile.c_str());
+			r->Width = 1;
+			r->Height = 1;
+			r->Bytes.assign(4, 255);
+		}
+
+		// Mips are generated on the GPU, same as the WIC loader does
+		D3D11_TEXTURE2D_DESC desc = {};
+		desc.Width = r->Width;
+		desc.Height = r->Height;
+		desc.MipLevels = 0;
+		desc.ArraySize = 1;
+		desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+		desc.SampleDesc.Count = 1;
+		desc.Usage = D3D11_USAGE_DEFAULT;
+		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_RENDER_TARGET;
+		desc.MiscFlags = D3D11_RESOURCE_MISC_GENERATE_MIPS;
+
+		ID3D11Texture2D* texture = 0;
+		if (FAILED(device->CreateTexture2D(&desc, 0, &texture)))
+		{
+			*r->SRV = 0;
+			break;
+		}
+
+		context->UpdateSubresource(texture, 0, 0, &r->Bytes[0], r->Width * 4, 0);
+
+		D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+		srvDesc.Format = desc.Format;
+		srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+		srvDesc.Texture2D.MipLevels = (UINT)-1;
+		device->CreateShaderResourceView(texture, &srvDesc, r->SRV);
+		context->GenerateMips(*r->SRV);
+
+		texture->Release();
+		break;
+	}
+
+	case ASSET_DDS:
+		*r->SRV = 0;
+		if (!r->Loaded || FAILED(CreateDDSTextureFromMemory(device, &r->Bytes[0], r->Bytes.size(), 0, r->SRV)))
+			printf("Failed to load texture %ls\n", r->WideFile.c_str());
+		break;
+
+	case ASSET_SHADER:
+		if (!r->Loaded || !r->Shader->LoadShaderBlob(r->Blob))
+			printf("Failed to load shader %ls\n", r->WideFile.c_str());
+		break;
+
+	case ASSET_MESH:
+		if (r->Loaded)
+		{
+			*r->MeshResult = new Mesh(r->Vertices, r->Indices, device, r->KeepCPUCopy);
+		}
+		else
+		{
+			*r->MeshResult = 0;
+			printf("Failed to load mesh %s\n", r->File.c_str());
+		}
+		break;
+	}
+
+	// Done with the CPU copies
+	std::vector<unsigned char>().swap(r->Bytes);
+	std::vector<Vertex>().swap(r->Vertices);
+	std::vector<unsigned int>().swap(r->Indices);
+}
+
+// --------------------------------------------------------
+// Prints where the startup time went.  "CPU" is the sum of
+// the work done across all threads, so with workers it can
+// be (much) larger than the wall time spent waiting on it.
+// --------------------------------------------------------
+void AssetLoader::PrintTimings()
+{
+	double cpuTotal = 0;
+	for (int i = 0; i < ASSET_TYPE_COUNT; i++)
+		cpuTotal += cpuSecondsByType[i];
+
+	printf("Asset loading (%s):\n", jobs ? "async" : "serial");
+	for (int i = 0; i < ASSET_TYPE_COUNT; i++)
+	{
+		if (countByType[i] == 0)
+			continue;
+
+		printf("  %-8s x%-2u  CPU %7.1fms  GPU %6.1fms\n",
+			assetTypeNames[i], countByType[i],
+			cpuSecondsByType[i] * 1000.0, gpuSecondsByType[i] * 1000.0);
+	}
+	printf("  CPU work %.1fms, waited %.1fms, GPU creation %.1fms, total %.1fms\n",
+		cpuTotal * 1000.0, cpuWallSeconds * 1000.0, gpuSeconds * 1000.0,
+		(cpuWallSeconds + gpuSeconds) * 1000.0);
+}
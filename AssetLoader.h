@@ -0,0 +1,97 @@
+#pragma once
+
+#include <Windows.h>
+#include <d3d11.h>
+#include <string>
+#include <vector>
+#include "Vertex.h"
+
+class ISimpleShader;
+class Mesh;
+class JobSystem;
+
+// --------------------------------------------------------
+// Batches up startup asset loads and splits each one into
+// a CPU half (file read, image decode, OBJ parse) and a GPU
+// half (creating the D3D objects).
+//
+// The CPU halves run on the job system's workers; the GPU
+// halves run afterwards on the calling thread, in the order
+// the loads were requested.  With no job system everything
+// runs serially, which is handy for comparing timings.
+// --------------------------------------------------------
+class AssetLoader
+{
+public:
+	AssetLoader(ID3D11Device* device, ID3D11DeviceContext* context, JobSystem* jobs);
+	~AssetLoader();
+
+	// Queue a load.  Results are written through the given
+	// pointer once Finish() returns.
+	void LoadTexture(const wchar_t* file, ID3D11ShaderResourceView** srv);
+	void LoadDDSTexture(const wchar_t* file, ID3D11ShaderResourceView** srv);
+	void LoadShader(const wchar_t* file, ISimpleShader* shader);
+	void LoadMesh(const char* file, Mesh** mesh, bool keepCPUCopy = false);
+
+	// Does all of the queued work, keeping the window
+	// responsive while the workers are busy
+	void Finish();
+
+	// Prints where the startup time went
+	void PrintTimings();
+
+private:
+	enum AssetType
+	{
+		ASSET_TEXTURE,
+		ASSET_DDS,
+		ASSET_SHADER,
+		ASSET_MESH,
+		ASSET_TYPE_COUNT
+	};
+
+	struct AssetRequest
+	{
+		AssetType Type;
+		std::wstring WideFile;
+		std::string File;
+
+		// Where the result goes
+		ID3D11ShaderResourceView** SRV;
+		ISimpleShader* Shader;
+		Mesh** MeshResult;
+		bool KeepCPUCopy;
+
+		// CPU results, handed from the worker to the GPU half
+		bool Loaded;
+		std::vector<unsigned char> Bytes;	// RGBA pixels or raw file
+		unsigned int Width;
+		unsigned int Height;
+		ID3DBlob* Blob;
+		std::vector<Vertex> Vertices;
+		std::vector<unsigned int> Indices;
+		double CPUSeconds;
+	};
+
+	ID3D11Device* device;
+	ID3D11DeviceContext* context;
+	JobSystem* jobs;
+
+	std::vector<AssetRequest*> requests;
+
+	// Timing info for PrintTimings()
+	double perfCounterSeconds;
+	double cpuWallSeconds;
+	double gpuSeconds;
+	double cpuSecondsByType[ASSET_TYPE_COUNT];
+	double gpuSecondsByType[ASSET_TYPE_COUNT];
+	unsigned int countByType[ASSET_TYPE_COUNT];
+
+	AssetRequest* AddRequest(AssetType type);
+	void LoadCPU(AssetRequest* request);
+	void CreateGPU(AssetRequest* request);
+	bool DecodeImage(AssetRequest* request);
+	bool ReadWholeFile(AssetRequest* request);
+	void PumpMessages();
+	double Now();
+};
@@ -37,13 +37,18 @@ void Camera::SetRotation(float xRot, float yRot)
 
 void Camera::Update(float deltaTime)
 {
+	currentView = BuildViewMatrix(position, xRot, yRot);
+}
 
+XMFLOAT4X4 Camera::BuildViewMatrix(XMFLOAT3 position, float xRot, float yRot)
+{
 	XMVECTOR quat = XMQuaternionRotationRollPitchYaw(xRot, yRot, 0);
 
 	XMVECTOR dir = XMVector3Rotate(XMVectorSet(0, 0, 1, 0), quat);
 
-	 XMStoreFloat4x4(&currentView, XMMatrixTranspose(XMMatrixLookToLH(XMLoadFloat3(&position), dir, XMVectorSet(0, 1, 0, 0))));
-
+	XMFLOAT4X4 view;
+	XMStoreFloat4x4(&view, XMMatrixTranspose(XMMatrixLookToLH(XMLoadFloat3(&position), dir, XMVectorSet(0, 1, 0, 0))));
+	return view;
 }
 
 void Camera::UpdateProjectionMatrix(int width, int height)
@@ -76,4 +81,3 @@ float Camera::GetRotationY()
 	return yRot;
 }
 
-
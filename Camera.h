@@ -24,6 +24,9 @@ public:
 	DirectX::XMFLOAT4X4 projectionMatrix;
 	Camera(int width, int height);
 
+	// Transposed (HLSL-ready) view matrix for a position and pitch/yaw
+	static DirectX::XMFLOAT4X4 BuildViewMatrix(DirectX::XMFLOAT3 position, float xRot, float yRot);
+
 private:
 
 	
@@ -0,0 +1,204 @@
+#include "CommandBuffer.h"
+#include <atomic>
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+
+CommandBuffer::CommandBuffer()
+{
+	commandCount = 0;
+}
+
+void CommandBuffer::Reset()
+{
+	data.clear();
+	commandCount = 0;
+}
+
+// --------------------------------------------------------
+// Makes room for a header plus payload at the end of the
+// stream and fills in the header
+// --------------------------------------------------------
+void* CommandBuffer::Append(CommandType type, unsigned int payloadSize)
+{
+	unsigned int size = (sizeof(CommandHeader) + payloadSize + Alignment - 1) & ~(Alignment - 1);
+
+	size_t offset = data.size();
+	data.resize(offset + size);
+
+	CommandHeader* header = (CommandHeader*)&data[offset];
+	header->Type = type;
+	header->Size = size;
+
+	commandCount++;
+	return header + 1;
+}
+
+void CommandBuffer::SetPipeline(CommandHandle inputLayout, CommandHandle vertexShader, CommandHandle pixelShader)
+{
+	SetPipelineCommand* command = (SetPipelineCommand*)Append(COMMAND_SET_PIPELINE, sizeof(SetPipelineCommand));
+	command->InputLayout = inputLayout;
+	command->VertexShader = vertexShader;
+	command->PixelShader = pixelShader;
+}
+
+void CommandBuffer::SetRenderState(CommandHandle blend, CommandHandle depthStencil, CommandHandle rasterizer, unsigned int stencilRef)
+{
+	SetRenderStateCommand* command = (SetRenderStateCommand*)Append(COMMAND_SET_RENDER_STATE, sizeof(SetRenderStateCommand));
+	command->Blend = blend;
+	command->DepthStencil = depthStencil;
+	command->Rasterizer = rasterizer;
+	command->StencilRef = stencilRef;
+}
+
+void CommandBuffer::SetVertexBuffer(unsigned int slot, CommandHandle buffer, unsigned int stride, unsigned int offset)
+{
+	SetVertexBufferCommand* command = (SetVertexBufferCommand*)Append(COMMAND_SET_VERTEX_BUFFER, sizeof(SetVertexBufferCommand));
+	command->Buffer = buffer;
+	command->Slot = slot;
+	command->Stride = stride;
+	command->Offset = offset;
+}
+
+void CommandBuffer::SetIndexBuffer(CommandHandle buffer, unsigned int offset)
+{
+	SetIndexBufferCommand* command = (SetIndexBufferCommand*)Append(COMMAND_SET_INDEX_BUFFER, sizeof(SetIndexBufferCommand));
+	command->Buffer = buffer;
+	command->Offset = offset;
+}
+
+unsigned char* CommandBuffer::SetConstants(CommandStage stage, unsigned int slot, const void* constants, unsigned int size)
+{
+	SetConstantsCommand* command = (SetConstantsCommand*)Append(COMMAND_SET_CONSTANTS, sizeof(SetConstantsCommand) + size);
+	command->Stage = stage;
+	command->Slot = slot;
+	command->Size = size;
+
+	unsigned char* dest = (unsigned char*)(command + 1);
+	if (constants)
+		memcpy(dest, constants, size);
+	return dest;
+}
+
+void CommandBuffer::SetConstantBuffer(CommandStage stage, unsigned int slot, CommandHandle buffer)
+{
+	SetConstantBufferCommand* command = (SetConstantBufferCommand*)Append(COMMAND_SET_CONSTANT_BUFFER, sizeof(SetConstantBufferCommand));
+	command->Buffer = buffer;
+	command->Stage = stage;
+	command->Slot = slot;
+}
+
+void CommandBuffer::SetTexture(CommandStage stage, unsigned int slot, CommandHandle texture)
+{
+	SetTextureCommand* command = (SetTextureCommand*)Append(COMMAND_SET_TEXTURE, sizeof(SetTextureCommand));
+	command->Texture = texture;
+	command->Stage = stage;
+	command->Slot = slot;
+}
+
+void CommandBuffer::SetSampler(CommandStage stage, unsigned int slot, CommandHandle sampler)
+{
+	SetSamplerCommand* command = (SetSamplerCommand*)Append(COMMAND_SET_SAMPLER, sizeof(SetSamplerCommand));
+	command->Sampler = sampler;
+	command->Stage = stage;
+	command->Slot = slot;
+}
+
+void CommandBuffer::DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex)
+{
+	DrawIndexedInstanced(indexCount, 1, startIndex, baseVertex, 0);
+}
+
+void CommandBuffer::DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int startIndex, int baseVertex, unsigned int startInstance)
+{
+	DrawIndexedCommand* command = (DrawIndexedCommand*)Append(COMMAND_DRAW_INDEXED, sizeof(DrawIndexedCommand));
+	command->IndexCount = indexCount;
+	command->StartIndex = startIndex;
+	command->BaseVertex = baseVertex;
+	command->InstanceCount = instanceCount;
+	command->StartInstance = startInstance;
+}
+
+bool CommandBuffer::Read(size_t& offset, const CommandHeader*& header, const void*& payload) const
+{
+	if (offset + sizeof(CommandHeader) > data.size())
+		return false;
+
+	header = (const CommandHeader*)&data[offset];
+	payload = header + 1;
+	offset += header->Size;
+	return true;
+}
+
+// --------------------------------------------------------
+// Each draw is what Entity records for a plain material:
+// pipeline, vertex and index buffers, a world matrix and
+// uv scale, four textures, a sampler and the draw itself.
+// The handles are made up, since nothing plays them back.
+// --------------------------------------------------------
+void CommandBuffer::RunBenchmark(unsigned int threadCount, unsigned int drawsPerThread)
+{
+	const int runs = 10;
+	const unsigned int commandsPerDraw = 10;
+
+	std::vector<double> seconds(threadCount, 0.0);
+	std::vector<size_t> bytes(threadCount, 0);
+	std::atomic<unsigned int> ready(0);
+
+	std::vector<std::thread> threads;
+	for (unsigned int t = 0; t < threadCount; t++)
+	{
+		threads.push_back(std::thread([&, t]()
+		{
+			CommandBuffer commands;
+			float constants[20] = {};
+
+			// Start everyone at once so they really overlap
+			ready++;
+			while (ready < threadCount)
+				std::this_thread::yield();
+
+			for (int r = 0; r < runs; r++)
+			{
+				std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+				commands.Reset();
+				for (unsigned int i = 0; i < drawsPerThread; i++)
+				{
+					uintptr_t id = (i & 15) + 1;
+					commands.SetPipeline((CommandHandle)(id * 16), (CommandHandle)(id * 32), (CommandHandle)(id * 48));
+					commands.SetVertexBuffer(0, (CommandHandle)(id * 64), 44);
+					commands.SetIndexBuffer((CommandHandle)(id * 80));
+
+					unsigned char* dest = commands.SetConstants(COMMAND_STAGE_VERTEX, 1, constants, sizeof(constants));
+					memcpy(dest, &i, sizeof(i));
+
+					for (unsigned int s = 0; s < 4; s++)
+						commands.SetTexture(COMMAND_STAGE_PIXEL, s, (CommandHandle)(id * 96 + s));
+					commands.SetSampler(COMMAND_STAGE_PIXEL, 0, (CommandHandle)(id * 112));
+					commands.DrawIndexed(36);
+				}
+
+				seconds[t] += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			}
+
+			bytes[t] = commands.GetSize();
+		}));
+	}
+
+	for (unsigned int t = 0; t < threadCount; t++)
+		threads[t].join();
+
+	double commandsPerThread = (double)drawsPerThread * commandsPerDraw * runs;
+	double total = 0;
+
+	printf("Command recording, %u threads x %u draws (average of %d runs):\n", threadCount, drawsPerThread, runs);
+	for (unsigned int t = 0; t < threadCount; t++)
+	{
+		double rate = commandsPerThread / seconds[t];
+		total += rate;
+		printf("  Thread %u: %.1fM commands/sec, %.1fKB per buffer\n", t, rate / 1000000.0, bytes[t] / 1024.0);
+	}
+	printf("  Total:    %.1fM commands/sec\n", total / 1000000.0);
+}
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// --------------------------------------------------------
+// Whatever the backend uses for a resource (for D3D11, the
+// ID3D11* pointer itself).  The command buffer never looks
+// inside one.
+// --------------------------------------------------------
+typedef const void* CommandHandle;
+
+enum CommandStage
+{
+	COMMAND_STAGE_VERTEX,
+	COMMAND_STAGE_PIXEL,
+	COMMAND_STAGE_COUNT
+};
+
+enum CommandType
+{
+	COMMAND_SET_PIPELINE,
+	COMMAND_SET_RENDER_STATE,
+	COMMAND_SET_VERTEX_BUFFER,
+	COMMAND_SET_INDEX_BUFFER,
+	COMMAND_SET_CONSTANTS,
+	COMMAND_SET_CONSTANT_BUFFER,
+	COMMAND_SET_TEXTURE,
+	COMMAND_SET_SAMPLER,
+	COMMAND_DRAW_INDEXED,
+	COMMAND_TYPE_COUNT
+};
+
+// --------------------------------------------------------
+// Every command starts with one of these.  Size covers the
+// header, the command and any data after it, so a reader
+// can skip commands it doesn't care about.
+// --------------------------------------------------------
+struct CommandHeader
+{
+	uint32_t Type;
+	uint32_t Size;
+};
+
+struct SetPipelineCommand
+{
+	CommandHandle InputLayout;
+	CommandHandle VertexShader;
+	CommandHandle PixelShader;
+};
+
+// Zero handles put back the backend's defaults
+struct SetRenderStateCommand
+{
+	CommandHandle Blend;
+	CommandHandle DepthStencil;
+	CommandHandle Rasterizer;
+	uint32_t StencilRef;
+};
+
+struct SetVertexBufferCommand
+{
+	CommandHandle Buffer;
+	uint32_t Slot;
+	uint32_t Stride;
+	uint32_t Offset;
+};
+
+// Indices are always 32-bit
+struct SetIndexBufferCommand
+{
+	CommandHandle Buffer;
+	uint32_t Offset;
+};
+
+// Followed by Size bytes of constants
+struct SetConstantsCommand
+{
+	uint32_t Stage;
+	uint32_t Slot;
+	uint32_t Size;
+};
+
+// Binds a buffer someone else keeps filled (the per-frame
+// constants), rather than copying constants into the stream
+struct SetConstantBufferCommand
+{
+	CommandHandle Buffer;
+	uint32_t Stage;
+	uint32_t Slot;
+};
+
+struct SetTextureCommand
+{
+	CommandHandle Texture;
+	uint32_t Stage;
+	uint32_t Slot;
+};
+
+struct SetSamplerCommand
+{
+	CommandHandle Sampler;
+	uint32_t Stage;
+	uint32_t Slot;
+};
+
+struct DrawIndexedCommand
+{
+	uint32_t IndexCount;
+	uint32_t StartIndex;
+	int32_t BaseVertex;
+	uint32_t InstanceCount;
+	uint32_t StartInstance;
+};
+
+// --------------------------------------------------------
+// A flat stream of rendering commands that doesn't know
+// about any graphics API, so recording is just appending
+// bytes - no device, no context, no locks.  Give each
+// thread its own buffer and they can all record at once;
+// a backend (see D3D11RenderDevice) then plays them back
+// in order.  Draws are always indexed triangle lists.
+//
+// Only uses the standard library, so it builds and runs
+// anywhere (RunBenchmark() included).
+// --------------------------------------------------------
+class CommandBuffer
+{
+public:
+	CommandBuffer();
+
+	// Empties the buffer but keeps its memory
+	void Reset();
+
+	void SetPipeline(CommandHandle inputLayout, CommandHandle vertexShader, CommandHandle pixelShader);
+	void SetRenderState(CommandHandle blend, CommandHandle depthStencil, CommandHandle rasterizer, unsigned int stencilRef = 0);
+	void SetVertexBuffer(unsigned int slot, CommandHandle buffer, unsigned int stride, unsigned int offset = 0);
+	void SetIndexBuffer(CommandHandle buffer, unsigned int offset = 0);
+	void SetConstantBuffer(CommandStage stage, unsigned int slot, CommandHandle buffer);
+	void SetTexture(CommandStage stage, unsigned int slot, CommandHandle texture);
+	void SetSampler(CommandStage stage, unsigned int slot, CommandHandle sampler);
+	void DrawIndexed(unsigned int indexCount, unsigned int startIndex = 0, int baseVertex = 0);
+	void DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int startIndex = 0, int baseVertex = 0, unsigned int startInstance = 0);
+
+	// Copies size bytes of constants into the stream (data can
+	// be null) and returns where they went, so the caller can
+	// patch individual values.  The pointer is only good until
+	// the next command is recorded.
+	unsigned char* SetConstants(CommandStage stage, unsigned int slot, const void* data, unsigned int size);
+
+	// Walks the commands in order.  Start with offset 0; returns
+	// false once there are no more.  payload points just past
+	// the header.
+	bool Read(size_t& offset, const CommandHeader*& header, const void*& payload) const;
+
+	size_t GetSize() const { return data.size(); }
+	unsigned int GetCommandCount() const { return commandCount; }
+
+	// Records a typical frame's worth of draws on each of
+	// threadCount threads at once and prints the commands
+	// recorded per second per thread
+	static void RunBenchmark(unsigned int threadCount, unsigned int drawsPerThread);
+
+private:
+	// Every command starts on this boundary
+	static const unsigned int Alignment = 8;
+
+	std::vector<unsigned char> data;
+	unsigned int commandCount;
+
+	void* Append(CommandType type, unsigned int payloadSize);
+};
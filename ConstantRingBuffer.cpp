@@ -0,0 +1,88 @@
+#include "ConstantRingBuffer.h"
+#include <string.h>
+
+bool ConstantRingBuffer::IsSupported(ID3D11Device* device, ID3D11DeviceContext* context)
+{
+	D3D11_FEATURE_DATA_D3D11_OPTIONS options = {};
+	if (FAILED(device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options))) ||
+		!options.ConstantBufferOffsetting)
+		return false;
+
+	// Binding at an offset needs the 11.1 context
+	ID3D11DeviceContext1* context1 = 0;
+	if (FAILED(context->QueryInterface(__uuidof(ID3D11DeviceContext1), (void**)&context1)))
+		return false;
+
+	context1->Release();
+	return true;
+}
+
+ConstantRingBuffer::ConstantRingBuffer(ID3D11Device* device, ID3D11DeviceContext* context, unsigned int size)
+{
+	this->context = context;
+	this->size = (size + Alignment - 1) & ~(Alignment - 1);
+	head = 0;
+	generation = 1;	// Zero means "never written"
+	discardNext = true;
+	stats = {};
+
+	D3D11_BUFFER_DESC desc = {};
+	desc.ByteWidth = this->size;
+	desc.Usage = D3D11_USAGE_DYNAMIC;
+	desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+	buffer = 0;
+	device->CreateBuffer(&desc, 0, &buffer);
+}
+
+ConstantRingBuffer::~ConstantRingBuffer()
+{
+	if (buffer) buffer->Release();
+}
+
+void ConstantRingBuffer::BeginFrame()
+{
+	discardNext = true;
+}
+
+void ConstantRingBuffer::ResetStats()
+{
+	stats = {};
+}
+
+bool ConstantRingBuffer::Write(const void* data, unsigned int dataSize, unsigned int& firstConstant, unsigned int& numConstants)
+{
+	unsigned int allocSize = (dataSize + Alignment - 1) & ~(Alignment - 1);
+	if (!buffer || allocSize > size)
+		return false;
+
+	// Out of room - start over in fresh memory
+	if (head + allocSize > size)
+		discardNext = true;
+
+	D3D11_MAP mapType = D3D11_MAP_WRITE_NO_OVERWRITE;
+	if (discardNext)
+	{
+		mapType = D3D11_MAP_WRITE_DISCARD;
+		head = 0;
+		generation++;
+		discardNext = false;
+		stats.Discards++;
+	}
+
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	if (FAILED(context->Map(buffer, 0, mapType, 0, &mapped)))
+		return false;
+
+	memcpy((unsigned char*)mapped.pData + head, data, dataSize);
+	context->Unmap(buffer, 0);
+
+	firstConstant = head / 16;
+	numConstants = allocSize / 16;
+	head += allocSize;
+
+	stats.Allocations++;
+	stats.Bytes += allocSize;
+	return true;
+}
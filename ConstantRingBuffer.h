@@ -0,0 +1,64 @@
+#pragma once
+
+#include <d3d11_1.h>
+
+struct ConstantRingStats
+{
+	unsigned int Allocations;
+	unsigned int Discards;		// Maps that started the ring over
+	unsigned long long Bytes;	// Including alignment padding
+};
+
+// --------------------------------------------------------
+// One big dynamic constant buffer that per-draw constants
+// are sub-allocated from, front to back.  Each piece is
+// bound with *SetConstantBuffers1 at its offset, so all of
+// the draws in a frame share one buffer instead of each
+// shader versioning its own with UpdateSubresource.
+//
+// The first write of a frame (or after the ring fills up)
+// maps with DISCARD; every other write maps with
+// NO_OVERWRITE, which never waits on the GPU since nothing
+// it could still be reading gets touched.
+//
+// Anything written before the latest discard is gone, so
+// callers hang on to GetGeneration() and rewrite their
+// data when it changes.
+//
+// Needs D3D 11.1 constant buffer offsetting - check
+// IsSupported() before creating one.
+// --------------------------------------------------------
+class ConstantRingBuffer
+{
+public:
+	static bool IsSupported(ID3D11Device* device, ID3D11DeviceContext* context);
+
+	ConstantRingBuffer(ID3D11Device* device, ID3D11DeviceContext* context, unsigned int size = 2 * 1024 * 1024);
+	~ConstantRingBuffer();
+
+	// Call once at the start of each frame
+	void BeginFrame();
+
+	// Copies data into the ring.  Returns where it went, in
+	// the 16-byte constants *SetConstantBuffers1 expects.
+	bool Write(const void* data, unsigned int size, unsigned int& firstConstant, unsigned int& numConstants);
+
+	ID3D11Buffer* GetBuffer() { return buffer; }
+	unsigned int GetGeneration() { return generation; }
+
+	const ConstantRingStats& GetStats() { return stats; }
+	void ResetStats();
+
+private:
+	// Offsets must be a multiple of 16 constants
+	static const unsigned int Alignment = 256;
+
+	ID3D11DeviceContext* context;
+	ID3D11Buffer* buffer;
+	unsigned int size;
+	unsigned int head;
+	unsigned int generation;
+	bool discardNext;
+
+	ConstantRingStats stats;
+};
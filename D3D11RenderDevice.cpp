@@ -0,0 +1,261 @@
+#include "D3D11RenderDevice.h"
+#include "Profiler.h"
+#include "ConstantRingBuffer.h"
+#include "StateCache.h"
+#include <string.h>
+
+static const ShaderStage stageMap[COMMAND_STAGE_COUNT] =
+{
+	SHADER_STAGE_VERTEX,
+	SHADER_STAGE_PIXEL,
+};
+
+D3D11RenderDevice::D3D11RenderDevice(ID3D11Device* device, ID3D11DeviceContext* context, ConstantRingBuffer* constantRing)
+{
+	this->device = device;
+	this->context = context;
+	this->constantRing = constantRing;
+	stateCache = StateCache::Get(context);
+}
+
+D3D11RenderDevice::~D3D11RenderDevice()
+{
+	for (size_t i = 0; i < constantBuffers.size(); i++)
+		constantBuffers[i].Buffer->Release();
+}
+
+// --------------------------------------------------------
+// Finds (or makes) one of our own constant buffers.  Two
+// slots with the same size each get their own, or the
+// second upload would overwrite the first while it's still
+// bound.  There are only a handful of combinations.
+// --------------------------------------------------------
+ID3D11Buffer* D3D11RenderDevice::GetConstantBuffer(unsigned int stage, unsigned int slot, unsigned int size)
+{
+	size = (size + 15) & ~15;
+	for (size_t i = 0; i < constantBuffers.size(); i++)
+	{
+		const ConstantBuffer& cb = constantBuffers[i];
+		if (cb.Stage == stage && cb.Slot == slot && cb.Size == size)
+			return cb.Buffer;
+	}
+
+	D3D11_BUFFER_DESC desc = {};
+	desc.ByteWidth = size;
+	desc.Usage = D3D11_USAGE_DEFAULT;
+	desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+
+	ConstantBuffer cb;
+	cb.Stage = stage;
+	cb.Slot = slot;
+	cb.Size = size;
+	cb.Buffer = 0;
+	if (FAILED(device->CreateBuffer(&desc, 0, &cb.Buffer)))
+		return 0;
+
+	constantBuffers.push_back(cb);
+	return cb.Buffer;
+}
+
+// --------------------------------------------------------
+// Dynamic buffers are written with Map, everything else
+// with UpdateSubresource
+// --------------------------------------------------------
+CommandHandle D3D11RenderDevice::CreateBuffer(const RenderBufferDesc& desc, const void* data)
+{
+	static const UINT bindFlags[] =
+	{
+		D3D11_BIND_VERTEX_BUFFER,
+		D3D11_BIND_INDEX_BUFFER,
+		D3D11_BIND_CONSTANT_BUFFER,
+	};
+
+	D3D11_BUFFER_DESC bufferDesc = {};
+	bufferDesc.ByteWidth = desc.Type == RENDER_BUFFER_CONSTANT ? (desc.Size + 15) & ~15 : desc.Size;
+	bufferDesc.Usage = desc.Dynamic ? D3D11_USAGE_DYNAMIC : D3D11_USAGE_DEFAULT;
+	bufferDesc.BindFlags = bindFlags[desc.Type];
+	bufferDesc.CPUAccessFlags = desc.Dynamic ? D3D11_CPU_ACCESS_WRITE : 0;
+
+	D3D11_SUBRESOURCE_DATA initialData = {};
+	initialData.pSysMem = data;
+
+	ID3D11Buffer* buffer = 0;
+	if (FAILED(device->CreateBuffer(&bufferDesc, data ? &initialData : 0, &buffer)))
+		return 0;
+
+	if (data)
+		stats.UploadedBytes += desc.Size;
+	stats.Buffers++;
+	stats.ResourceBytes += bufferDesc.ByteWidth;
+	return buffer;
+}
+
+void D3D11RenderDevice::UpdateBuffer(CommandHandle handle, const void* data, unsigned int size)
+{
+	ID3D11Buffer* buffer = (ID3D11Buffer*)handle;
+	D3D11_BUFFER_DESC desc;
+	buffer->GetDesc(&desc);
+	if (size > desc.ByteWidth)
+		return;
+
+	if (desc.Usage == D3D11_USAGE_DYNAMIC)
+	{
+		D3D11_MAPPED_SUBRESOURCE mapped;
+		if (FAILED(context->Map(buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+			return;
+		memcpy(mapped.pData, data, size);
+		context->Unmap(buffer, 0);
+	}
+	else if (desc.BindFlags & D3D11_BIND_CONSTANT_BUFFER)
+	{
+		// Constant buffers can't take a partial box
+		scratch.assign(desc.ByteWidth, 0);
+		memcpy(&scratch[0], data, size);
+		context->UpdateSubresource(buffer, 0, 0, &scratch[0], 0, 0);
+	}
+	else
+	{
+		D3D11_BOX box = { 0, 0, 0, size, 1, 1 };
+		context->UpdateSubresource(buffer, 0, &box, data, 0, 0);
+	}
+
+	stats.UploadedBytes += size;
+}
+
+void D3D11RenderDevice::DestroyBuffer(CommandHandle handle)
+{
+	ID3D11Buffer* buffer = (ID3D11Buffer*)handle;
+	if (!buffer)
+		return;
+
+	D3D11_BUFFER_DESC desc;
+	buffer->GetDesc(&desc);
+	stats.Buffers--;
+	stats.ResourceBytes -= desc.ByteWidth;
+	buffer->Release();
+}
+
+void D3D11RenderDevice::SetConstants(const SetConstantsCommand* command)
+{
+	const void* data = command + 1;
+	ShaderStage stage = stageMap[command->Stage];
+	stats.UploadedBytes += command->Size;
+
+	unsigned int firstConstant, numConstants;
+	if (constantRing && constantRing->Write(data, command->Size, firstConstant, numConstants))
+	{
+		stateCache->SetConstantBuffer(stage, command->Slot, constantRing->GetBuffer(), firstConstant, numConstants);
+		return;
+	}
+
+	// UpdateSubresource wants the whole buffer, which may be a
+	// little bigger than the data if it isn't a multiple of 16
+	ID3D11Buffer* buffer = GetConstantBuffer(command->Stage, command->Slot, command->Size);
+	if (!buffer)
+		return;
+
+	if ((command->Size & 15) == 0)
+		context->UpdateSubresource(buffer, 0, 0, data, 0, 0);
+	else
+	{
+		scratch.assign((command->Size + 15) & ~15, 0);
+		memcpy(&scratch[0], data, command->Size);
+		context->UpdateSubresource(buffer, 0, 0, &scratch[0], 0, 0);
+	}
+	stateCache->SetConstantBuffer(stage, command->Slot, buffer);
+}
+
+void D3D11RenderDevice::Execute(const CommandBuffer& commands)
+{
+	PROFILE_FUNCTION();
+
+	size_t offset = 0;
+	const CommandHeader* header;
+	const void* payload;
+
+	stateCache->SetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+	while (commands.Read(offset, header, payload))
+	{
+		switch (header->Type)
+		{
+		case COMMAND_SET_PIPELINE:
+		{
+			const SetPipelineCommand* command = (const SetPipelineCommand*)payload;
+			stateCache->SetInputLayout((ID3D11InputLayout*)command->InputLayout);
+			stateCache->SetShader(SHADER_STAGE_VERTEX, (ID3D11DeviceChild*)command->VertexShader);
+			stateCache->SetShader(SHADER_STAGE_PIXEL, (ID3D11DeviceChild*)command->PixelShader);
+			break;
+		}
+
+		case COMMAND_SET_RENDER_STATE:
+		{
+			static const float blendFactor[4] = { 0, 0, 0, 0 };
+			const SetRenderStateCommand* command = (const SetRenderStateCommand*)payload;
+			stateCache->SetBlendState((ID3D11BlendState*)command->Blend, blendFactor, 0xFFFFFFFF);
+			stateCache->SetDepthStencilState((ID3D11DepthStencilState*)command->DepthStencil, command->StencilRef);
+			stateCache->SetRasterizerState((ID3D11RasterizerState*)command->Rasterizer);
+			break;
+		}
+
+		case COMMAND_SET_VERTEX_BUFFER:
+		{
+			const SetVertexBufferCommand* command = (const SetVertexBufferCommand*)payload;
+			ID3D11Buffer* buffer = (ID3D11Buffer*)command->Buffer;
+			UINT stride = command->Stride;
+			UINT vbOffset = command->Offset;
+			stateCache->SetVertexBuffers(command->Slot, 1, &buffer, &stride, &vbOffset);
+			break;
+		}
+
+		case COMMAND_SET_INDEX_BUFFER:
+		{
+			const SetIndexBufferCommand* command = (const SetIndexBufferCommand*)payload;
+			stateCache->SetIndexBuffer((ID3D11Buffer*)command->Buffer, DXGI_FORMAT_R32_UINT, command->Offset);
+			break;
+		}
+
+		case COMMAND_SET_CONSTANTS:
+			SetConstants((const SetConstantsCommand*)payload);
+			break;
+
+		case COMMAND_SET_CONSTANT_BUFFER:
+		{
+			const SetConstantBufferCommand* command = (const SetConstantBufferCommand*)payload;
+			stateCache->SetConstantBuffer(stageMap[command->Stage], command->Slot, (ID3D11Buffer*)command->Buffer);
+			break;
+		}
+
+		case COMMAND_SET_TEXTURE:
+		{
+			const SetTextureCommand* command = (const SetTextureCommand*)payload;
+			stateCache->SetShaderResource(stageMap[command->Stage], command->Slot, (ID3D11ShaderResourceView*)command->Texture);
+			break;
+		}
+
+		case COMMAND_SET_SAMPLER:
+		{
+			const SetSamplerCommand* command = (const SetSamplerCommand*)payload;
+			stateCache->SetSampler(stageMap[command->Stage], command->Slot, (ID3D11SamplerState*)command->Sampler);
+			break;
+		}
+
+		case COMMAND_DRAW_INDEXED:
+		{
+			const DrawIndexedCommand* command = (const DrawIndexedCommand*)payload;
+			if (command->InstanceCount == 1 && command->StartInstance == 0)
+				context->DrawIndexed(command->IndexCount, command->StartIndex, command->BaseVertex);
+			else
+				context->DrawIndexedInstanced(command->IndexCount, command->InstanceCount, command->StartIndex, command->BaseVertex, command->StartInstance);
+			stats.Draws++;
+			break;
+		}
+		}
+
+		if (header->Type != COMMAND_DRAW_INDEXED)
+			stats.Binds++;
+		stats.Commands++;
+	}
+
+	stats.CommandBuffers++;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <d3d11.h>
+#include <vector>
+#include "RenderDevice.h"
+
+class ConstantRingBuffer;
+class StateCache;
+
+// --------------------------------------------------------
+// The D3D11 backend.  Handles are the D3D objects
+// themselves (an SRV for textures), and every bind goes
+// through the context's StateCache, so repeated state in
+// the stream costs nothing.
+//
+// Constants go into the ring buffer when there is one.
+// Otherwise they're copied into a buffer of the device's
+// own, one per stage, slot and size, since the shaders'
+// buffers belong to SimpleShader and its dirty tracking.
+// --------------------------------------------------------
+class D3D11RenderDevice : public RenderDevice
+{
+public:
+	D3D11RenderDevice(ID3D11Device* device, ID3D11DeviceContext* context, ConstantRingBuffer* constantRing = 0);
+	~D3D11RenderDevice();
+
+	CommandHandle CreateBuffer(const RenderBufferDesc& desc, const void* data);
+	void UpdateBuffer(CommandHandle buffer, const void* data, unsigned int size);
+	void DestroyBuffer(CommandHandle buffer);
+
+	void Execute(const CommandBuffer& commands);
+
+private:
+	ID3D11Device* device;
+	ID3D11DeviceContext* context;
+	StateCache* stateCache;
+	ConstantRingBuffer* constantRing;
+
+	struct ConstantBuffer
+	{
+		unsigned int Stage;
+		unsigned int Slot;
+		unsigned int Size;
+		ID3D11Buffer* Buffer;
+	};
+	std::vector<ConstantBuffer> constantBuffers;
+	std::vector<unsigned char> scratch;
+
+	void SetConstants(const SetConstantsCommand* command);
+	ID3D11Buffer* GetConstantBuffer(unsigned int stage, unsigned int slot, unsigned int size);
+};
@@ -1,7 +1,9 @@
 #include "DXCore.h"
+#include "Profiler.h"
 
 #include <WindowsX.h>
 #include <sstream>
+#include <timeapi.h>
 
 // Define the static instance variable so our OS-level 
 // message handling function below can talk to our object
@@ -50,6 +52,9 @@ DXCore::DXCore(
 	// Initialize fields
 	fpsFrameCount = 0;
 	fpsTimeElapsed = 0.0f;
+	simRunning = false;
+	simTickCount = 0;
+	simTickRate = 60.0f;
 	
 	device = 0;
 	context = 0;
@@ -61,6 +66,10 @@ DXCore::DXCore(
 	__int64 perfFreq;
 	QueryPerformanceFrequency((LARGE_INTEGER*)&perfFreq);
 	perfCounterSeconds = 1.0 / (double)perfFreq;
+
+	// Per-event input latency (and a summary on exit) go next
+	// to the .exe
+	inputLatency.OpenLog("input_latency.csv", "input_latency_summary.txt");
 }
 
 // --------------------------------------------------------
@@ -68,6 +77,11 @@ DXCore::DXCore(
 // --------------------------------------------------------
 DXCore::~DXCore()
 {
+	// The sim thread should already be stopped by Run()
+	simRunning = false;
+	if (simThread.joinable())
+		simThread.join();
+
 	// Release all DirectX resources
 	if (depthStencilView) { depthStencilView->Release(); }
 	if (backBufferRTV) { backBufferRTV->Release();}
@@ -350,7 +364,8 @@ void DXCore::OnResize()
 // --------------------------------------------------------
 // This is the main game loop, handling the following:
 //  - OS-level messages coming in from Windows itself
-//  - Calling update & draw back and forth, forever
+//  - Calling draw, forever, while a second thread
+//    calls update (see SimLoop below)
 // --------------------------------------------------------
 HRESULT DXCore::Run()
 {
@@ -362,9 +377,18 @@ HRESULT DXCore::Run()
 	currentTime = now;
 	previousTime = now;
 
+	PROFILE_THREAD_NAME("Render");
+
 	// Give subclass a chance to initialize
 	Init();
 
+	// Kick off the simulation on its own thread, so
+	// update and draw submission can overlap.  The sim
+	// sleeps between ticks, so ask for 1ms timer resolution.
+	timeBeginPeriod(1);
+	simRunning = true;
+	simThread = std::thread(&DXCore::SimLoop, this);
+
 	// Our overall game and message loop
 	MSG msg = {};
 	while (msg.message != WM_QUIT)
@@ -376,26 +400,107 @@ HRESULT DXCore::Run()
 			// to our custom WindowProc function
 			TranslateMessage(&msg);
 			DispatchMessage(&msg);
+			frameStats.Mark(FRAME_PHASE_INPUT);
 		}
 		else
 		{
+			// Hold off until the next frame is due.  Messages that
+			// arrive in the meantime get handled first.
+			bool frameDue;
+			{
+				PROFILE_SCOPE("FramePacer::Wait");
+				frameDue = framePacer.Wait();
+			}
+			frameStats.Mark(FRAME_PHASE_WAIT);
+			if (!frameDue)
+				continue;
+
+			PROFILE_SCOPE("Frame");
+
 			// Update timer and title bar (if necessary)
 			UpdateTimer();
 			if(titleBarStats)
 				UpdateTitleBarStats();
 
-			// The game loop
-			Update(deltaTime, totalTime);
+			// The render half of the game loop
 			Draw(deltaTime, totalTime);
+			frameStats.EndFrame();
 		}
 	}
 
+	// Stop the sim before anything it uses is destroyed
+	simRunning = false;
+	simThread.join();
+	timeEndPeriod(1);
+
 	// We'll end up here once we get a WM_QUIT message,
 	// which usually comes from the user closing the window
 	return (HRESULT)msg.wParam;
 }
 
 
+// --------------------------------------------------------
+// The simulation half of the game loop.  Runs Update() at
+// a fixed rate on its own thread until Run() stops it,
+// sleeping between ticks.  Update is expected to publish
+// its results for Draw without waiting on the render thread.
+// --------------------------------------------------------
+void DXCore::SimLoop()
+{
+	PROFILE_THREAD_NAME("Sim");
+
+	// Most ticks we'll run back to back to catch up after a stall
+	const int maxCatchUpTicks = 5;
+
+	double tickSeconds = 1.0 / simTickRate;
+	__int64 tickCounts = (__int64)(tickSeconds / perfCounterSeconds);
+	unsigned long long ticks = 0;
+
+	__int64 nextTick;
+	QueryPerformanceCounter((LARGE_INTEGER*)&nextTick);
+
+	while (simRunning)
+	{
+		__int64 now;
+		QueryPerformanceCounter((LARGE_INTEGER*)&now);
+
+		// Not time yet?  Sleep if there's a while to go, otherwise
+		// just give up the rest of our time slice
+		if (now < nextTick)
+		{
+			double remaining = (nextTick - now) * perfCounterSeconds;
+			if (remaining > 0.002)
+				Sleep(1);
+			else
+				std::this_thread::yield();
+			continue;
+		}
+
+		__int64 updateStart = now;
+		Update((float)tickSeconds, (float)(ticks * tickSeconds));
+		QueryPerformanceCounter((LARGE_INTEGER*)&now);
+		frameStats.AddUpdateTime(now - updateStart);
+		ticks++;
+		simTickCount++;
+
+		// Schedule off the ideal timeline so ticks don't drift,
+		// but give up on ticks we're too far behind to catch
+		nextTick += tickCounts;
+		if (now - nextTick > maxCatchUpTicks * tickCounts)
+			nextTick = now;
+	}
+}
+
+// --------------------------------------------------------
+// Seconds since the game loop started
+// --------------------------------------------------------
+float DXCore::GetElapsedTime()
+{
+	__int64 now;
+	QueryPerformanceCounter((LARGE_INTEGER*)&now);
+	return (float)((now - startTime) * perfCounterSeconds);
+}
+
 // --------------------------------------------------------
 // Sends an OS-level window close message to our process, which
 // will be handled by our message processing function
@@ -456,7 +561,26 @@ void DXCore::UpdateTitleBarStats()
 		"    Width: "		<< width <<
 		"    Height: "		<< height <<
 		"    FPS: "			<< fpsFrameCount <<
-		"    Frame Time: "	<< mspf << "ms";
+		"    Frame Time: "	<< mspf << "ms" <<
+		"    Sim: "			<< simTickCount.exchange(0) << "Hz";
+
+	// How steady the frames were, start to start
+	FramePacerStats pacing = framePacer.GetStats();
+	output.precision(3);
+	output <<
+		"    Jitter: " << pacing.JitterMs << "ms (max " << pacing.MaxDeviationMs << "ms)";
+	framePacer.ResetStats();
+
+	// Input latency percentiles, once we've seen some key presses
+	if (inputLatency.GetSampleCount() > 0)
+	{
+		output.precision(3);
+		output <<
+			"    Input p50/p95/p99: " <<
+			inputLatency.GetPercentile(50) << "/" <<
+			inputLatency.GetPercentile(95) << "/" <<
+			inputLatency.GetPercentile(99) << "ms";
+	}
 
 	// Append the version of DirectX the app is using
 	switch (dxFeatureLevel)
@@ -564,6 +688,36 @@ LRESULT DXCore::ProcessMessage(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lPara
 
 		return 0;
 
+	// Key going down - only the initial press, not auto-repeat
+	case WM_KEYDOWN:
+		if ((lParam & 0x40000000) == 0)
+		{
+			inputLatency.CaptureInput((unsigned int)wParam);
+
+#if PROFILER_ENABLED
+			// F9 starts and stops a profiler capture, saved next
+			// to the .exe for chrome://tracing
+			if (wParam == VK_F9)
+			{
+				if (Profiler::IsCapturing())
+					Profiler::EndCapture("profile_trace.json");
+				else
+					Profiler::BeginCapture();
+			}
+#endif
+		}
+		break;
+
+	case WM_KEYUP:
+		inputLatency.ReleaseInput((unsigned int)wParam);
+		break;
+
+	// Nothing will tell us about keys let go while we're
+	// in the background
+	case WM_KILLFOCUS:
+		inputLatency.ReleaseAllInputs();
+		break;
+
 	// Mouse button being pressed (while the cursor is currently over our window)
 	case WM_LBUTTONDOWN:
 	case WM_MBUTTONDOWN:
@@ -3,10 +3,16 @@
 #include <Windows.h>
 #include <d3d11.h>
 #include <string>
+#include <thread>
+#include <atomic>
+#include "LatencyTracker.h"
+#include "FramePacer.h"
+#include "FrameStats.h"
 
 // We can include the correct library files here
 // instead of in Visual Studio settings if we want
 #pragma comment(lib, "d3d11.lib")
+#pragma comment(lib, "winmm.lib")
 
 class DXCore
 {
@@ -39,6 +45,8 @@ public:
 	virtual void OnResize();
 	
 	// Pure virtual methods for setup and game functionality
+	//  - Update runs on its own sim thread once Run() starts,
+	//    Draw runs on the main (window) thread
 	virtual void Init()										= 0;
 	virtual void Update(float deltaTime, float totalTime)	= 0;
 	virtual void Draw(float deltaTime, float totalTime)		= 0;
@@ -69,6 +77,24 @@ protected:
 	ID3D11RenderTargetView* backBufferRTV;
 	ID3D11DepthStencilView* depthStencilView;
 
+	// Key press -> Present() latency, fed by the message handler
+	LatencyTracker inputLatency;
+
+	// Frame rate limit and vsync for the render loop
+	FramePacer framePacer;
+
+	// Per-phase times of recent frames.  Run() and SimLoop()
+	// mark input, pacing and update; Draw() marks the rest.
+	FrameStats frameStats;
+
+	// Fixed simulation rate - Update() always gets 1/simTickRate
+	// as its delta time, and Draw() interpolates between ticks
+	float simTickRate;
+
+	// Seconds since Run() started, on the same clock as the
+	// totalTime passed to Draw().  Safe to call from any thread.
+	float GetElapsedTime();
+
 	// Helper function for allocating a console window
 	void CreateConsoleWindow(int bufferLines, int bufferColumns, int windowLines, int windowColumns);
 
@@ -84,8 +110,14 @@ private:
 	// FPS calculation
 	int fpsFrameCount;
 	float fpsTimeElapsed;
+
+	// Simulation thread
+	std::thread simThread;
+	std::atomic<bool> simRunning;
+	std::atomic<int> simTickCount;
 	
 	void UpdateTimer();			// Updates the timer for this frame
 	void UpdateTitleBarStats();	// Puts debug info in the title bar
+	void SimLoop();				// Calls Update() until the game loop ends
 };
 
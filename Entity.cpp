@@ -1,140 +1,168 @@
 #include "Entity.h"
+#include "Profiler.h"
 #include "Camera.h"
+#include "StateCache.h"
+#include <string.h>
 
 using namespace DirectX;
 
+TransformStore Entity::transforms;
+std::atomic<unsigned int> Entity::worldMatrixBuilds(0);
 
 
 Entity::Entity(Mesh* meshPtr, ID3D11DeviceContext* context, Material* materialPtr)
 {
-	worldMatrix = XMFLOAT4X4();
-	position = XMFLOAT3(0.0f, 0.0f, 0.0f);
-	scale = XMFLOAT3(1.0f, 1.0f, 1.0f);
+	transform = transforms.Add(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(1.0f, 1.0f, 1.0f));
 
 	material = materialPtr;
 
-	xRot = 0.0f;
-	yRot = 0.0f;
-	zRot = 0.0f;
-
 	this->mesh = meshPtr;
 	this->context = context;
+
+	hasPrevTick = false;
 }
 
 Entity::Entity(Mesh* meshPtr, ID3D11DeviceContext* context, Material* materialPtr, XMFLOAT3 position)
 {
-	worldMatrix = XMFLOAT4X4();
-	this->position = position;
-	scale = XMFLOAT3(1.0f, 1.0f, 1.0f);
+	transform = transforms.Add(position, XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(1.0f, 1.0f, 1.0f));
 
 	material = materialPtr;
 
-	xRot = 0.0f;
-	yRot = 0.0f;
-	zRot = 0.0f;
-
 	this->mesh = meshPtr;
 	this->context = context;
+
+	hasPrevTick = false;
 }
 
 Entity::~Entity()
 {
-	
+	transforms.Remove(transform);
+}
+
+XMFLOAT4X4 Entity::BuildWorldMatrix(XMFLOAT3 position, XMFLOAT3 rotation, XMFLOAT3 scale)
+{
+	worldMatrixBuilds++;
+	return TransformStore::BuildWorldMatrix(position, rotation, scale);
+}
+
+XMFLOAT4X4 Entity::GetWorldMatrix()
+{
+	return transforms.GetWorldMatrix(transform);
+}
+
+void Entity::UpdateWorldMatrices()
+{
+	transforms.BuildDirty();
+}
+
+void Entity::SaveTickState()
+{
+	prevPosition = transforms.GetPosition(transform);
+	prevScale = transforms.GetScale(transform);
+	prevRotation = transforms.GetRotation(transform);
+	hasPrevTick = true;
 }
 
-void Entity::AssembleWorldMatrix()
+bool Entity::HasPrevTickState()
 {
-	XMMATRIX matTrans = XMMatrixTranslation(position.x, position.y, position.z);
-	XMMATRIX matRot = XMMatrixRotationX(xRot) *XMMatrixRotationY(yRot)* XMMatrixRotationZ(zRot);
-	XMMATRIX matScale = XMMatrixScaling(scale.x, scale.y, scale.z);
+	return hasPrevTick;
+}
+
+XMFLOAT3 Entity::GetPrevPosition()
+{
+	return prevPosition;
+}
 
-	XMMATRIX world = matScale * matRot * matTrans;
+XMFLOAT3 Entity::GetPrevScale()
+{
+	return prevScale;
+}
 
-	XMStoreFloat4x4(&worldMatrix, XMMatrixTranspose(world));
+XMFLOAT3 Entity::GetPrevRotation()
+{
+	return prevRotation;
 }
 
 void Entity::Move(XMFLOAT3 movement)
 {
+	XMFLOAT3 position = transforms.GetPosition(transform);
 	position.x += movement.x;
 	position.y += movement.y;
 	position.z += movement.z;
+	transforms.SetPosition(transform, position);
 }
 
 void Entity::SetPosition(DirectX::XMFLOAT3 position)
 {
-	this->position = position;
+	transforms.SetPosition(transform, position);
 }
 
 void Entity::SetScale(DirectX::XMFLOAT3 scale)
 {
-	this->scale = scale;
+	transforms.SetScale(transform, scale);
 }
 
 void Entity::SetRotation(float xRot, float yRot, float zRot)
 {
-	this->xRot = xRot;
-	this->yRot = yRot;
-	this->zRot = zRot;
+	transforms.SetRotation(transform, XMFLOAT3(xRot, yRot, zRot));
 }
 
-void Entity::PrepareMaterial(DirectX::XMFLOAT4X4 viewMatrix, DirectX::XMFLOAT4X4 projMatrix)
+// View, projection, camera and lights are per frame and
+// already uploaded, so only per-object data is set here
+void Entity::PrepareMaterial(DirectX::XMFLOAT4X4 world)
 {
-	AssembleWorldMatrix();
-
-	material->GetVertexShader()->SetMatrix4x4("world", worldMatrix);
-	material->GetVertexShader()->SetMatrix4x4("view", viewMatrix);
-	material->GetVertexShader()->SetMatrix4x4("projection", projMatrix);
-	material->GetVertexShader()->SetFloat2("uvScale", material->GetUVScale());
+	const MaterialShaderHandles& handles = material->GetShaderHandles();
+	SimpleVertexShader* vs = material->GetVertexShader();
+	SimplePixelShader* ps = material->GetPixelShader();
 
-	material->GetVertexShader()->SetShader();
-	material->GetVertexShader()->CopyAllBufferData();
+	vs->SetMatrix4x4(handles.World, world);
+	vs->SetFloat2(handles.UVScale, material->GetUVScale());
 
-	material->GetPixelShader()->SetMatrix4x4("world", worldMatrix);
-	material->GetPixelShader()->SetMatrix4x4("view", viewMatrix);
-	material->GetPixelShader()->SetMatrix4x4("projection", projMatrix);
+	vs->SetShader();
+	vs->CopyAllBufferData();
 
-	material->GetPixelShader()->SetShaderResourceView("AlbedoTexture", material->GetAlbedoShaderResourceView());
-	material->GetPixelShader()->SetShaderResourceView("NormalTexture", material->GetNormalsShaderResourceView());
-	material->GetPixelShader()->SetShaderResourceView("RoughnessTexture", material->GetRoughnessShaderResourceView());
-	material->GetPixelShader()->SetShaderResourceView("MetalTexture", material->GetMetalShaderResourceView());
-	material->GetPixelShader()->SetSamplerState("BasicSampler", material->GetSamplerState());
+	ps->SetShaderResourceView(handles.AlbedoTexture, material->GetAlbedoShaderResourceView());
+	ps->SetShaderResourceView(handles.NormalTexture, material->GetNormalsShaderResourceView());
+	ps->SetShaderResourceView(handles.RoughnessTexture, material->GetRoughnessShaderResourceView());
+	ps->SetShaderResourceView(handles.MetalTexture, material->GetMetalShaderResourceView());
+	ps->SetSamplerState(handles.BasicSampler, material->GetSamplerState());
 
-	material->GetPixelShader()->SetShader();
-	material->GetPixelShader()->CopyAllBufferData();
+	ps->SetShader();
+	ps->CopyAllBufferData();
 }
 
-void Entity::PrepareRefractMaterial(DirectX::XMFLOAT4X4 viewMatrix, DirectX::XMFLOAT4X4 projMatrix, ID3D11ShaderResourceView* refractionSRV, ID3D11SamplerState* samplerOptions, ID3D11SamplerState* refractSampler,Camera* camera)
+void Entity::PrepareRefractMaterial(DirectX::XMFLOAT4X4 world, ID3D11ShaderResourceView* refractionSRV, ID3D11SamplerState* samplerOptions, ID3D11SamplerState* refractSampler)
 {
-	AssembleWorldMatrix();
+	const MaterialShaderHandles& handles = material->GetShaderHandles();
+	SimpleVertexShader* vs = material->GetVertexShader();
+	SimplePixelShader* ps = material->GetPixelShader();
 
 	// Setup vertex shader
-	material->GetVertexShader()->SetMatrix4x4("world", worldMatrix);
-	material->GetVertexShader()->SetMatrix4x4("view",viewMatrix);
-	material->GetVertexShader()->SetMatrix4x4("projection", projMatrix);
-	material->GetVertexShader()->CopyAllBufferData();
-	material->GetVertexShader()->SetShader();
+	vs->SetMatrix4x4(handles.World, world);
+	vs->CopyAllBufferData();
+	vs->SetShader();
 
 	// Setup pixel shader
-	material->GetPixelShader()->SetShaderResourceView("ScenePixels", refractionSRV);	// Pixels of the screen
-	material->GetPixelShader()->SetShaderResourceView("NormalMap", material->GetNormalsShaderResourceView());	// Normal map for the object itself
-	material->GetPixelShader()->SetSamplerState("BasicSampler", samplerOptions);			// Sampler for the normal map
-	material->GetPixelShader()->SetSamplerState("RefractSampler", refractSampler);	// Uses CLAMP on the edges
-	material->GetPixelShader()->SetFloat3("CameraPosition", camera->GetPosition());
-	material->GetPixelShader()->SetMatrix4x4("view", camera->currentView);				// View matrix, so we can put normals into view space
-	material->GetPixelShader()->CopyAllBufferData();
-	material->GetPixelShader()->SetShader();
+	ps->SetShaderResourceView(handles.ScenePixels, refractionSRV);	// Pixels of the screen
+	ps->SetShaderResourceView(handles.NormalMap, material->GetNormalsShaderResourceView());	// Normal map for the object itself
+	ps->SetSamplerState(handles.BasicSampler, samplerOptions);			// Sampler for the normal map
+	ps->SetSamplerState(handles.RefractSampler, refractSampler);	// Uses CLAMP on the edges
+	ps->SetShader();
 }
 
-void Entity::Draw(DirectX::XMFLOAT4X4 viewMatrix, DirectX::XMFLOAT4X4 projMatrix)
+void Entity::Draw(DirectX::XMFLOAT4X4 world)
 {
+	PROFILE_FUNCTION();
+
 	UINT stride = sizeof(Vertex);
 	UINT offset = 0;
 	ID3D11Buffer* meshVertexBuffer = mesh->GetVertexBuffer();
 
-	context->IASetVertexBuffers(0, 1, &meshVertexBuffer, &stride, &offset);
-	context->IASetIndexBuffer(mesh->GetIndexBuffer(), DXGI_FORMAT_R32_UINT, 0);
+	StateCache* stateCache = StateCache::Get(context);
+	stateCache->SetVertexBuffers(0, 1, &meshVertexBuffer, &stride, &offset);
+	stateCache->SetIndexBuffer(mesh->GetIndexBuffer(), DXGI_FORMAT_R32_UINT, 0);
 
-	PrepareMaterial(viewMatrix, projMatrix);
+	PrepareMaterial(world);
 
 	context->DrawIndexed(
 		mesh->GetIndexCount(),     // The number of indices to use (we could draw a subset if we wanted)
@@ -142,19 +170,50 @@ void Entity::Draw(DirectX::XMFLOAT4X4 viewMatrix, DirectX::XMFLOAT4X4 projMatrix
 		0);    // Offset to add to each index when looking up vertices
 }
 
-void Entity::DrawRefract(DirectX::XMFLOAT4X4 viewMatrix, DirectX::XMFLOAT4X4 projMatrix, ID3D11ShaderResourceView* refractionSRV, ID3D11SamplerState* samplerOptions, ID3D11SamplerState* refractSampler, Camera* camera)
+// --------------------------------------------------------
+// Constants are copied from the shaders' local data, which
+// nobody writes while recording, and the world matrix and
+// uv scale are patched into the copy.  Buffers filled by
+// someone else (the per-frame one) are already bound.
+// --------------------------------------------------------
+void Entity::Record(CommandBuffer& commands, XMFLOAT4X4 world)
+{
+	PROFILE_FUNCTION();
+
+	const MaterialShaderHandles& handles = material->GetShaderHandles();
+	SimpleVertexShader* vs = material->GetVertexShader();
+	SimplePixelShader* ps = material->GetPixelShader();
+	XMFLOAT2 uvScale = material->GetUVScale();
+
+	commands.SetPipeline(vs->GetInputLayout(), vs->GetDirectXShader(), ps->GetDirectXShader());
+	commands.SetVertexBuffer(0, mesh->GetVertexBuffer(), sizeof(Vertex));
+	commands.SetIndexBuffer(mesh->GetIndexBuffer());
+
+	ConstantPatch patches[2] =
+	{
+		{ handles.World, &world, sizeof(world) },
+		{ handles.UVScale, &uvScale, sizeof(uvScale) },
+	};
+	RecordShaderConstants(commands, vs, COMMAND_STAGE_VERTEX, patches, 2);
+	RecordShaderConstants(commands, ps, COMMAND_STAGE_PIXEL);
+	material->RecordTextures(commands);
+
+	commands.DrawIndexed(mesh->GetIndexCount());
+}
+
+void Entity::DrawRefract(DirectX::XMFLOAT4X4 world, ID3D11ShaderResourceView* refractionSRV, ID3D11SamplerState* samplerOptions, ID3D11SamplerState* refractSampler)
 {
-	if (!visible)
-		return;
+	PROFILE_FUNCTION();
 
 	UINT stride = sizeof(Vertex);
 	UINT offset = 0;
 	ID3D11Buffer* meshVertexBuffer = mesh->GetVertexBuffer();
 
-	context->IASetVertexBuffers(0, 1, &meshVertexBuffer, &stride, &offset);
-	context->IASetIndexBuffer(mesh->GetIndexBuffer(), DXGI_FORMAT_R32_UINT, 0);
+	StateCache* stateCache = StateCache::Get(context);
+	stateCache->SetVertexBuffers(0, 1, &meshVertexBuffer, &stride, &offset);
+	stateCache->SetIndexBuffer(mesh->GetIndexBuffer(), DXGI_FORMAT_R32_UINT, 0);
 
-	PrepareRefractMaterial(viewMatrix, projMatrix, refractionSRV, samplerOptions, refractSampler, camera);
+	PrepareRefractMaterial(world, refractionSRV, samplerOptions, refractSampler);
 
 	context->DrawIndexed(
 		mesh->GetIndexCount(),     // The number of indices to use (we could draw a subset if we wanted)
@@ -164,25 +223,25 @@ void Entity::DrawRefract(DirectX::XMFLOAT4X4 viewMatrix, DirectX::XMFLOAT4X4 pro
 
 DirectX::XMFLOAT3 Entity::GetPosition()
 {
-	return position;
+	return transforms.GetPosition(transform);
 }
 
 DirectX::XMFLOAT3 Entity::GetScale()
 {
-	return scale;
+	return transforms.GetScale(transform);
 }
 
 float Entity::GetRotationX()
 {
-	return xRot;
+	return transforms.GetRotation(transform).x;
 }
 
 float Entity::GetRotationY()
 {
-	return yRot;
+	return transforms.GetRotation(transform).y;
 }
 
 float Entity::GetRotationZ()
 {
-	return zRot;
+	return transforms.GetRotation(transform).z;
 }
@@ -4,14 +4,15 @@
 #include "Mesh.h"
 #include "Material.h"
 #include "Camera.h"
+#include "TransformStore.h"
+#include "CommandBuffer.h"
+#include <atomic>
 
 
 class Entity
 {
 public:
 	
-	DirectX::XMFLOAT4X4 worldMatrix;
-	
 	Mesh* mesh;
 	Material* material;
 
@@ -21,13 +22,46 @@ public:
 	void SetPosition(DirectX::XMFLOAT3 position);
 	void SetScale(DirectX::XMFLOAT3 scale);
 	void SetRotation(float xRot, float yRot, float zRot);
-	void PrepareMaterial(DirectX::XMFLOAT4X4 viewMatrix, DirectX::XMFLOAT4X4 projMatrix);
+	// Sim side - world matrix for the current transform, only
+	// rebuilt when the transform has changed since last time
+	DirectX::XMFLOAT4X4 GetWorldMatrix();
+
+	// Sim side - rebuilds every entity's changed world matrix
+	// in one SIMD pass.  Call before reading lots of them.
+	static void UpdateWorldMatrices();
+
+	// Sim side - remembers the transform at the start of a tick,
+	// so the renderer can blend from it to the end-of-tick one
+	void SaveTickState();
+	bool HasPrevTickState();
+	DirectX::XMFLOAT3 GetPrevPosition();
+	DirectX::XMFLOAT3 GetPrevScale();
+	DirectX::XMFLOAT3 GetPrevRotation();
+
+	// Transposed (HLSL-ready) world matrix from a set of transform values
+	static DirectX::XMFLOAT4X4 BuildWorldMatrix(DirectX::XMFLOAT3 position, DirectX::XMFLOAT3 rotation, DirectX::XMFLOAT3 scale);
 
-	void PrepareRefractMaterial(DirectX::XMFLOAT4X4 viewMatrix, DirectX::XMFLOAT4X4 projMatrix, ID3D11ShaderResourceView* refractionSRV, ID3D11SamplerState* samplerOptions, ID3D11SamplerState* refractSampler, Camera* camera);
+	// How many world matrices have been built (on any thread)
+	// since the last reset
+	static unsigned int GetWorldMatrixBuildCount() { return worldMatrixBuilds + transforms.GetBuildCount(); }
+	static void ResetWorldMatrixBuildCount() { worldMatrixBuilds = 0; transforms.ResetBuildCount(); }
 
-	void Draw(DirectX::XMFLOAT4X4 viewMatrix, DirectX::XMFLOAT4X4 projMatrix);
+	// Render side - only uses the mesh and material, with the
+	// world matrix coming from a render snapshot.  Per-frame
+	// data (view, projection, camera, lights) must already be
+	// in the shared perFrame buffer.
+	void PrepareMaterial(DirectX::XMFLOAT4X4 world);
 
-	void DrawRefract(DirectX::XMFLOAT4X4 viewMatrix, DirectX::XMFLOAT4X4 projMatrix, ID3D11ShaderResourceView* refractionSRV, ID3D11SamplerState* samplerOptions, ID3D11SamplerState* refractSampler, Camera* camera);
+	void PrepareRefractMaterial(DirectX::XMFLOAT4X4 world, ID3D11ShaderResourceView* refractionSRV, ID3D11SamplerState* samplerOptions, ID3D11SamplerState* refractSampler);
+
+	void Draw(DirectX::XMFLOAT4X4 world);
+
+	// Render side, any thread - records what Draw() would do
+	// without touching the context or the shaders' state.
+	// The material's shader handles must already be resolved.
+	void Record(CommandBuffer& commands, DirectX::XMFLOAT4X4 world);
+
+	void DrawRefract(DirectX::XMFLOAT4X4 world, ID3D11ShaderResourceView* refractionSRV, ID3D11SamplerState* samplerOptions, ID3D11SamplerState* refractSampler);
 
 	DirectX::XMFLOAT3 GetPosition();
 	DirectX::XMFLOAT3 GetScale();
@@ -40,15 +74,18 @@ public:
 	Entity(Mesh* meshPtr, ID3D11DeviceContext* context, Material*, DirectX::XMFLOAT3);
 	~Entity();
 protected:
-	void AssembleWorldMatrix();
-
 	ID3D11DeviceContext* context;
 
-	DirectX::XMFLOAT3 position;
-	DirectX::XMFLOAT3 scale;
+	// Position, rotation and scale live in the shared store
+	// (which tracks when they change), not in the entity
+	unsigned int transform;
+	static TransformStore transforms;
+	static std::atomic<unsigned int> worldMatrixBuilds;
 
-	float xRot;
-	float yRot;
-	float zRot;
+	// Transform at the start of the current sim tick
+	bool hasPrevTick;
+	DirectX::XMFLOAT3 prevPosition;
+	DirectX::XMFLOAT3 prevScale;
+	DirectX::XMFLOAT3 prevRotation;
 };
 
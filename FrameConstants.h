@@ -0,0 +1,30 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include "Lights.h"
+
+// --------------------------------------------------------
+// CPU side of the perFrame cbuffer in FrameConstants.hlsli.
+// The padding follows HLSL's packing rules: a struct always
+// starts on a new 16-byte register.
+// --------------------------------------------------------
+struct PerFrameData
+{
+	DirectX::XMFLOAT4X4 View;
+	DirectX::XMFLOAT4X4 Projection;
+	DirectX::XMFLOAT3 CameraPosition;
+	float Pad0;
+
+	DirectionalLight Light;
+	float Pad1;
+	DirectionalLight Light2;
+	float Pad2;
+
+	// Maps a pixel and view depth to a light cluster (see
+	// LightClusters.hlsli)
+	DirectX::XMFLOAT2 ClusterTileScale;
+	float ClusterSliceScale;
+	float ClusterSliceBias;
+	DirectX::XMUINT3 ClusterCounts;
+	unsigned int LocalLightCount;
+};
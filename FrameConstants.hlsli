@@ -0,0 +1,32 @@
+#ifndef __FRAME_CONSTANTS_HLSLI__
+#define __FRAME_CONSTANTS_HLSLI__
+
+struct DirectionalLight {
+
+	float4 AmbientColor;
+	float4 DiffuseColor;
+	float3 Direction;
+};
+
+// --------------------------------------------------------
+// Everything that's the same for every draw in a frame.
+// Filled in once per frame by Game (see FrameConstants.h)
+// and shared by every shader that includes this file.
+// --------------------------------------------------------
+cbuffer perFrame : register(b0)
+{
+	matrix view;
+	matrix projection;
+	float3 CameraPosition;
+
+	DirectionalLight light;
+	DirectionalLight light2;
+
+	float2 ClusterTileScale;	// Clusters per pixel
+	float ClusterSliceScale;	// Slice = log(depth) * scale + bias
+	float ClusterSliceBias;
+	uint3 ClusterCounts;
+	uint LocalLightCount;
+};
+
+#endif
@@ -0,0 +1,348 @@
+#include "FrameGraph.h"
+#include "Profiler.h"
+
+FrameGraph::FrameGraph(ID3D11Device* device, unsigned int width, unsigned int height)
+{
+	this->device = device;
+	this->width = width;
+	this->height = height;
+	stats = {};
+}
+
+FrameGraph::~FrameGraph()
+{
+	for (size_t i = 0; i < pool.size(); i++)
+		ReleasePooledTexture(pool[i]);
+}
+
+void FrameGraph::ReleasePooledTexture(PooledTexture* texture)
+{
+	if (texture->RTV) texture->RTV->Release();
+	if (texture->SRV) texture->SRV->Release();
+	if (texture->DSV) texture->DSV->Release();
+	if (texture->Texture) texture->Texture->Release();
+	delete texture;
+}
+
+void FrameGraph::Resize(unsigned int width, unsigned int height)
+{
+	this->width = width;
+	this->height = height;
+
+	for (size_t i = 0; i < pool.size(); i++)
+		ReleasePooledTexture(pool[i]);
+	pool.clear();
+}
+
+void FrameGraph::Reset()
+{
+	resources.clear();
+	passes.clear();
+}
+
+FrameGraphResource FrameGraph::ImportTexture(const char* name, ID3D11RenderTargetView* rtv, ID3D11ShaderResourceView* srv, ID3D11DepthStencilView* dsv, bool output)
+{
+	Resource resource = {};
+	resource.Name = name;
+	resource.Imported = true;
+	resource.Output = output;
+	resource.RTV = rtv;
+	resource.SRV = srv;
+	resource.DSV = dsv;
+	resources.push_back(resource);
+	return (FrameGraphResource)resources.size() - 1;
+}
+
+FrameGraphResource FrameGraph::CreateTexture(const char* name, const FrameGraphTextureDesc& desc)
+{
+	Resource resource = {};
+	resource.Name = name;
+	resource.Desc = desc;
+	resources.push_back(resource);
+	return (FrameGraphResource)resources.size() - 1;
+}
+
+FrameGraphPass FrameGraph::AddPass(const char* name, PassFunction execute)
+{
+	Pass pass;
+	pass.Name = name;
+	pass.Execute = execute;
+	pass.RefCount = 0;
+	pass.Culled = false;
+	passes.push_back(pass);
+	return (FrameGraphPass)passes.size() - 1;
+}
+
+void FrameGraph::Read(FrameGraphPass pass, FrameGraphResource resource)
+{
+	passes[pass].Reads.push_back(resource);
+}
+
+void FrameGraph::Write(FrameGraphPass pass, FrameGraphResource resource)
+{
+	passes[pass].Writes.push_back(resource);
+}
+
+// --------------------------------------------------------
+// Reference counting from the outputs backwards.  A pass
+// is referenced once per thing it writes; a resource once
+// per pass that reads it (plus once if it's an output).
+// A resource nobody references un-references the passes
+// that write it, and a pass that drops to zero is culled
+// and un-references what it reads, and so on.
+// --------------------------------------------------------
+void FrameGraph::Cull()
+{
+	for (size_t r = 0; r < resources.size(); r++)
+		resources[r].RefCount = resources[r].Output ? 1 : 0;
+
+	for (size_t p = 0; p < passes.size(); p++)
+	{
+		passes[p].RefCount = (unsigned int)passes[p].Writes.size();
+		passes[p].Culled = false;
+		for (size_t i = 0; i < passes[p].Reads.size(); i++)
+			resources[passes[p].Reads[i]].RefCount++;
+	}
+
+	std::vector<FrameGraphResource> unreferenced;
+	for (size_t r = 0; r < resources.size(); r++)
+	{
+		if (resources[r].RefCount == 0)
+			unreferenced.push_back((FrameGraphResource)r);
+	}
+
+	while (!unreferenced.empty())
+	{
+		FrameGraphResource r = unreferenced.back();
+		unreferenced.pop_back();
+
+		for (size_t p = 0; p < passes.size(); p++)
+		{
+			Pass& pass = passes[p];
+			if (pass.Culled)
+				continue;
+
+			for (size_t w = 0; w < pass.Writes.size(); w++)
+			{
+				if (pass.Writes[w] != r || --pass.RefCount > 0)
+					continue;
+
+				pass.Culled = true;
+				for (size_t i = 0; i < pass.Reads.size(); i++)
+				{
+					if (--resources[pass.Reads[i]].RefCount == 0)
+						unreferenced.push_back(pass.Reads[i]);
+				}
+			}
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Finds (or makes) a pooled texture for a resource.  Shared
+// ones just need to be free and the same shape; persistent
+// ones are found by name.
+// --------------------------------------------------------
+FrameGraph::PooledTexture* FrameGraph::Acquire(Resource& resource)
+{
+	const FrameGraphTextureDesc& desc = resource.Desc;
+	unsigned int texWidth = (unsigned int)(width * desc.WidthScale);
+	unsigned int texHeight = (unsigned int)(height * desc.HeightScale);
+	if (texWidth == 0) texWidth = 1;
+	if (texHeight == 0) texHeight = 1;
+
+	for (size_t i = 0; i < pool.size(); i++)
+	{
+		PooledTexture* texture = pool[i];
+		if (texture->InUse ||
+			texture->Width != texWidth ||
+			texture->Height != texHeight ||
+			texture->Format != desc.Format ||
+			texture->BindFlags != desc.BindFlags)
+			continue;
+
+		if (desc.Persistent ? texture->PersistentName == resource.Name : texture->PersistentName.empty())
+			return texture;
+	}
+
+	PooledTexture* texture = CreatePooledTexture(texWidth, texHeight, desc);
+	if (desc.Persistent)
+	{
+		texture->PersistentName = resource.Name;
+		resource.Recreated = true;
+	}
+	pool.push_back(texture);
+	return texture;
+}
+
+FrameGraph::PooledTexture* FrameGraph::CreatePooledTexture(unsigned int texWidth, unsigned int texHeight, const FrameGraphTextureDesc& desc)
+{
+	PooledTexture* texture = new PooledTexture();
+	texture->Width = texWidth;
+	texture->Height = texHeight;
+	texture->Format = desc.Format;
+	texture->BindFlags = desc.BindFlags;
+	texture->InUse = false;
+	texture->Texture = 0;
+	texture->RTV = 0;
+	texture->SRV = 0;
+	texture->DSV = 0;
+
+	D3D11_TEXTURE2D_DESC texDesc = {};
+	texDesc.Width = texWidth;
+	texDesc.Height = texHeight;
+	texDesc.MipLevels = 1;
+	texDesc.ArraySize = 1;
+	texDesc.Format = desc.Format;
+	texDesc.Usage = D3D11_USAGE_DEFAULT;
+	texDesc.BindFlags = desc.BindFlags;
+	texDesc.SampleDesc.Count = 1;
+	texDesc.SampleDesc.Quality = 0;
+	device->CreateTexture2D(&texDesc, 0, &texture->Texture);
+
+	if (texture->Texture)
+	{
+		if (desc.BindFlags & D3D11_BIND_RENDER_TARGET)
+			device->CreateRenderTargetView(texture->Texture, 0, &texture->RTV);
+		if (desc.BindFlags & D3D11_BIND_SHADER_RESOURCE)
+			device->CreateShaderResourceView(texture->Texture, 0, &texture->SRV);
+		if (desc.BindFlags & D3D11_BIND_DEPTH_STENCIL)
+			device->CreateDepthStencilView(texture->Texture, 0, &texture->DSV);
+	}
+
+	return texture;
+}
+
+// --------------------------------------------------------
+// Walks the surviving passes in order, taking each texture
+// from the pool at its first use and giving it back after
+// its last, so later textures can land in the same one
+// --------------------------------------------------------
+void FrameGraph::Allocate()
+{
+	for (size_t r = 0; r < resources.size(); r++)
+	{
+		resources[r].FirstPass = -1;
+		resources[r].LastPass = -1;
+		resources[r].Pooled = 0;
+		resources[r].Recreated = false;
+	}
+
+	for (size_t p = 0; p < passes.size(); p++)
+	{
+		if (passes[p].Culled)
+			continue;
+
+		const std::vector<FrameGraphResource>* lists[2] = { &passes[p].Reads, &passes[p].Writes };
+		for (int l = 0; l < 2; l++)
+		{
+			for (size_t i = 0; i < lists[l]->size(); i++)
+			{
+				Resource& resource = resources[(*lists[l])[i]];
+				if (resource.FirstPass < 0)
+					resource.FirstPass = (int)p;
+				resource.LastPass = (int)p;
+			}
+		}
+	}
+
+	for (size_t i = 0; i < pool.size(); i++)
+		pool[i]->InUse = false;
+
+	for (size_t p = 0; p < passes.size(); p++)
+	{
+		for (size_t r = 0; r < resources.size(); r++)
+		{
+			Resource& resource = resources[r];
+			if (!resource.Imported && resource.FirstPass == (int)p)
+			{
+				resource.Pooled = Acquire(resource);
+				resource.Pooled->InUse = true;
+				if (resource.Desc.Persistent)
+					stats.PersistentTextures++;
+				else
+					stats.TransientTextures++;
+			}
+		}
+
+		// Persistent textures stay claimed for the whole frame
+		for (size_t r = 0; r < resources.size(); r++)
+		{
+			Resource& resource = resources[r];
+			if (resource.Pooled && resource.LastPass == (int)p && !resource.Desc.Persistent)
+				resource.Pooled->InUse = false;
+		}
+	}
+}
+
+void FrameGraph::Compile()
+{
+	PROFILE_FUNCTION();
+
+	stats = {};
+
+	Cull();
+	Allocate();
+
+	stats.Passes = (unsigned int)passes.size();
+	for (size_t p = 0; p < passes.size(); p++)
+		stats.CulledPasses += passes[p].Culled ? 1 : 0;
+
+	stats.PooledTextures = (unsigned int)pool.size();
+	for (size_t i = 0; i < pool.size(); i++)
+		stats.PooledBytes += (unsigned long long)pool[i]->Width * pool[i]->Height * BytesPerPixel(pool[i]->Format);
+}
+
+void FrameGraph::Execute()
+{
+	PROFILE_FUNCTION();
+
+	for (size_t p = 0; p < passes.size(); p++)
+	{
+		if (!passes[p].Culled)
+			passes[p].Execute();
+	}
+}
+
+ID3D11Texture2D* FrameGraph::GetTexture(FrameGraphResource resource)
+{
+	PooledTexture* pooled = resources[resource].Pooled;
+	return pooled ? pooled->Texture : 0;
+}
+
+ID3D11RenderTargetView* FrameGraph::GetRTV(FrameGraphResource resource)
+{
+	const Resource& r = resources[resource];
+	return r.Imported ? r.RTV : (r.Pooled ? r.Pooled->RTV : 0);
+}
+
+ID3D11ShaderResourceView* FrameGraph::GetSRV(FrameGraphResource resource)
+{
+	const Resource& r = resources[resource];
+	return r.Imported ? r.SRV : (r.Pooled ? r.Pooled->SRV : 0);
+}
+
+ID3D11DepthStencilView* FrameGraph::GetDSV(FrameGraphResource resource)
+{
+	const Resource& r = resources[resource];
+	return r.Imported ? r.DSV : (r.Pooled ? r.Pooled->DSV : 0);
+}
+
+unsigned int FrameGraph::BytesPerPixel(DXGI_FORMAT format)
+{
+	switch (format)
+	{
+	case DXGI_FORMAT_R32G32B32A32_FLOAT:
+		return 16;
+	case DXGI_FORMAT_R16G16B16A16_FLOAT:
+	case DXGI_FORMAT_R32G32_FLOAT:
+		return 8;
+	case DXGI_FORMAT_R8_UNORM:
+		return 1;
+	case DXGI_FORMAT_R16_FLOAT:
+	case DXGI_FORMAT_R8G8_UNORM:
+		return 2;
+	default:
+		return 4;
+	}
+}
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <d3d11.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+typedef unsigned int FrameGraphResource;
+typedef unsigned int FrameGraphPass;
+
+// --------------------------------------------------------
+// A texture the graph makes for itself, sized relative to
+// the back buffer
+// --------------------------------------------------------
+struct FrameGraphTextureDesc
+{
+	float WidthScale = 1.0f;
+	float HeightScale = 1.0f;
+	DXGI_FORMAT Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	UINT BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
+
+	// Keeps its texture (and contents) from frame to frame
+	// instead of sharing one from the pool
+	bool Persistent = false;
+};
+
+struct FrameGraphStats
+{
+	unsigned int Passes;
+	unsigned int CulledPasses;
+	unsigned int TransientTextures;		// Asked for this frame, shared from the pool
+	unsigned int PersistentTextures;	// Asked for this frame, kept between frames
+	unsigned int PooledTextures;		// Actually exist (both kinds)
+	unsigned long long PooledBytes;
+};
+
+// --------------------------------------------------------
+// Describes a frame as passes that read and write textures,
+// then works out what actually has to run and where each
+// texture lives.
+//
+// Per frame: Reset(), import the textures that live
+// elsewhere (back buffer, depth) and create the ones that
+// don't, add passes and say what they Read() and Write(),
+// then Compile() and Execute().
+//
+// Compile() culls every pass whose writes nobody reads,
+// unless they're an imported output (the back buffer).
+// Textures are handed out from a pool: two textures whose
+// first-to-last use don't overlap get the same D3D
+// texture, and the pool is kept between frames so nothing
+// is created once it has warmed up.  D3D11 can't place two
+// resources in one allocation, so sharing whole textures
+// of the same size and format is as close to aliasing as
+// it gets.
+//
+// Passes run in the order they were added.
+// --------------------------------------------------------
+class FrameGraph
+{
+public:
+	typedef std::function<void()> PassFunction;
+
+	FrameGraph(ID3D11Device* device, unsigned int width, unsigned int height);
+	~FrameGraph();
+
+	// Drops every pooled texture; they get remade at the new
+	// size as they're needed
+	void Resize(unsigned int width, unsigned int height);
+
+	void Reset();
+
+	// Views can be null if the texture isn't used that way.
+	// Passes that write an output are never culled.
+	FrameGraphResource ImportTexture(const char* name, ID3D11RenderTargetView* rtv, ID3D11ShaderResourceView* srv, ID3D11DepthStencilView* dsv, bool output);
+	FrameGraphResource CreateTexture(const char* name, const FrameGraphTextureDesc& desc);
+
+	FrameGraphPass AddPass(const char* name, PassFunction execute);
+	void Read(FrameGraphPass pass, FrameGraphResource resource);
+	void Write(FrameGraphPass pass, FrameGraphResource resource);
+
+	void Compile();
+	void Execute();
+
+	// Valid after Compile()
+	ID3D11Texture2D* GetTexture(FrameGraphResource resource);
+	ID3D11RenderTargetView* GetRTV(FrameGraphResource resource);
+	ID3D11ShaderResourceView* GetSRV(FrameGraphResource resource);
+	ID3D11DepthStencilView* GetDSV(FrameGraphResource resource);
+	bool IsCulled(FrameGraphPass pass) { return passes[pass].Culled; }
+
+	// True when a persistent texture was (re)made this frame,
+	// so whatever it held before is gone
+	bool WasRecreated(FrameGraphResource resource) { return resources[resource].Recreated; }
+
+	const FrameGraphStats& GetStats() { return stats; }
+
+private:
+	struct PooledTexture
+	{
+		unsigned int Width;
+		unsigned int Height;
+		DXGI_FORMAT Format;
+		UINT BindFlags;
+		std::string PersistentName;	// Empty for shared ones
+		bool InUse;
+
+		ID3D11Texture2D* Texture;
+		ID3D11RenderTargetView* RTV;
+		ID3D11ShaderResourceView* SRV;
+		ID3D11DepthStencilView* DSV;
+	};
+
+	struct Resource
+	{
+		std::string Name;
+		FrameGraphTextureDesc Desc;
+		bool Imported;
+		bool Output;
+		bool Recreated;
+
+		ID3D11RenderTargetView* RTV;	// Imported only
+		ID3D11ShaderResourceView* SRV;
+		ID3D11DepthStencilView* DSV;
+		PooledTexture* Pooled;
+
+		unsigned int RefCount;
+		int FirstPass;
+		int LastPass;
+	};
+
+	struct Pass
+	{
+		std::string Name;
+		PassFunction Execute;
+		std::vector<FrameGraphResource> Reads;
+		std::vector<FrameGraphResource> Writes;
+		unsigned int RefCount;
+		bool Culled;
+	};
+
+	ID3D11Device* device;
+	unsigned int width;
+	unsigned int height;
+
+	std::vector<Resource> resources;
+	std::vector<Pass> passes;
+	std::vector<PooledTexture*> pool;
+
+	FrameGraphStats stats;
+
+	void Cull();
+	void Allocate();
+	PooledTexture* Acquire(Resource& resource);
+	PooledTexture* CreatePooledTexture(unsigned int texWidth, unsigned int texHeight, const FrameGraphTextureDesc& desc);
+	void ReleasePooledTexture(PooledTexture* texture);
+	static unsigned int BytesPerPixel(DXGI_FORMAT format);
+};
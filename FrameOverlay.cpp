@@ -0,0 +1,277 @@
+#include "FrameOverlay.h"
+#include "Profiler.h"
+
+#include <stdio.h>
+#include <string.h>
+
+using namespace DirectX;
+
+// Characters the font has, in the same order as OverlayPS
+static const char* GlyphOrder = " 0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ.:/%-()";
+
+// Layout, in screen pixels
+static const float FontScale = 2.0f;
+static const float GlyphAdvance = 4.0f * FontScale;
+static const float LineHeight = 7.0f * FontScale;
+static const float Margin = 8.0f;
+static const float Padding = 8.0f;
+static const float BarWidth = 3.0f;
+static const float GraphHeight = 80.0f;
+
+// How far back the percentiles and averages look
+static const float StatsSeconds = 5.0f;
+static const float TextRefreshSeconds = 0.25f;
+
+// Phases stacked in the graph, bottom up
+static const FramePhase GraphPhases[] =
+{
+	FRAME_PHASE_INPUT,
+	FRAME_PHASE_CULLING,
+	FRAME_PHASE_SUBMIT,
+	FRAME_PHASE_PRESENT,
+	FRAME_PHASE_WAIT,
+};
+
+static const XMFLOAT4 PhaseColors[FRAME_PHASE_COUNT] =
+{
+	XMFLOAT4(0.3f, 0.8f, 1.0f, 1.0f),	// Input
+	XMFLOAT4(1.0f, 0.9f, 0.3f, 1.0f),	// Culling
+	XMFLOAT4(0.4f, 1.0f, 0.4f, 1.0f),	// Submit
+	XMFLOAT4(1.0f, 0.4f, 0.9f, 1.0f),	// Present
+	XMFLOAT4(0.35f, 0.35f, 0.35f, 1.0f),	// Wait
+	XMFLOAT4(1.0f, 0.6f, 0.2f, 1.0f),	// Update
+};
+
+static const char* PhaseNames[FRAME_PHASE_COUNT] =
+{
+	"INPUT", "CULL", "SUBMIT", "PRESENT", "WAIT", "UPDATE"
+};
+
+FrameOverlay::FrameOverlay(ID3D11Device* device, RenderDevice* renderDevice, SimpleVertexShader* vs, SimplePixelShader* ps)
+{
+	this->renderDevice = renderDevice;
+	this->vs = vs;
+	this->ps = ps;
+
+	vertices.reserve(MaxQuads * 4);
+	screenWidth = 1.0f;
+	screenHeight = 1.0f;
+	nextTextTime = 0.0f;
+	memset(text, 0, sizeof(text));
+	memset(phaseAverages, 0, sizeof(phaseAverages));
+
+	RenderBufferDesc vbDesc;
+	vbDesc.Type = RENDER_BUFFER_VERTEX;
+	vbDesc.Size = sizeof(OverlayVertex) * MaxQuads * 4;
+	vbDesc.Dynamic = true;
+	vertexBuffer = renderDevice->CreateBuffer(vbDesc, 0);
+
+	// Every quad has the same shape, so the indices never change
+	std::vector<unsigned int> indices(MaxQuads * 6);
+	for (unsigned int q = 0; q < MaxQuads; q++)
+	{
+		unsigned int v = q * 4;
+		unsigned int* i = &indices[q * 6];
+		i[0] = v; i[1] = v + 1; i[2] = v + 2;
+		i[3] = v + 2; i[4] = v + 1; i[5] = v + 3;
+	}
+
+	RenderBufferDesc ibDesc;
+	ibDesc.Type = RENDER_BUFFER_INDEX;
+	ibDesc.Size = (unsigned int)(sizeof(unsigned int) * indices.size());
+	ibDesc.Dynamic = false;
+	indexBuffer = renderDevice->CreateBuffer(ibDesc, &indices[0]);
+
+	// Alpha blended over the scene, ignoring depth
+	D3D11_BLEND_DESC blendDesc = {};
+	blendDesc.RenderTarget[0].BlendEnable = true;
+	blendDesc.RenderTarget[0].SrcBlend = D3D11_BLEND_SRC_ALPHA;
+	blendDesc.RenderTarget[0].DestBlend = D3D11_BLEND_INV_SRC_ALPHA;
+	blendDesc.RenderTarget[0].BlendOp = D3D11_BLEND_OP_ADD;
+	blendDesc.RenderTarget[0].SrcBlendAlpha = D3D11_BLEND_ONE;
+	blendDesc.RenderTarget[0].DestBlendAlpha = D3D11_BLEND_ZERO;
+	blendDesc.RenderTarget[0].BlendOpAlpha = D3D11_BLEND_OP_ADD;
+	blendDesc.RenderTarget[0].RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_ALL;
+	device->CreateBlendState(&blendDesc, &blendState);
+
+	D3D11_DEPTH_STENCIL_DESC depthDesc = {};
+	depthDesc.DepthEnable = false;
+	depthDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ZERO;
+	depthDesc.DepthFunc = D3D11_COMPARISON_ALWAYS;
+	device->CreateDepthStencilState(&depthDesc, &depthState);
+
+	D3D11_RASTERIZER_DESC rastDesc = {};
+	rastDesc.FillMode = D3D11_FILL_SOLID;
+	rastDesc.CullMode = D3D11_CULL_NONE;
+	rastDesc.DepthClipEnable = true;
+	device->CreateRasterizerState(&rastDesc, &rasterizerState);
+}
+
+FrameOverlay::~FrameOverlay()
+{
+	renderDevice->DestroyBuffer(vertexBuffer);
+	renderDevice->DestroyBuffer(indexBuffer);
+	blendState->Release();
+	depthState->Release();
+	rasterizerState->Release();
+}
+
+// --------------------------------------------------------
+// A quad in screen pixels (y down)
+// --------------------------------------------------------
+void FrameOverlay::AddQuad(float x, float y, float w, float h, const XMFLOAT4& color, unsigned int glyph)
+{
+	if (vertices.size() >= MaxQuads * 4)
+		return;
+
+	float left = x / screenWidth * 2.0f - 1.0f;
+	float right = (x + w) / screenWidth * 2.0f - 1.0f;
+	float top = 1.0f - y / screenHeight * 2.0f;
+	float bottom = 1.0f - (y + h) / screenHeight * 2.0f;
+
+	OverlayVertex v;
+	v.Color = color;
+	v.Glyph = glyph;
+
+	v.Position = XMFLOAT2(left, top);		v.Cell = XMFLOAT2(0.0f, 0.0f);	vertices.push_back(v);
+	v.Position = XMFLOAT2(right, top);		v.Cell = XMFLOAT2(3.0f, 0.0f);	vertices.push_back(v);
+	v.Position = XMFLOAT2(left, bottom);	v.Cell = XMFLOAT2(0.0f, 5.0f);	vertices.push_back(v);
+	v.Position = XMFLOAT2(right, bottom);	v.Cell = XMFLOAT2(3.0f, 5.0f);	vertices.push_back(v);
+}
+
+// --------------------------------------------------------
+// One quad per visible character.  Lower case is drawn as
+// upper case, and anything the font lacks as a space.
+// Returns the x after the last character.
+// --------------------------------------------------------
+float FrameOverlay::AddText(float x, float y, const char* string, const XMFLOAT4& color)
+{
+	for (const char* c = string; *c; c++, x += GlyphAdvance)
+	{
+		char upper = (*c >= 'a' && *c <= 'z') ? *c - 'a' + 'A' : *c;
+		const char* found = strchr(GlyphOrder, upper);
+		if (!found || found == GlyphOrder)
+			continue;
+
+		AddQuad(x, y, 3.0f * FontScale, 5.0f * FontScale, color, (unsigned int)(found - GlyphOrder));
+	}
+	return x;
+}
+
+void FrameOverlay::UpdateText(FrameStats& stats, LatencyTracker& latency)
+{
+	FrameTimePercentiles frameTime, cpuTime;
+	stats.GetFrameTimePercentiles(StatsSeconds, frameTime, cpuTime);
+	stats.GetPhaseAverages(StatsSeconds, phaseAverages);
+
+	snprintf(text[0], sizeof(text[0]), "FRAME MS P50 %.2f P95 %.2f P99 %.2f MAX %.2f",
+		frameTime.P50, frameTime.P95, frameTime.P99, frameTime.Max);
+	snprintf(text[1], sizeof(text[1]), "CPU MS   P50 %.2f P95 %.2f P99 %.2f MAX %.2f",
+		cpuTime.P50, cpuTime.P95, cpuTime.P99, cpuTime.Max);
+	snprintf(text[2], sizeof(text[2]), "AVERAGE MS OVER %u FRAMES (%.0fS)", frameTime.Frames, StatsSeconds);
+
+	// Key press to Present(), over the last few hundred presses
+	unsigned int presses = latency.GetSampleCount();
+	if (presses > 0)
+		snprintf(text[3], sizeof(text[3]), "INPUT MS P50 %.1f P95 %.1f P99 %.1f (%u KEYS)",
+			latency.GetPercentile(50), latency.GetPercentile(95), latency.GetPercentile(99), presses);
+	else
+		snprintf(text[3], sizeof(text[3]), "INPUT MS - NO KEY PRESSES YET");
+}
+
+void FrameOverlay::Draw(FrameStats& stats, LatencyTracker& latency, unsigned int width, unsigned int height, float targetMs)
+{
+	PROFILE_FUNCTION();
+
+	if (stats.GetCount() == 0)
+		return;
+
+	screenWidth = (float)width;
+	screenHeight = (float)height;
+	vertices.clear();
+
+	float now = stats.GetFrame(0).EndTime;
+	if (now >= nextTextTime)
+	{
+		UpdateText(stats, latency);
+		nextTextTime = now + TextRefreshSeconds;
+	}
+
+	// Background panel
+	float graphWidth = GraphFrames * BarWidth;
+	float panelWidth = graphWidth + Padding * 2.0f;
+	float panelHeight = Padding * 3.0f + LineHeight * 6.0f + GraphHeight;
+	AddQuad(Margin, Margin, panelWidth, panelHeight, XMFLOAT4(0.0f, 0.0f, 0.0f, 0.6f));
+
+	XMFLOAT4 white(1.0f, 1.0f, 1.0f, 1.0f);
+	float x = Margin + Padding;
+	float y = Margin + Padding;
+	AddText(x, y, text[0], white);
+	y += LineHeight;
+	AddText(x, y, text[1], white);
+	y += LineHeight;
+	AddText(x, y, text[2], white);
+	y += LineHeight;
+	AddText(x, y, text[3], white);
+	y += LineHeight;
+
+	// Per phase averages, each in its graph color, over two lines
+	char label[32];
+	float lineX = x;
+	for (int p = 0; p < FRAME_PHASE_COUNT; p++)
+	{
+		if (p == FRAME_PHASE_PRESENT)
+		{
+			lineX = x;
+			y += LineHeight;
+		}
+
+		snprintf(label, sizeof(label), "%s %.2f  ", PhaseNames[p], phaseAverages[p]);
+		lineX = AddText(lineX, y, label, PhaseColors[p]);
+	}
+	y += LineHeight + Padding;
+
+	// Graph, newest frame on the right.  Twice the target
+	// frame time fills it, so the target sits in the middle.
+	float graphMs = targetMs > 0.0f ? targetMs * 2.0f : 33.3f;
+	float pixelsPerMs = GraphHeight / graphMs;
+	float graphBottom = y + GraphHeight;
+
+	unsigned int frames = stats.GetCount() < GraphFrames ? stats.GetCount() : GraphFrames;
+	for (unsigned int i = 0; i < frames; i++)
+	{
+		const FrameSample& frame = stats.GetFrame(i);
+		float barX = x + graphWidth - (i + 1) * BarWidth;
+		float barY = graphBottom;
+
+		for (size_t p = 0; p < sizeof(GraphPhases) / sizeof(GraphPhases[0]); p++)
+		{
+			float h = frame.Phases[GraphPhases[p]] * pixelsPerMs;
+			if (barY - h < y)
+				h = barY - y;
+			if (h < 0.25f)
+				continue;
+
+			barY -= h;
+			AddQuad(barX, barY, BarWidth - 1.0f, h, PhaseColors[GraphPhases[p]]);
+		}
+	}
+
+	if (targetMs > 0.0f)
+		AddQuad(x, graphBottom - targetMs * pixelsPerMs, graphWidth, 1.0f, XMFLOAT4(1.0f, 1.0f, 1.0f, 0.5f));
+
+	// Upload and draw it all at once.  The overlay shaders
+	// have no constants.
+	renderDevice->UpdateBuffer(vertexBuffer, &vertices[0], (unsigned int)(sizeof(OverlayVertex) * vertices.size()));
+
+	commands.Reset();
+	commands.SetRenderState(blendState, depthState, rasterizerState);
+	commands.SetPipeline(vs->GetInputLayout(), vs->GetDirectXShader(), ps->GetDirectXShader());
+	commands.SetVertexBuffer(0, vertexBuffer, sizeof(OverlayVertex));
+	commands.SetIndexBuffer(indexBuffer);
+	commands.DrawIndexed((unsigned int)(vertices.size() / 4 * 6));
+
+	// Back to the defaults everything else expects
+	commands.SetRenderState(0, 0, 0);
+	renderDevice->Execute(commands);
+}
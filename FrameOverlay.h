@@ -0,0 +1,72 @@
+#pragma once
+
+#include <d3d11.h>
+#include <DirectXMath.h>
+#include <vector>
+#include "FrameStats.h"
+#include "LatencyTracker.h"
+#include "SimpleShader.h"
+#include "RenderDevice.h"
+
+struct OverlayVertex
+{
+	DirectX::XMFLOAT2 Position;	// Clip space
+	DirectX::XMFLOAT2 Cell;		// Font pixel within the glyph
+	DirectX::XMFLOAT4 Color;
+	unsigned int Glyph;			// Index into the font, or SolidGlyph
+};
+
+// --------------------------------------------------------
+// Draws frame time stats in the corner of the screen: the
+// percentiles over the last few seconds, input latency,
+// average time per phase, and a graph of recent frames
+// stacked by phase.
+//
+// Everything - panel, text and graph - is quads in one
+// dynamic vertex buffer, drawn with a single call through
+// the render device.  Text
+// uses a tiny font built into OverlayPS, so there's no
+// texture.  Percentiles are only worked out a few times a
+// second; the graph is rebuilt every frame.
+// --------------------------------------------------------
+class FrameOverlay
+{
+public:
+	static const unsigned int SolidGlyph = 0xFFFFFFFF;
+
+	FrameOverlay(ID3D11Device* device, RenderDevice* renderDevice, SimpleVertexShader* vs, SimplePixelShader* ps);
+	~FrameOverlay();
+
+	// targetMs is the frame time being aimed for (0 if none),
+	// which sets the graph's scale
+	void Draw(FrameStats& stats, LatencyTracker& latency, unsigned int width, unsigned int height, float targetMs);
+
+private:
+	static const unsigned int MaxQuads = 1024;
+	static const unsigned int GraphFrames = 136;
+	static const unsigned int TextLines = 4;
+
+	RenderDevice* renderDevice;
+	SimpleVertexShader* vs;
+	SimplePixelShader* ps;
+
+	CommandHandle vertexBuffer;
+	CommandHandle indexBuffer;
+	CommandBuffer commands;
+	ID3D11BlendState* blendState;
+	ID3D11DepthStencilState* depthState;
+	ID3D11RasterizerState* rasterizerState;
+
+	std::vector<OverlayVertex> vertices;
+	float screenWidth;
+	float screenHeight;
+
+	// Refreshed a few times a second
+	float nextTextTime;
+	char text[TextLines][64];
+	float phaseAverages[FRAME_PHASE_COUNT];
+
+	void UpdateText(FrameStats& stats, LatencyTracker& latency);
+	void AddQuad(float x, float y, float w, float h, const DirectX::XMFLOAT4& color, unsigned int glyph = SolidGlyph);
+	float AddText(float x, float y, const char* string, const DirectX::XMFLOAT4& color);
+};
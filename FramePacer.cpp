@@ -0,0 +1,217 @@
+#include "FramePacer.h"
+#include <math.h>
+
+// Added in Windows 10 1803; older SDKs don't have it
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+// How much of each wait is spun rather than slept, for a
+// high resolution timer and for anything coarser
+static const double HighResolutionSpinSeconds = 0.0005;
+static const double SpinSeconds = 0.002;
+
+FramePacer::FramePacer()
+{
+	__int64 perfFreq;
+	QueryPerformanceFrequency((LARGE_INTEGER*)&perfFreq);
+	perfCounterSeconds = 1.0 / (double)perfFreq;
+
+	targetFps = 0.0f;
+	vsync = false;
+	period = 0;
+	nextDeadline = 0;
+	lastFrameStart = 0;
+
+	// High resolution timers wake within a fraction of a
+	// millisecond; anything else is only as good as the 1ms
+	// timer period DXCore asks for, plus scheduling
+	timer = CreateWaitableTimerExW(0, 0, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+	highResolutionTimer = timer != 0;
+	if (!timer)
+		timer = CreateWaitableTimerExW(0, 0, 0, TIMER_ALL_ACCESS);
+
+	double spinSeconds = highResolutionTimer ? HighResolutionSpinSeconds : SpinSeconds;
+	spinMargin = (__int64)(spinSeconds / perfCounterSeconds);
+
+	ResetStats();
+}
+
+FramePacer::~FramePacer()
+{
+	if (timer)
+		CloseHandle(timer);
+}
+
+void FramePacer::SetTargetFps(float fps)
+{
+	targetFps = fps > 0.0f ? fps : 0.0f;
+	period = targetFps > 0.0f ? (__int64)(1.0 / (targetFps * perfCounterSeconds)) : 0;
+	nextDeadline = 0;
+}
+
+__int64 FramePacer::Now()
+{
+	__int64 now;
+	QueryPerformanceCounter((LARGE_INTEGER*)&now);
+	return now;
+}
+
+// --------------------------------------------------------
+// Sleeps until the given time, or until a window message
+// shows up (returns false).  A timer that fails is dropped
+// for plain timed waits, so a bad handle can't turn the
+// wait into a busy loop.
+// --------------------------------------------------------
+bool FramePacer::SleepUntil(__int64 until)
+{
+	__int64 remaining = until - Now();
+	if (remaining <= 0)
+		return true;
+
+	if (timer)
+	{
+		// Negative due times are relative, in 100ns units
+		LARGE_INTEGER due;
+		due.QuadPart = -(LONGLONG)(remaining * perfCounterSeconds * 10000000.0);
+		if (SetWaitableTimer(timer, &due, 0, 0, 0, FALSE))
+		{
+			DWORD result = MsgWaitForMultipleObjectsEx(1, &timer, INFINITE, QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+			if (result == WAIT_OBJECT_0)
+				return true;
+			if (result == WAIT_OBJECT_0 + 1)
+			{
+				CancelWaitableTimer(timer);
+				return false;
+			}
+		}
+
+		CloseHandle(timer);
+		timer = 0;
+		highResolutionTimer = false;
+		spinMargin = (__int64)(SpinSeconds / perfCounterSeconds);
+
+		remaining = until - Now();
+		if (remaining <= 0)
+			return true;
+	}
+
+	// With no handles, WAIT_OBJECT_0 is the message
+	DWORD ms = (DWORD)(remaining * perfCounterSeconds * 1000.0);
+	DWORD result = MsgWaitForMultipleObjectsEx(0, 0, ms, QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+	if (result == WAIT_OBJECT_0)
+		return false;
+	if (result == WAIT_FAILED)
+		Sleep(ms);
+	return true;
+}
+
+bool FramePacer::Wait()
+{
+	__int64 now = Now();
+
+	if (period == 0)
+	{
+		MarkFrameStart(now);
+		return true;
+	}
+
+	// First frame, or after a change of rate
+	if (nextDeadline == 0)
+		nextDeadline = now;
+
+	if (now < nextDeadline - spinMargin)
+	{
+		if (!sleepStart)
+			sleepStart = now;
+
+		if (!SleepUntil(nextDeadline - spinMargin))
+			return false;
+
+		now = Now();
+		sleepSum += (now - sleepStart) * perfCounterSeconds;
+		sleepStart = 0;
+	}
+
+	// The last stretch is too short to trust the scheduler
+	// with, so burn it
+	spinStart = now;
+	while (now < nextDeadline)
+	{
+		YieldProcessor();
+		now = Now();
+	}
+	spinSum += (now - spinStart) * perfCounterSeconds;
+
+	MarkFrameStart(now);
+
+	// Stay on the ideal timeline, unless this frame started
+	// more than a frame after its deadline - then start a new
+	// one from here instead of rushing out frames to catch up
+	if (now - nextDeadline > period)
+		nextDeadline = now + period;
+	else
+		nextDeadline += period;
+
+	return true;
+}
+
+void FramePacer::MarkFrameStart(__int64 now)
+{
+	if (lastFrameStart)
+	{
+		double interval = (now - lastFrameStart) * perfCounterSeconds * 1000.0;
+		frames++;
+		intervalSum += interval;
+		intervalSquareSum += interval * interval;
+
+		if (targetFps > 0.0f)
+		{
+			double deviation = fabs(interval - 1000.0 / targetFps);
+			if (deviation > maxDeviation)
+				maxDeviation = deviation;
+		}
+		else
+		{
+			// No target to compare against, so keep the extremes
+			// and measure them against the average later
+			if (frames == 1 || interval < minInterval) minInterval = interval;
+			if (frames == 1 || interval > maxInterval) maxInterval = interval;
+		}
+	}
+	lastFrameStart = now;
+}
+
+FramePacerStats FramePacer::GetStats()
+{
+	FramePacerStats stats = {};
+	if (frames == 0)
+		return stats;
+
+	double average = intervalSum / frames;
+	double variance = intervalSquareSum / frames - average * average;
+
+	stats.Frames = frames;
+	stats.AverageMs = (float)average;
+	stats.JitterMs = (float)sqrt(variance > 0.0 ? variance : 0.0);
+	stats.MaxDeviationMs = targetFps > 0.0f ?
+		(float)maxDeviation :
+		(float)(maxInterval - average > average - minInterval ? maxInterval - average : average - minInterval);
+	stats.SleepMs = (float)(sleepSum * 1000.0 / frames);
+	stats.SpinMs = (float)(spinSum * 1000.0 / frames);
+	return stats;
+}
+
+void FramePacer::ResetStats()
+{
+	frames = 0;
+	intervalSum = 0.0;
+	intervalSquareSum = 0.0;
+	maxDeviation = 0.0;
+	minInterval = 0.0;
+	maxInterval = 0.0;
+	sleepSum = 0.0;
+	spinSum = 0.0;
+	sleepStart = 0;
+	spinStart = 0;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <Windows.h>
+
+struct FramePacerStats
+{
+	unsigned int Frames;
+	float AverageMs;		// Frame start to frame start
+	float JitterMs;			// Standard deviation of the above
+	float MaxDeviationMs;	// Worst frame, off the target (or the average if uncapped)
+	float SleepMs;			// Per frame, spent asleep
+	float SpinMs;			// Per frame, spent spinning
+};
+
+// --------------------------------------------------------
+// Holds the render loop to a target frame rate.
+//
+// Frames are scheduled on a fixed timeline of deadlines
+// rather than "now + period", so an early or late frame
+// doesn't push every later one around.  Waiting sleeps on
+// a high resolution waitable timer (or a plain timed wait
+// with 1ms resolution on older Windows) until just before
+// the deadline, then spins the rest of the way.
+//
+// The sleep also wakes for window messages, so input isn't
+// held up behind a frame that hasn't started yet.
+//
+// Vsync is applied through Present()'s sync interval; with
+// both set, the lower of the two rates wins.
+// --------------------------------------------------------
+class FramePacer
+{
+public:
+	FramePacer();
+	~FramePacer();
+
+	// Frames per second, or 0 to not limit
+	void SetTargetFps(float fps);
+	float GetTargetFps() { return targetFps; }
+
+	void SetVsync(bool vsync) { this->vsync = vsync; }
+	bool GetVsync() { return vsync; }
+	UINT GetSyncInterval() { return vsync ? 1 : 0; }
+
+	// Blocks until the next frame should start.  Returns false
+	// if a window message arrived first - pump it and call
+	// again; the deadline doesn't move.
+	bool Wait();
+
+	FramePacerStats GetStats();
+	void ResetStats();
+
+private:
+	double perfCounterSeconds;
+	float targetFps;
+	bool vsync;
+
+	HANDLE timer;
+	bool highResolutionTimer;
+
+	__int64 period;			// In performance counter ticks
+	__int64 spinMargin;		// How early to stop sleeping
+	__int64 nextDeadline;
+	__int64 lastFrameStart;
+
+	// Accumulated since ResetStats()
+	unsigned int frames;
+	double intervalSum;
+	double intervalSquareSum;
+	double maxDeviation;
+	double minInterval;
+	double maxInterval;
+	double sleepSum;
+	double spinSum;
+	__int64 sleepStart;
+	__int64 spinStart;
+
+	__int64 Now();
+	bool SleepUntil(__int64 until);
+	void MarkFrameStart(__int64 now);
+};
@@ -0,0 +1,139 @@
+#include "FrameStats.h"
+
+#include <algorithm>
+
+FrameStats::FrameStats(unsigned int capacity)
+{
+	__int64 perfFreq;
+	QueryPerformanceFrequency((LARGE_INTEGER*)&perfFreq);
+	perfCounterMs = 1000.0 / (double)perfFreq;
+
+	frames.resize(capacity);
+	head = 0;
+	count = 0;
+	current = {};
+	updateCounts = 0;
+
+	startTime = Now();
+	lastMark = startTime;
+}
+
+__int64 FrameStats::Now()
+{
+	__int64 now;
+	QueryPerformanceCounter((LARGE_INTEGER*)&now);
+	return now;
+}
+
+void FrameStats::Mark(FramePhase phase)
+{
+	__int64 now = Now();
+	current.Phases[phase] += (float)((now - lastMark) * perfCounterMs);
+	lastMark = now;
+}
+
+// --------------------------------------------------------
+// Called from the sim thread
+// --------------------------------------------------------
+void FrameStats::AddUpdateTime(__int64 counts)
+{
+	updateCounts += counts;
+}
+
+void FrameStats::EndFrame()
+{
+	// Whatever happened since the last mark counts as submit
+	Mark(FRAME_PHASE_SUBMIT);
+
+	current.Phases[FRAME_PHASE_UPDATE] = (float)(updateCounts.exchange(0) * perfCounterMs);
+	current.CpuMs =
+		current.Phases[FRAME_PHASE_INPUT] +
+		current.Phases[FRAME_PHASE_CULLING] +
+		current.Phases[FRAME_PHASE_SUBMIT] +
+		current.Phases[FRAME_PHASE_PRESENT];
+	current.FrameMs = current.CpuMs + current.Phases[FRAME_PHASE_WAIT];
+	current.EndTime = (float)((lastMark - startTime) * perfCounterMs / 1000.0);
+
+	frames[head] = current;
+	head = (head + 1) % frames.size();
+	if (count < frames.size())
+		count++;
+
+	current = {};
+}
+
+const FrameSample& FrameStats::GetFrame(unsigned int age)
+{
+	size_t size = frames.size();
+	return frames[(head + size - 1 - age) % size];
+}
+
+unsigned int FrameStats::CountRecent(float seconds)
+{
+	if (count == 0)
+		return 0;
+
+	float cutoff = GetFrame(0).EndTime - seconds;
+	unsigned int recent = 0;
+	while (recent < count && GetFrame(recent).EndTime >= cutoff)
+		recent++;
+	return recent;
+}
+
+void FrameStats::GetPercentiles(std::vector<float>& values, FrameTimePercentiles& percentiles)
+{
+	percentiles = {};
+	if (values.empty())
+		return;
+
+	// Each nth_element leaves everything above it bigger, so
+	// the next (higher) one only has to look there
+	size_t n = values.size();
+	size_t i50 = (n - 1) * 50 / 100;
+	size_t i95 = (n - 1) * 95 / 100;
+	size_t i99 = (n - 1) * 99 / 100;
+	std::nth_element(values.begin(), values.begin() + i50, values.end());
+	std::nth_element(values.begin() + i50, values.begin() + i95, values.end());
+	std::nth_element(values.begin() + i95, values.begin() + i99, values.end());
+
+	percentiles.Frames = (unsigned int)n;
+	percentiles.P50 = values[i50];
+	percentiles.P95 = values[i95];
+	percentiles.P99 = values[i99];
+	percentiles.Max = *std::max_element(values.begin() + i99, values.end());
+}
+
+void FrameStats::GetFrameTimePercentiles(float seconds, FrameTimePercentiles& frameTime, FrameTimePercentiles& cpuTime)
+{
+	unsigned int recent = CountRecent(seconds);
+
+	scratch.resize(recent);
+	for (unsigned int i = 0; i < recent; i++)
+		scratch[i] = GetFrame(i).FrameMs;
+	GetPercentiles(scratch, frameTime);
+
+	scratch.resize(recent);
+	for (unsigned int i = 0; i < recent; i++)
+		scratch[i] = GetFrame(i).CpuMs;
+	GetPercentiles(scratch, cpuTime);
+}
+
+void FrameStats::GetPhaseAverages(float seconds, float averages[FRAME_PHASE_COUNT])
+{
+	for (int p = 0; p < FRAME_PHASE_COUNT; p++)
+		averages[p] = 0.0f;
+
+	unsigned int recent = CountRecent(seconds);
+	if (recent == 0)
+		return;
+
+	for (unsigned int i = 0; i < recent; i++)
+	{
+		const FrameSample& frame = GetFrame(i);
+		for (int p = 0; p < FRAME_PHASE_COUNT; p++)
+			averages[p] += frame.Phases[p];
+	}
+
+	for (int p = 0; p < FRAME_PHASE_COUNT; p++)
+		averages[p] /= recent;
+}
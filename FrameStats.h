@@ -0,0 +1,87 @@
+#pragma once
+
+#include <Windows.h>
+#include <vector>
+#include <atomic>
+
+// --------------------------------------------------------
+// Where a frame's time goes.  Everything but Update is on
+// the render thread, one after the other; Update runs on
+// the sim thread alongside them.
+// --------------------------------------------------------
+enum FramePhase
+{
+	FRAME_PHASE_INPUT,		// Window messages
+	FRAME_PHASE_CULLING,	// Building the render queue
+	FRAME_PHASE_SUBMIT,		// The rest of Draw()
+	FRAME_PHASE_PRESENT,
+	FRAME_PHASE_WAIT,		// Frame pacing
+	FRAME_PHASE_UPDATE,		// Sim ticks that finished during the frame
+	FRAME_PHASE_COUNT
+};
+
+// --------------------------------------------------------
+// One frame's times, in milliseconds
+// --------------------------------------------------------
+struct FrameSample
+{
+	float Phases[FRAME_PHASE_COUNT];
+	float FrameMs;	// Start to start, all render thread phases
+	float CpuMs;	// The same without the pacing wait
+	float EndTime;	// Seconds, for picking out recent frames
+};
+
+struct FrameTimePercentiles
+{
+	unsigned int Frames;
+	float P50;
+	float P95;
+	float P99;
+	float Max;
+};
+
+// --------------------------------------------------------
+// A ring of the most recent frames' times, split by phase.
+//
+// The render thread calls Mark() at the end of each phase,
+// which charges the time since the previous Mark() to it,
+// and EndFrame() once the frame is done.  The sim thread
+// adds its Update() time with AddUpdateTime().
+// --------------------------------------------------------
+class FrameStats
+{
+public:
+	FrameStats(unsigned int capacity = 2048);
+
+	void Mark(FramePhase phase);
+	void AddUpdateTime(__int64 counts);
+	void EndFrame();
+
+	// Index 0 is the newest frame
+	unsigned int GetCount() { return count; }
+	const FrameSample& GetFrame(unsigned int age);
+
+	// Over the frames that ended in the last few seconds
+	// (or as many as the ring holds, if that's fewer)
+	void GetFrameTimePercentiles(float seconds, FrameTimePercentiles& frameTime, FrameTimePercentiles& cpuTime);
+	void GetPhaseAverages(float seconds, float averages[FRAME_PHASE_COUNT]);
+
+	__int64 Now();
+
+private:
+	double perfCounterMs;
+	__int64 startTime;
+	__int64 lastMark;
+
+	std::vector<FrameSample> frames;
+	unsigned int head;
+	unsigned int count;
+	FrameSample current;
+
+	std::atomic<__int64> updateCounts;
+
+	std::vector<float> scratch;
+
+	unsigned int CountRecent(float seconds);
+	static void GetPercentiles(std::vector<float>& values, FrameTimePercentiles& percentiles);
+};
@@ -0,0 +1,78 @@
+#include "Frustum.h"
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// Pulls the planes straight out of the combined matrix
+// (Gribb & Hartmann).  With row vectors the planes come from
+// the columns of view * projection, which are the rows of
+// the transposed matrices we keep.  D3D's depth goes from
+// 0 to 1, so the near plane is just the third column.
+// --------------------------------------------------------
+Frustum Frustum::FromViewProjection(const XMFLOAT4X4& view, const XMFLOAT4X4& projection)
+{
+	// (V * P)^T = P^T * V^T
+	XMMATRIX m = XMMatrixMultiply(XMLoadFloat4x4(&projection), XMLoadFloat4x4(&view));
+
+	XMVECTOR planes[6] =
+	{
+		m.r[3] + m.r[0],	// Left
+		m.r[3] - m.r[0],	// Right
+		m.r[3] + m.r[1],	// Bottom
+		m.r[3] - m.r[1],	// Top
+		m.r[2],				// Near
+		m.r[3] - m.r[2],	// Far
+	};
+
+	Frustum frustum;
+	for (int i = 0; i < 6; i++)
+		XMStoreFloat4(&frustum.Planes[i], XMPlaneNormalize(planes[i]));
+	return frustum;
+}
+
+// --------------------------------------------------------
+// Each plane is splatted across a register so four spheres
+// get tested against it at once.  A sphere is out if it's
+// entirely behind any one plane.
+// --------------------------------------------------------
+unsigned int Frustum::CullSpheres(const float* centerX, const float* centerY, const float* centerZ, const float* radius, unsigned int count, unsigned char* visible) const
+{
+	XMVECTOR planeX[6], planeY[6], planeZ[6], planeW[6];
+	for (int p = 0; p < 6; p++)
+	{
+		XMVECTOR plane = XMLoadFloat4(&Planes[p]);
+		planeX[p] = XMVectorSplatX(plane);
+		planeY[p] = XMVectorSplatY(plane);
+		planeZ[p] = XMVectorSplatZ(plane);
+		planeW[p] = XMVectorSplatW(plane);
+	}
+
+	unsigned int visibleCount = 0;
+	for (unsigned int i = 0; i < count; i += 4)
+	{
+		XMVECTOR x = XMLoadFloat4((const XMFLOAT4*)&centerX[i]);
+		XMVECTOR y = XMLoadFloat4((const XMFLOAT4*)&centerY[i]);
+		XMVECTOR z = XMLoadFloat4((const XMFLOAT4*)&centerZ[i]);
+		XMVECTOR negRadius = -XMLoadFloat4((const XMFLOAT4*)&radius[i]);
+
+		XMVECTOR inside = XMVectorTrueInt();
+		for (int p = 0; p < 6; p++)
+		{
+			XMVECTOR distance = XMVectorMultiplyAdd(x, planeX[p],
+				XMVectorMultiplyAdd(y, planeY[p],
+				XMVectorMultiplyAdd(z, planeZ[p], planeW[p])));
+			inside = XMVectorAndInt(inside, XMVectorGreaterOrEqual(distance, negRadius));
+		}
+
+		uint32_t result[4];
+		XMStoreInt4(result, inside);
+		unsigned int lanes = count - i < 4 ? count - i : 4;
+		for (unsigned int k = 0; k < lanes; k++)
+		{
+			visible[i + k] = result[k] ? 1 : 0;
+			visibleCount += visible[i + k];
+		}
+	}
+
+	return visibleCount;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+// --------------------------------------------------------
+// The six planes of a view frustum, normals pointing in,
+// so a point is inside when dot(plane, (p, 1)) >= 0 for
+// all of them
+// --------------------------------------------------------
+struct Frustum
+{
+	DirectX::XMFLOAT4 Planes[6];	// Left, right, bottom, top, near, far
+
+	// From transposed (HLSL-ready) view and projection matrices
+	static Frustum FromViewProjection(const DirectX::XMFLOAT4X4& view, const DirectX::XMFLOAT4X4& projection);
+
+	// Tests spheres given as separate arrays of centers and
+	// radii, four at a time.  visible[i] is set to 1 for
+	// spheres that touch the frustum, 0 for the rest.  Arrays
+	// must have room for count rounded up to a multiple of 4.
+	// Returns how many were visible.
+	unsigned int CullSpheres(const float* centerX, const float* centerY, const float* centerZ, const float* radius, unsigned int count, unsigned char* visible) const;
+};
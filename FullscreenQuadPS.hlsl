@@ -1,19 +0,0 @@
-
-// Defines the input to this pixel shader
-// - Should match the output of our corresponding vertex shader
-struct VertexToPixel
-{
-	float4 position		: SV_POSITION;
-	float2 uv           : TEXCOORD0;
-};
-
-// Textures and such
-Texture2D Pixels		: register(t0);
-SamplerState Sampler	: register(s0);
-
-
-// Entry point for this pixel shader
-float4 main(VertexToPixel input) : SV_TARGET
-{
-	return Pixels.Sample(Sampler, input.uv);
-}
\ No newline at end of file
@@ -1,16 +1,71 @@
 #include "Game.h"
+#include "Profiler.h"
 #include "Vertex.h"
 #include "Mesh.h"
 #include "Entity.h"
 #include "Camera.h"
+#include "Frustum.h"
+#include "AssetLoader.h"
+#include "ConstantRingBuffer.h"
+#include "StaticBatch.h"
+#include "D3D11RenderDevice.h"
+#include "NullRenderDevice.h"
+#include "FrameGraph.h"
+#include "FrameOverlay.h"
+#include "LightClusters.h"
 #include "WICTextureLoader.h"
 #include "DDSTextureLoader.h"
 #include <string>
 #include <iostream>
+#include <math.h>
+#include <float.h>
+#include <string.h>
+#include <algorithm>
 
 // For the DirectX Math library
 using namespace DirectX;
 
+// Load assets on the job system's workers at startup.
+// Set to 0 to load serially for timing comparisons.
+#define ASYNC_ASSET_LOADING 1
+
+// Write per-draw constants into one dynamic ring buffer
+// (needs D3D 11.1).  Set to 0 to use each shader's own
+// buffers with UpdateSubresource.
+#define CONSTANT_RING_BUFFER 1
+
+// Time the SoA world matrix build against per-entity builds
+// at startup (prints to the debug console)
+#define RUN_TRANSFORM_BENCHMARK 0
+
+// Record the opaque pass into command buffers on the job
+// system's workers, then play them back on the context.
+// Set to 0 to record it all on the render thread.
+#define PARALLEL_COMMAND_RECORDING 1
+
+// Time command buffer recording on several threads at once
+// at startup (prints to the debug console)
+#define RUN_COMMAND_BUFFER_BENCHMARK 0
+
+// Play command buffers back on a device that only counts
+// what it's given, to measure the CPU cost of a frame
+// without the GPU.  Only the clears and copies will show
+// up on screen.
+#define NULL_RENDER_DEVICE 0
+
+// Frame rate cap for the render loop (0 for uncapped), and
+// whether Present() waits for vsync on top of that
+#define TARGET_FRAME_RATE 144
+#define VSYNC 0
+
+// Draw frame time stats over the game
+#define FRAME_STATS_OVERLAY 1
+
+// Capture a profile of Init() (asset loading and setup) to
+// startup_trace.json.  Needs the profiler, so debug only
+// unless PROFILER_ENABLED is set.
+#define PROFILE_STARTUP 0
+
 // --------------------------------------------------------
 // Constructor
 //
@@ -34,10 +89,38 @@ Game::Game(HINSTANCE hInstance)
 
 	isMouseDown = false;
 	camera = new Camera(width, height);
-	
+
+	simTick = 0;
+	pendingMouseX = 0;
+	pendingMouseY = 0;
+
+	jobs = new JobSystem();
+	nextJobStatsTime = 5.0f;
+	nextRenderStatsTime = 5.0f;
+	stateCache = 0;
+	constantRing = 0;
+	wallBatch = 0;
+	renderDevice = 0;
+	recordTicks = 0;
+	recordedCommands = 0;
+	statsFrameCount = 0;
+	culledCount = 0;
+	refractionCopiedPixels = 0;
+	refractionNeededTiles = 0;
+	refractionCopiedTiles = 0;
+	prevOpaqueKnown = false;
+	frameGraph = 0;
+	overlayVS = 0;
+	overlayPS = 0;
+	frameOverlay = 0;
+	lightClusters = 0;
+	simTime = 0.0f;
 
 	prevMousePos = { 0,0 };
 
+	framePacer.SetTargetFps(TARGET_FRAME_RATE);
+	framePacer.SetVsync(VSYNC != 0);
+
 #if defined(DEBUG) || defined(_DEBUG)
 	// Do we want a console window?  Probably only in debug mode
 	CreateConsoleWindow(500, 120, 32, 120);
@@ -88,10 +171,15 @@ Game::~Game()
 	
 	SamplerStatePtr->Release();
 
+	perFrameBuffer->Release();
+	delete constantRing;
+	delete wallBatch;
+	for (size_t i = 0; i < commandBuffers.size(); i++)
+		delete commandBuffers[i];
+
 	//Release refraction ptrs
 	refractSampler->Release();
-	refractionRTV->Release();
-	refractionSRV->Release();
+	delete frameGraph;
 
 	// Delete our simple shader objects, which
 	// will clean up their own internal DirectX stuff
@@ -99,8 +187,6 @@ Game::~Game()
 	delete pixelShader;
 	delete rVertexShader;
 	delete rPixelShader;
-	delete quadVS;
-	delete quadPS;
 	delete camera;
 
 	delete tetromino;
@@ -112,6 +198,22 @@ Game::~Game()
 	delete skyVS;
 	delete skyPS;
 
+	delete frameOverlay;
+	delete lightClusters;
+	delete overlayVS;
+	delete overlayPS;
+
+	delete instancedVS;
+	delete instancedRefractVS;
+	delete opaqueInstances;
+	delete refractInstances;
+
+	// The instance renderers and the overlay made their
+	// buffers through it
+	delete renderDevice;
+
+	delete jobs;
+
 
 	for (int i = 0; i < meshArr.size(); i++) {
 		delete meshArr[i];
@@ -119,6 +221,8 @@ Game::~Game()
 	for (int i = 0; i < entityArr.size(); i++) {
 		delete entityArr[i];
 	}
+
+	StateCache::Destroy(context);
 }
 
 // --------------------------------------------------------
@@ -127,28 +231,79 @@ Game::~Game()
 // --------------------------------------------------------
 void Game::Init()
 {
+#if PROFILE_STARTUP && PROFILER_ENABLED
+	Profiler::BeginCapture();
+#endif
+
+	stateCache = StateCache::Get(context);
+
 	camera->UpdateProjectionMatrix(width, height);
-	// Helper methods for loading shaders, creating some basic
-	// geometry to draw and some simple camera matrices.
+
+	// File reads, decoding and parsing happen on the workers,
+	// then the D3D objects are all created here
+#if ASYNC_ASSET_LOADING
+	AssetLoader loader(device, context, jobs);
+#else
+	AssetLoader loader(device, context, 0);
+#endif
+	LoadShaders(&loader);
+	LoadAssets(&loader);
+	loader.Finish();
+	loader.PrintTimings();
+
+	// The instance renderers and the overlay make their
+	// buffers through the render device, so it comes first
+#if CONSTANT_RING_BUFFER
+	if (ConstantRingBuffer::IsSupported(device, context))
+	{
+		constantRing = new ConstantRingBuffer(device, context);
+		vertexShader->SetConstantRingBuffer(constantRing);
+		pixelShader->SetConstantRingBuffer(constantRing);
+		rVertexShader->SetConstantRingBuffer(constantRing);
+		rPixelShader->SetConstantRingBuffer(constantRing);
+		instancedVS->SetConstantRingBuffer(constantRing);
+		instancedRefractVS->SetConstantRingBuffer(constantRing);
+	}
+	else
+	{
+		printf("Constant buffer offsetting not supported - using per-shader buffers\n");
+	}
+#endif
+
+#if NULL_RENDER_DEVICE
+	renderDevice = new NullRenderDevice();
+#else
+	renderDevice = new D3D11RenderDevice(device, context, constantRing);
+#endif
+
+	// Helper methods for creating some basic geometry
+	// to draw and some simple camera matrices.
 	//  - You'll be expanding and/or replacing these later
-	LoadShaders();
 	CreateMatrices();
 	CreateBasicGeometry();
 
 	//Create Light objects
 	light = { XMFLOAT4(0.05f, 0.05f, 0.05f, 1.0f), XMFLOAT4(0.9f, 0.95f, 0.95f, 1), XMFLOAT3(0, 0, 0.85f) };
-	pixelShader->SetData(
-		"light",
-		&light,
-		sizeof(DirectionalLight));
-
 	light2 = { XMFLOAT4(0.05f, 0.05f, 0.05f, 1.0f), XMFLOAT4(0.75f, 0.7f, 0.65f, 1), XMFLOAT3(0, -0.95, 0) };
-	pixelShader->SetData(
-		"light2",
-		&light2,
-		sizeof(DirectionalLight));
 
-	CreateDDSTextureFromFile(device, L"Assets/Textures/BeachCubeMap.dds", 0, &skySRV);
+	// Per-frame constants - one buffer, bound to b0 by every shader
+	perFrameData = {};
+	perFrameData.Light = light;
+	perFrameData.Light2 = light2;
+
+	D3D11_BUFFER_DESC frameDesc = {};
+	frameDesc.ByteWidth = sizeof(PerFrameData);
+	frameDesc.Usage = D3D11_USAGE_DEFAULT;
+	frameDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	device->CreateBuffer(&frameDesc, 0, &perFrameBuffer);
+
+	ShareFrameConstants(vertexShader);
+	ShareFrameConstants(pixelShader);
+	ShareFrameConstants(rVertexShader);
+	ShareFrameConstants(rPixelShader);
+	ShareFrameConstants(skyVS);
+	ShareFrameConstants(instancedVS);
+	ShareFrameConstants(instancedRefractVS);
 
 	// Create a sampler state
 	D3D11_SAMPLER_DESC sampDesc = {};
@@ -175,39 +330,14 @@ void Game::Init()
 	device->CreateDepthStencilState(&ds, &skyDepthState);
 
 	// Refraction setup ------------------------
-	ID3D11Texture2D* refractionRenderTexture;
-
-	// Set up render texture
-	D3D11_TEXTURE2D_DESC rtDesc = {};
-	rtDesc.Width = width;
-	rtDesc.Height = height;
-	rtDesc.MipLevels = 1;
-	rtDesc.ArraySize = 1;
-	rtDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-	rtDesc.Usage = D3D11_USAGE_DEFAULT;
-	rtDesc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
-	rtDesc.CPUAccessFlags = 0;
-	rtDesc.MiscFlags = 0;
-	rtDesc.SampleDesc.Count = 1;
-	rtDesc.SampleDesc.Quality = 0;
-	device->CreateTexture2D(&rtDesc, 0, &refractionRenderTexture);
-
-	// Set up render target view
-	D3D11_RENDER_TARGET_VIEW_DESC rtvDesc = {};
-	rtvDesc.Format = rtDesc.Format;
-	rtvDesc.ViewDimension = D3D11_RTV_DIMENSION_TEXTURE2D;
-	rtvDesc.Texture2D.MipSlice = 0;
-	device->CreateRenderTargetView(refractionRenderTexture, &rtvDesc, &refractionRTV);
-
-	// Set up shader resource view for same texture
-	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-	srvDesc.Format = rtDesc.Format;
-	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
-	srvDesc.Texture2D.MipLevels = 1;
-	srvDesc.Texture2D.MostDetailedMip = 0;
-	device->CreateShaderResourceView(refractionRenderTexture, &srvDesc, &refractionSRV);
-
-	refractionRenderTexture->Release();
+	// The scene texture itself comes from the frame graph
+	frameGraph = new FrameGraph(device, width, height);
+
+	frameOverlay = new FrameOverlay(device, renderDevice, overlayVS, overlayPS);
+	lightClusters = new LightClusters(device, context);
+	refractionTiles.Resize(width, height);
+	refractionValid.Resize(width, height);
+	refractionDirty.Resize(width, height);
 
 	D3D11_SAMPLER_DESC rSamp = {};
 	rSamp.AddressU = D3D11_TEXTURE_ADDRESS_CLAMP;
@@ -222,48 +352,107 @@ void Game::Init()
 	// Tell the input assembler stage of the pipeline what kind of
 	// geometric primitives (points, lines or triangles) we want to draw.  
 	// Essentially: "What kind of shape should the GPU draw with our data?"
-	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	stateCache->SetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+	// Give Draw something to render before the sim thread's first tick
+	camera->Update(0);
+	prevCameraPosition = camera->GetPosition();
+	prevCameraRotation = XMFLOAT2(camera->GetRotationX(), camera->GetRotationY());
+	PublishSnapshot();
+#if RUN_TRANSFORM_BENCHMARK
+	TransformStore::RunBenchmark(100000);
+#endif
+#if RUN_COMMAND_BUFFER_BENCHMARK
+	CommandBuffer::RunBenchmark(jobs->GetWorkerCount(), 10000);
+#endif
 
+#if PROFILE_STARTUP && PROFILER_ENABLED
+	Profiler::EndCapture("startup_trace.json");
+#endif
 }
 
 // --------------------------------------------------------
-// Loads shaders from compiled shader object (.cso) files using
+// Queues up shaders from compiled shader object (.cso) files using
 // my SimpleShader wrapper for DirectX shader manipulation.
 // - SimpleShader provides helpful methods for sending
 //   data to individual variables on the GPU
 // --------------------------------------------------------
-void Game::LoadShaders()
+void Game::LoadShaders(AssetLoader* loader)
 {
 	//Lighting shaders
 	vertexShader = new SimpleVertexShader(device, context);
-	vertexShader->LoadShaderFile(L"VertexShader.cso");
+	loader->LoadShader(L"VertexShader.cso", vertexShader);
 
 	pixelShader = new SimplePixelShader(device, context);
-	pixelShader->LoadShaderFile(L"PixelShader.cso");
+	loader->LoadShader(L"PixelShader.cso", pixelShader);
 
 	// Refraction shaders
-	quadVS = new SimpleVertexShader(device, context);
-	quadVS->LoadShaderFile(L"FullscreenQuadVS.cso");
-
-	quadPS = new SimplePixelShader(device, context);
-	quadPS->LoadShaderFile(L"FullscreenQuadPS.cso");
-
 	rVertexShader = new SimpleVertexShader(device, context);
-	rVertexShader->LoadShaderFile(L"RefractVS.cso");
+	loader->LoadShader(L"RefractVS.cso", rVertexShader);
 
 	rPixelShader = new SimplePixelShader(device, context);
-	rPixelShader->LoadShaderFile(L"RefractPS.cso");
+	loader->LoadShader(L"RefractPS.cso", rPixelShader);
 
 	// Skybox shaders
 	skyVS = new SimpleVertexShader(device, context);
-	skyVS->LoadShaderFile(L"VSSky.cso");
+	loader->LoadShader(L"VSSky.cso", skyVS);
 
 	skyPS = new SimplePixelShader(device, context);
-	skyPS->LoadShaderFile(L"PSSky.cso");
+	loader->LoadShader(L"PSSky.cso", skyPS);
+
+	// Stats overlay shaders
+	overlayVS = new SimpleVertexShader(device, context);
+	loader->LoadShader(L"OverlayVS.cso", overlayVS);
+
+	overlayPS = new SimplePixelShader(device, context);
+	loader->LoadShader(L"OverlayPS.cso", overlayPS);
+
+	// Instancing shaders
+	instancedVS = new SimpleVertexShader(device, context);
+	loader->LoadShader(L"InstancedVS.cso", instancedVS);
+
+	instancedRefractVS = new SimpleVertexShader(device, context);
+	loader->LoadShader(L"InstancedRefractVS.cso", instancedRefractVS);
 }
 
 
 
+// --------------------------------------------------------
+// Queues up the textures and models.  Nothing is usable
+// until the loader has finished.
+// --------------------------------------------------------
+void Game::LoadAssets(AssetLoader* loader)
+{
+	//Load in textures
+	loader->LoadTexture(L"Assets/Textures/brick.png", &brickAlbedo);
+	loader->LoadTexture(L"Assets/Textures/brick_normals.png", &brickNormal);
+	loader->LoadTexture(L"Assets/Textures/brick_metal.png", &brickMetal);
+	loader->LoadTexture(L"Assets/Textures/brick_roughness.png", &brickRoughness);
+
+	loader->LoadTexture(L"Assets/Textures/mrcrabs.jpg", &crabAlbedo);
+	loader->LoadTexture(L"Assets/Textures/mrcrabs_normals.png", &crabNormal);
+	loader->LoadTexture(L"Assets/Textures/mrcrabs_metal.png", &crabMetal);
+	loader->LoadTexture(L"Assets/Textures/mrcrabs_roughness.png", &crabRoughness);
+
+	loader->LoadTexture(L"Assets/Textures/rblock.png", &rblockAlbedo);
+	loader->LoadTexture(L"Assets/Textures/oblock.png", &oblockAlbedo);
+	loader->LoadTexture(L"Assets/Textures/gblock.png", &gblockAlbedo);
+	loader->LoadTexture(L"Assets/Textures/bblock.png", &bblockAlbedo);
+	loader->LoadTexture(L"Assets/Textures/pblock.png", &pblockAlbedo);
+
+	loader->LoadTexture(L"Assets/Textures/block_normals.png", &blockNormal);
+	loader->LoadTexture(L"Assets/Textures/block_metal.png", &blockMetal);
+	loader->LoadTexture(L"Assets/Textures/block_roughness.png", &blockRoughness);
+
+	loader->LoadDDSTexture(L"Assets/Textures/BeachCubeMap.dds", &skySRV);
+
+	// Cube is meshArr[0], crab is meshArr[1].  The walls are
+	// baked from the cube, so it keeps its vertices around.
+	meshArr.resize(2);
+	loader->LoadMesh("Assets/Models/cube.obj", &meshArr[0], true);
+	loader->LoadMesh("Assets/Models/crab.obj", &meshArr[1]);
+}
+
 // --------------------------------------------------------
 // Initializes the matrices necessary to represent our geometry's 
 // transformations and our 3D camera
@@ -361,30 +550,6 @@ void Game::CreateBasicGeometry()
 	Vertex* vertPtr3 = vertices3;
 	meshArr.push_back(new Mesh(vertPtr3, 4, indices2, 6, device));*/
 
-	//Load in textures
-	std::string cubeUrl = "Assets/Models/cube.obj";
-	std::string crabUrl = "Assets/Models/crab.obj";
-	
-	CreateWICTextureFromFile(device, context, L"Assets/Textures/brick.png", 0, &brickAlbedo);
-	CreateWICTextureFromFile(device, context, L"Assets/Textures/brick_normals.png", 0, &brickNormal);
-	CreateWICTextureFromFile(device, context, L"Assets/Textures/brick_metal.png", 0, &brickMetal);
-	CreateWICTextureFromFile(device, context, L"Assets/Textures/brick_roughness.png", 0, &brickRoughness);
-
-	CreateWICTextureFromFile(device, context, L"Assets/Textures/mrcrabs.jpg", 0, &crabAlbedo);
-	CreateWICTextureFromFile(device, context, L"Assets/Textures/mrcrabs_normals.png", 0, &crabNormal);
-	CreateWICTextureFromFile(device, context, L"Assets/Textures/mrcrabs_metal.png", 0, &crabMetal);
-	CreateWICTextureFromFile(device, context, L"Assets/Textures/mrcrabs_roughness.png", 0, &crabRoughness);
-
-	CreateWICTextureFromFile(device, context, L"Assets/Textures/rblock.png", 0, &rblockAlbedo);
-	CreateWICTextureFromFile(device, context, L"Assets/Textures/oblock.png", 0, &oblockAlbedo);
-	CreateWICTextureFromFile(device, context, L"Assets/Textures/gblock.png", 0, &gblockAlbedo);
-	CreateWICTextureFromFile(device, context, L"Assets/Textures/bblock.png", 0, &bblockAlbedo);
-	CreateWICTextureFromFile(device, context, L"Assets/Textures/pblock.png", 0, &pblockAlbedo);
-
-	CreateWICTextureFromFile(device, context, L"Assets/Textures/block_normals.png", 0, &blockNormal);
-	CreateWICTextureFromFile(device, context, L"Assets/Textures/block_metal.png", 0, &blockMetal);
-	CreateWICTextureFromFile(device, context, L"Assets/Textures/block_roughness.png", 0, &blockRoughness);
-	
 	//Sampler for lighting
 	D3D11_SAMPLER_DESC SamplerDesc = {};
 	SamplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_WRAP;
@@ -395,7 +560,6 @@ void Game::CreateBasicGeometry()
 
 	device->CreateSamplerState(&SamplerDesc, &SamplerStatePtr);
 
-	meshArr.push_back(new Mesh(&cubeUrl[0], device));
 	//Material(SimpleVertexShader * vertShaderPtr, SimplePixelShader * pixelShaderPtr, DirectX::XMFLOAT4 color, float shininess, DirectX::XMFLOAT2 uvScale, ID3D11ShaderResourceView * albedo, ID3D11ShaderResourceView * normals, ID3D11ShaderResourceView * roughness, ID3D11ShaderResourceView * metal, ID3D11SamplerState * samplerState);
 	
 	//Materials for the bricks, crab, and gems
@@ -403,20 +567,32 @@ void Game::CreateBasicGeometry()
 	crabMaterial = new Material(vertexShader, pixelShader, XMFLOAT4(1, 1, 1, 1), 1024.0f, XMFLOAT2(2, 2), crabAlbedo, crabNormal, crabRoughness, crabMetal, SamplerStatePtr);
 	rBlockMaterial = new Material(rVertexShader, rPixelShader, XMFLOAT4(1, 1, 1, 1), 1024.0f, XMFLOAT2(2, 2), rblockAlbedo, blockNormal, blockRoughness, blockMetal, SamplerStatePtr);
 
-	//Create objects in arrays
+	// Everything shares a handful of meshes, so draw them instanced
+	brickMaterial->SetInstancedVertexShader(instancedVS);
+	crabMaterial->SetInstancedVertexShader(instancedVS);
+	rBlockMaterial->SetInstancedVertexShader(instancedRefractVS);
+
+	opaqueInstances = new InstanceRenderer(renderDevice);
+	refractInstances = new InstanceRenderer(renderDevice);
+
+	//The well never moves, so bake its bricks into one mesh
+	//that's drawn in a single call
+	wallBatch = new StaticBatch();
+	XMFLOAT3 noRotation(0, 0, 0);
+	XMFLOAT3 unitScale(1, 1, 1);
 	for (int i = 0; i < 12; i++) //this is the bottom i assume
 	{
-		entityArr.push_back(new Entity(meshArr[0], context, brickMaterial, XMFLOAT3(i - 5.5f, -10, 0)));
+		wallBatch->Add(meshArr[0], TransformStore::BuildWorldMatrix(XMFLOAT3(i - 5.5f, -10, 0), noRotation, unitScale), brickMaterial);
 	}
 
 	for (int i = 0; i < 21; i++)
 	{
-		entityArr.push_back(new Entity(meshArr[0], context, brickMaterial, XMFLOAT3(-5.5, i - 9.0f, 0))); //one side
+		wallBatch->Add(meshArr[0], TransformStore::BuildWorldMatrix(XMFLOAT3(-5.5, i - 9.0f, 0), noRotation, unitScale), brickMaterial); //one side
 
-		entityArr.push_back(new Entity(meshArr[0], context, brickMaterial, XMFLOAT3(5.5, i - 9.0f, 0))); //the other side
+		wallBatch->Add(meshArr[0], TransformStore::BuildWorldMatrix(XMFLOAT3(5.5, i - 9.0f, 0), noRotation, unitScale), brickMaterial); //the other side
 	}
 
-	meshArr.push_back(new Mesh(&crabUrl[0], device));
+	wallBatch->Build(device, context, entityArr);
 
 	crab = new Player(meshArr[1], context, crabMaterial);
 
@@ -452,6 +628,10 @@ void Game::OnResize()
 	// Handle base-level DX resize stuff
 	DXCore::OnResize();
 
+	// That rebound the render targets behind the cache's back
+	if (stateCache)
+		stateCache->Invalidate();
+
 	// Update our projection matrix since the window size changed
 	/*XMMATRIX P = XMMatrixPerspectiveFovLH(
 		0.25f * 3.1415926535f,	// Field of View Angle
@@ -460,16 +640,48 @@ void Game::OnResize()
 		100.0f);			  	// Far clip plane distance
 	XMStoreFloat4x4(&projectionMatrix, XMMatrixTranspose(P)); // Transpose for HLSL!*/
 	camera->UpdateProjectionMatrix(width, height);
+
+	// Screen-sized targets get remade at the new size
+	if (frameGraph)
+		frameGraph->Resize(width, height);
+	refractionTiles.Resize(width, height);
+	refractionValid.Resize(width, height);
+	refractionDirty.Resize(width, height);
+	prevOpaqueKnown = false;
 }
 
 // --------------------------------------------------------
 // Update your game here - user input, move objects, AI, etc.
+//
+// This runs on the sim thread - it must not touch the
+// device context, and everything Draw needs goes out
+// through PublishSnapshot() at the end.
 // --------------------------------------------------------
 void Game::Update(float deltaTime, float totalTime)
 {
+	PROFILE_FUNCTION();
+
+	// Anything pressed since last tick is read this tick
+	inputLatency.ConsumeInputs(simTick + 1);
+
+	// Remember where everything started this tick, so Draw
+	// can blend towards where it ends up
+	for (unsigned int i = 0; i < entityArr.size(); i++)
+		entityArr[i]->SaveTickState();
+	prevCameraPosition = camera->GetPosition();
+	prevCameraRotation = XMFLOAT2(camera->GetRotationX(), camera->GetRotationY());
+
+	// Apply any mouse look that arrived since last tick
+	int mouseX = pendingMouseX.exchange(0);
+	int mouseY = pendingMouseY.exchange(0);
+	if (mouseX != 0 || mouseY != 0)
+		camera->SetRotation(camera->GetRotationX() + mouseY / 100.0f, camera->GetRotationY() + mouseX / 100.0f);
+
+	simTime = totalTime;
+
 	camera->Update(deltaTime);
 
-	crab->Update(deltaTime,blockArr);
+	crab->Update(deltaTime,blockArr, inputLatency);
 
 	tetromino->Update(totalTime*3,blockArr, crab);
 
@@ -489,130 +701,796 @@ void Game::Update(float deltaTime, float totalTime)
 	// Quit if the escape key is pressed
 	if (GetAsyncKeyState(VK_ESCAPE))
 		Quit();
+
+#if defined(DEBUG) || defined(_DEBUG)
+	// Dump worker utilization every few seconds
+	if (totalTime >= nextJobStatsTime)
+	{
+		for (unsigned int i = 0; i < jobs->GetWorkerCount(); i++)
+		{
+			JobWorkerStats stats = jobs->GetWorkerStats(i);
+			printf("Worker %u: %u jobs (%u stolen), %.1f%% busy\n",
+				i, stats.JobsExecuted, stats.JobsStolen, stats.Utilization * 100.0);
+		}
+		jobs->ResetStats();
+		nextJobStatsTime = totalTime + 5.0f;
+	}
+#endif
+
+	PublishSnapshot();
 }
 
-// Draws the specified texture to the screen
-void Game::DrawFullscreenQuad(ID3D11ShaderResourceView* texture)
+// --------------------------------------------------------
+// Copies everything the renderer needs out of the sim state
+// and hands it to the render thread.  Never waits on Draw.
+// --------------------------------------------------------
+void Game::PublishSnapshot()
 {
-	// First, turn off our buffers, as we'll be generating the vertex
-	// data on the fly in a special vertex shader using the index of each vert
-	context->IASetVertexBuffers(0, 0, 0, 0, 0);
-	context->IASetIndexBuffer(0, DXGI_FORMAT_R32_UINT, 0);
+	PROFILE_FUNCTION();
+
+	RenderSnapshot& snapshot = snapshots.GetWriteBuffer();
+
+	snapshot.tick = ++simTick;
+	snapshot.publishTime = GetElapsedTime();
+	snapshot.tickInterval = 1.0f / simTickRate;
+
+	snapshot.prevCameraPosition = prevCameraPosition;
+	snapshot.prevCameraRotation = prevCameraRotation;
+	snapshot.cameraPosition = camera->GetPosition();
+	snapshot.cameraRotation = XMFLOAT2(camera->GetRotationX(), camera->GetRotationY());
+
+	// Every changed world matrix in one pass, so the items
+	// below just copy theirs
+	Entity::UpdateWorldMatrices();
+
+	// Reuses the vector's storage from three ticks ago.  Each item
+	// only touches its own entity, so they're filled in parallel.
+	// The render thread records on the same pool, but a thread
+	// outside the pool only helps with its own chunks while it
+	// waits (see JobSystem::Wait), so neither side can end up
+	// running - and waiting on - the other's work.  At worst a
+	// worker busy with a render chunk makes us do more of ours.
+	snapshot.items.resize(entityArr.size());
+	jobs->ParallelFor((unsigned int)entityArr.size(), 64, [&](unsigned int begin, unsigned int end)
+	{
+		for (unsigned int i = begin; i < end; i++)
+		{
+			Entity* e = entityArr[i];
+			RenderItem& item = snapshot.items[i];
 
-	// Set up the fullscreen quad shaders
-	quadVS->SetShader();
+			item.entity = e;
+			item.world = e->GetWorldMatrix();
+			item.visible = e->visible;
 
-	quadPS->SetShaderResourceView("Pixels", texture);
-	quadPS->SetSamplerState("Sampler", samplerOptions);
-	quadPS->SetShader();
+			item.position = e->GetPosition();
+			item.rotation = XMFLOAT3(e->GetRotationX(), e->GetRotationY(), e->GetRotationZ());
+			item.scale = e->GetScale();
 
-	// Draw
-	context->Draw(3, 0);
+			// Entities created during this tick have nothing to blend from
+			if (e->HasPrevTickState())
+			{
+				item.prevPosition = e->GetPrevPosition();
+				item.prevRotation = e->GetPrevRotation();
+				item.prevScale = e->GetPrevScale();
+			}
+			else
+			{
+				item.prevPosition = item.position;
+				item.prevRotation = item.rotation;
+				item.prevScale = item.scale;
+			}
+
+			item.moved =
+				memcmp(&item.prevPosition, &item.position, sizeof(XMFLOAT3)) != 0 ||
+				memcmp(&item.prevRotation, &item.rotation, sizeof(XMFLOAT3)) != 0 ||
+				memcmp(&item.prevScale, &item.scale, sizeof(XMFLOAT3)) != 0;
+		}
+	});
+
+	// Lights go out at their end of tick positions - blocks
+	// only ever move a whole step at a time anyway
+	snapshot.lights.clear();
+
+	// A dim glow in front of every settled block and a brighter
+	// one for the falling piece, with a spot over it
+	XMFLOAT3 fallingCenter(0.0f, 0.0f, 0.0f);
+	unsigned int fallingCount = 0;
+	for (size_t i = 0; i < blockArr.size(); i++)
+	{
+		Block* block = blockArr[i];
+		if (!block->visible)
+			continue;
+
+		XMFLOAT3 position = block->GetPosition();
+		position.z -= 0.75f;
+		if (block->settled)
+		{
+			snapshot.lights.push_back(MakePointLight(position, 1.5f, XMFLOAT3(0.35f, 0.3f, 0.25f)));
+		}
+		else
+		{
+			snapshot.lights.push_back(MakePointLight(position, 2.5f, XMFLOAT3(1.5f, 0.8f, 0.3f)));
+			fallingCenter.x += position.x;
+			fallingCenter.y += position.y;
+			fallingCount++;
+		}
+	}
+
+	if (fallingCount > 0)
+	{
+		XMFLOAT3 spotPosition(fallingCenter.x / fallingCount, fallingCenter.y / fallingCount + 4.0f, -1.0f);
+		snapshot.lights.push_back(MakeSpotLight(spotPosition, XMFLOAT3(0.0f, -1.0f, 0.0f), 12.0f,
+			XMFLOAT3(2.0f, 2.0f, 1.8f), 0.35f, 0.55f));
+	}
+
+	// Cleared lines flash white and fade out
+	const float flashLength = 0.5f;
+	for (size_t i = 0; i < lineFlashes.size();)
+	{
+		float fade = 1.0f - (simTime - lineFlashes[i].StartTime) / flashLength;
+		if (fade <= 0.0f)
+		{
+			lineFlashes[i] = lineFlashes.back();
+			lineFlashes.pop_back();
+			continue;
+		}
+
+		snapshot.lights.push_back(MakePointLight(lineFlashes[i].Position, 4.0f, XMFLOAT3(3.0f * fade, 3.0f * fade, 2.5f * fade)));
+		i++;
+	}
+
+	snapshots.Publish();
 }
 
 // --------------------------------------------------------
 // Clear the screen, redraw everything, present to the user
+//
+// Runs on the main thread and only reads the latest render
+// snapshot, never the live sim state.
 // --------------------------------------------------------
 void Game::Draw(float deltaTime, float totalTime)
 {
-	// Background color (Cornflower Blue in this case) for clearing
-	const float color[4] = { 0.4f, 0.6f, 0.75f, 0.0f };
-
-	// Clear the render target and depth buffer (erases what's on the screen)
-	//  - Do this ONCE PER FRAME
-	//  - At the beginning of Draw (before drawing *anything*)
-	context->ClearRenderTargetView(backBufferRTV, color);
-	context->ClearRenderTargetView(refractionRTV, color);
-	context->ClearDepthStencilView(
-		depthStencilView,
-		D3D11_CLEAR_DEPTH ,
-		1.0f,
-		0);
-
-	context->OMSetRenderTargets(1, &refractionRTV, depthStencilView);
+	PROFILE_FUNCTION();
+
+	// Grab the newest tick, or keep drawing the last one
+	snapshots.Acquire();
+	const RenderSnapshot& snapshot = snapshots.GetReadBuffer();
+
+	// Blend between the start and end of the tick based on how
+	// long ago it was published, so motion stays smooth when we
+	// draw faster than the sim ticks
+	float alpha = snapshot.GetAlpha(totalTime);
+	XMFLOAT4X4 view = snapshot.GetView(alpha);
+	XMFLOAT3 cameraPosition = snapshot.GetCameraPosition(alpha);
+
+	if (constantRing)
+		constantRing->BeginFrame();
+
+	// Bin the lights first, the shaders find their clusters
+	// through the per-frame constants
+	lightClusters->Update(snapshot.lights,
+		XMMatrixTranspose(XMLoadFloat4x4(&view)),
+		XMMatrixTranspose(XMLoadFloat4x4(&camera->projectionMatrix)));
+	lightClusters->SetFrameConstants(perFrameData, width, height);
+
+	UpdatePerFrameData(view, cameraPosition);
+	frameStats.Mark(FRAME_PHASE_SUBMIT);
+	BuildRenderQueue(snapshot, alpha, view, cameraPosition);
+	frameStats.Mark(FRAME_PHASE_CULLING);
 
-	for (int i = 0; i < entityArr.size(); i++) {
+#if defined(DEBUG) || defined(_DEBUG)
+	// Show what sorting the queue saves us every few seconds
+	statsFrameCount++;
+	if (totalTime >= nextRenderStatsTime)
+	{
+		const RenderQueueStats& stats = renderQueue.GetStats();
+		printf("Render queue: %u entries, %u batches - shader/material/mesh changes %u/%u/%u sorted, %u/%u/%u unsorted\n",
+			stats.Entries,
+			opaqueInstances->GetBatchCount() + refractInstances->GetBatchCount(),
+			stats.ShaderChanges, stats.MaterialChanges, stats.MeshChanges,
+			stats.UnsortedShaderChanges, stats.UnsortedMaterialChanges, stats.UnsortedMeshChanges);
+		printf("Frustum culling: %u culled, %u drawn\n", culledCount, stats.Entries);
+
+		// Bind counts are since the last print
+		const StateCacheStats& binds = stateCache->GetStats();
+		unsigned int totalBinds = binds.Issued + binds.Skipped;
+		printf("State cache: %u binds issued, %u skipped (%.1f%%)\n",
+			binds.Issued, binds.Skipped,
+			totalBinds ? 100.0f * binds.Skipped / totalBinds : 0.0f);
+		stateCache->ResetStats();
+
+		// Constant buffer bytes per frame, with and without
+		// skipping the parts that didn't change
+		const SimpleShaderUploadStats& uploads = ISimpleShader::GetUploadStats();
+		printf("Constant buffers: %llu bytes/frame uploaded of %llu requested (%u uploads, %u skipped)\n",
+			uploads.UploadedBytes / statsFrameCount, uploads.RequestedBytes / statsFrameCount,
+			uploads.Uploads, uploads.Skipped);
+		ISimpleShader::ResetUploadStats();
+
+		// Sim ticks (cached) and interpolation (moving things only) combined
+		printf("World matrices: %u built/frame\n", Entity::GetWorldMatrixBuildCount() / statsFrameCount);
+		Entity::ResetWorldMatrixBuildCount();
+
+		if (constantRing)
+		{
+			const ConstantRingStats& ring = constantRing->GetStats();
+			printf("Constant ring: %u allocations/frame, %llu bytes/frame, %u discards\n",
+				ring.Allocations / statsFrameCount, ring.Bytes / statsFrameCount, ring.Discards);
+			constantRing->ResetStats();
+		}
+
+		const RenderDeviceStats& deviceStats = renderDevice->GetStats();
+		printf("Render device: %u command buffers/frame, %u commands/frame (%u binds, %u draws), %llu bytes/frame uploaded\n",
+			deviceStats.CommandBuffers / statsFrameCount, deviceStats.Commands / statsFrameCount,
+			deviceStats.Binds / statsFrameCount, deviceStats.Draws / statsFrameCount, deviceStats.UploadedBytes / statsFrameCount);
+		renderDevice->ResetStats();
+
+		printf("Opaque recording: %u commands/frame in %.3f ms/frame\n",
+			recordedCommands / statsFrameCount, recordTicks * perfCounterSeconds * 1000.0 / statsFrameCount);
+		recordTicks = 0;
+		recordedCommands = 0;
+
+		printf("Refraction copy: %.1f%% of the screen/frame, %u of %u tiles needed were already there\n",
+			100.0 * refractionCopiedPixels / statsFrameCount / ((double)width * height),
+			refractionNeededTiles - refractionCopiedTiles, refractionNeededTiles);
+		const FrameGraphStats& graph = frameGraph->GetStats();
+		printf("Frame graph: %u of %u passes culled, %u transient and %u persistent textures from a pool of %u (%llu bytes)\n",
+			graph.CulledPasses, graph.Passes, graph.TransientTextures, graph.PersistentTextures, graph.PooledTextures, graph.PooledBytes);
+		const LightClusterStats& clusters = lightClusters->GetStats();
+		printf("Light clusters: %u of %u lights visible, %u indices in %u of %u clusters (at most %u in one)\n",
+			clusters.VisibleLights, clusters.Lights, clusters.Indices,
+			clusters.OccupiedClusters, LightClusters::ClusterCount, clusters.MaxPerCluster);
+
+		refractionCopiedPixels = 0;
+		refractionNeededTiles = 0;
+		refractionCopiedTiles = 0;
+		statsFrameCount = 0;
+
+		nextRenderStatsTime = totalTime + 5.0f;
+	}
+#endif
+
+	// The scene copy behind the refraction has to keep track
+	// of changes even on frames that don't use it
+	XMMATRIX viewProj = XMMatrixMultiply(
+		XMMatrixTranspose(XMLoadFloat4x4(&view)),
+		XMMatrixTranspose(XMLoadFloat4x4(&camera->projectionMatrix)));
+	InvalidateRefractionBackground(snapshot, viewProj);
+
+	unsigned int refractBegin, refractEnd;
+	renderQueue.GetPassRange(RENDER_PASS_REFRACT, refractBegin, refractEnd);
+
+	// === Frame graph ==========================
+	frameGraph->Reset();
+	FrameGraphResource backBuffer = frameGraph->ImportTexture("BackBuffer", backBufferRTV, 0, 0, true);
+	FrameGraphResource depth = frameGraph->ImportTexture("Depth", 0, 0, depthStencilView, false);
+
+	// Only ever copied into, and kept between frames so
+	// unchanged parts don't need copying again
+	FrameGraphTextureDesc sceneColorDesc;
+	sceneColorDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	sceneColorDesc.Persistent = true;
+	FrameGraphResource sceneColor = frameGraph->CreateTexture("SceneColor", sceneColorDesc);
+
+	FrameGraphPass opaquePass = frameGraph->AddPass("Opaque", [&]()
+	{
+		// Background color (Cornflower Blue in this case) for clearing
+		const float color[4] = { 0.4f, 0.6f, 0.75f, 0.0f };
+
+		// Clear the render target and depth buffer (erases what's on the screen)
+		//  - Do this ONCE PER FRAME
+		//  - At the beginning of Draw (before drawing *anything*)
+		ID3D11RenderTargetView* rtv = frameGraph->GetRTV(backBuffer);
+		ID3D11DepthStencilView* dsv = frameGraph->GetDSV(depth);
+		context->ClearRenderTargetView(rtv, color);
+		context->ClearDepthStencilView(dsv, D3D11_CLEAR_DEPTH, 1.0f, 0);
+
+		stateCache->SetRenderTargets(1, &rtv, dsv);
+		lightClusters->Bind(stateCache);
+		DrawOpaque(snapshot);
+	});
+	frameGraph->Write(opaquePass, backBuffer);
+	frameGraph->Write(opaquePass, depth);
+
+	// Culled along with the refraction pass when there's
+	// nothing refractive on screen
+	FrameGraphPass copyPass = frameGraph->AddPass("RefractionCopy", [&]()
+	{
+		CopyRefractionBackground(frameGraph->GetTexture(sceneColor), viewProj);
+	});
+	frameGraph->Read(copyPass, backBuffer);
+	frameGraph->Write(copyPass, sceneColor);
+
+	if (refractBegin != refractEnd) {
+		FrameGraphPass refractPass = frameGraph->AddPass("Refraction", [&]()
+		{
+			DrawRefraction(frameGraph->GetSRV(sceneColor));
+
+			// Unbind the scene texture so it can be copied into again
+			for (unsigned int i = 0; i < 16; i++)
+				stateCache->SetShaderResource(SHADER_STAGE_PIXEL, i, 0);
+		});
+		frameGraph->Read(refractPass, sceneColor);
+		frameGraph->Read(refractPass, depth);
+		frameGraph->Write(refractPass, backBuffer);
+	}
+
+	// Draw the sky AFTER everything else to prevent overdraw
+	FrameGraphPass skyPass = frameGraph->AddPass("Sky", [&]() { DrawSky(); });
+	frameGraph->Read(skyPass, depth);
+	frameGraph->Write(skyPass, backBuffer);
+
+#if FRAME_STATS_OVERLAY
+	// Shows the frames before this one - this one isn't done
+	FrameGraphPass overlayPass = frameGraph->AddPass("Overlay", [&]()
+	{
+		float targetMs = framePacer.GetTargetFps() > 0.0f ? 1000.0f / framePacer.GetTargetFps() : 0.0f;
+		frameOverlay->Draw(frameStats, inputLatency, width, height, targetMs);
+	});
+	frameGraph->Write(overlayPass, backBuffer);
+#endif
+
+	frameGraph->Compile();
+
+	// A new scene texture has nothing useful in it yet
+	if (frameGraph->WasRecreated(sceneColor))
+		refractionValid.Clear();
 
-		if (entityArr[i]->material == rBlockMaterial)
+	frameGraph->Execute();
+
+	inputLatency.MarkDrawn(snapshot.tick);
+
+	// Present the back buffer to the user
+	//  - Puts the final frame we're drawing into the window so the user can see it
+	//  - Do this exactly ONCE PER FRAME (always at the very end of the frame)
+	frameStats.Mark(FRAME_PHASE_SUBMIT);
+	swapChain->Present(framePacer.GetSyncInterval(), 0);
+	frameStats.Mark(FRAME_PHASE_PRESENT);
+
+	inputLatency.MarkPresented(snapshot.tick);
+
+	// Due to the usage of a more sophisticated swap chain effect,
+	// the render target must be re-bound after every call to Present()
+	stateCache->SetRenderTargets(1, &backBufferRTV, depthStencilView);
+}
+
+// --------------------------------------------------------
+// Points the shader's perFrame cbuffer at the shared buffer
+// --------------------------------------------------------
+void Game::ShareFrameConstants(ISimpleShader* shader)
+{
+	shader->SetExternalConstantBuffer("perFrame", perFrameBuffer);
+}
+
+// --------------------------------------------------------
+// Uploads everything that stays the same for the whole
+// frame, once, instead of once per draw
+// --------------------------------------------------------
+void Game::UpdatePerFrameData(XMFLOAT4X4 view, XMFLOAT3 cameraPosition)
+{
+	perFrameData.View = view;
+	perFrameData.Projection = camera->projectionMatrix;
+	perFrameData.CameraPosition = cameraPosition;
+
+	context->UpdateSubresource(perFrameBuffer, 0, 0, &perFrameData, 0, 0);
+}
+
+// --------------------------------------------------------
+// Fills the render queue with every visible item in the
+// snapshot, at its interpolated transform, and sorts it
+// --------------------------------------------------------
+void Game::BuildRenderQueue(const RenderSnapshot& snapshot, float alpha, XMFLOAT4X4 view, XMFLOAT3 cameraPosition)
+{
+	PROFILE_FUNCTION();
+
+	renderQueue.Clear();
+
+	// Bounding spheres of everything that could be drawn.  The
+	// frustum comes from the blended view we're drawing with,
+	// not the sim's live camera.
+	cullItems.clear();
+	cullWorlds.clear();
+	cullX.clear();
+	cullY.clear();
+	cullZ.clear();
+	cullRadius.clear();
+
+	for (unsigned int i = 0; i < snapshot.items.size(); i++) {
+		const RenderItem& item = snapshot.items[i];
+		if (!item.visible)
 			continue;
 
-		entityArr[i]->material->GetPixelShader()->SetFloat3("CameraPosition", camera->GetPosition());
-		entityArr[i]->Draw(camera->currentView, camera->projectionMatrix);
+		XMFLOAT4X4 world = item.GetInterpolatedWorld(alpha);
+		Mesh* mesh = item.entity->mesh;
+
+		// Matrices are transposed, so rows transform points and
+		// the columns' lengths are the scale on each axis
+		XMMATRIX w = XMLoadFloat4x4(&world);
+		XMFLOAT3 localCenter = mesh->GetBoundingSphereCenter();
+		XMVECTOR c = XMVectorSetW(XMLoadFloat3(&localCenter), 1.0f);
+		float scaleSq = max(max(
+			world._11 * world._11 + world._21 * world._21 + world._31 * world._31,
+			world._12 * world._12 + world._22 * world._22 + world._32 * world._32),
+			world._13 * world._13 + world._23 * world._23 + world._33 * world._33);
+
+		cullItems.push_back(i);
+		cullWorlds.push_back(world);
+		cullX.push_back(XMVectorGetX(XMVector4Dot(w.r[0], c)));
+		cullY.push_back(XMVectorGetX(XMVector4Dot(w.r[1], c)));
+		cullZ.push_back(XMVectorGetX(XMVector4Dot(w.r[2], c)));
+		cullRadius.push_back(mesh->GetBoundingSphereRadius() * sqrtf(scaleSq));
 	}
 
-	context->OMSetRenderTargets(1, &backBufferRTV, 0);
+	// Pad to a whole number of SIMD groups
+	unsigned int candidates = (unsigned int)cullItems.size();
+	unsigned int padded = (candidates + 3) & ~3u;
+	cullX.resize(padded, 0.0f);
+	cullY.resize(padded, 0.0f);
+	cullZ.resize(padded, 0.0f);
+	cullRadius.resize(padded, 0.0f);
+	cullVisible.resize(padded);
+
+	Frustum frustum = Frustum::FromViewProjection(view, camera->projectionMatrix);
+	unsigned int visibleCount = 0;
+	if (candidates > 0)
+		visibleCount = frustum.CullSpheres(&cullX[0], &cullY[0], &cullZ[0], &cullRadius[0], candidates, &cullVisible[0]);
+	culledCount = candidates - visibleCount;
+
+	XMVECTOR camPos = XMLoadFloat3(&cameraPosition);
+	for (unsigned int c = 0; c < candidates; c++) {
+		if (!cullVisible[c])
+			continue;
 
-	DrawFullscreenQuad(refractionSRV);
-	
-	context->OMSetRenderTargets(1, &backBufferRTV, depthStencilView);
+		unsigned int i = cullItems[c];
+		const RenderItem& item = snapshot.items[i];
+		const XMFLOAT4X4& world = cullWorlds[c];
 
-	DrawRefraction();
+		// World matrices are transposed, so the translation is the last column
+		XMVECTOR pos = XMVectorSet(world._14, world._24, world._34, 0);
+		float depth = XMVectorGetX(XMVector3LengthSq(pos - camPos));
 
-	ID3D11ShaderResourceView* nullSRV[16] = {};
-	context->PSSetShaderResources(0, 16, nullSRV);
+		RenderPass pass = item.entity->material == rBlockMaterial ? RENDER_PASS_REFRACT : RENDER_PASS_OPAQUE;
+		renderQueue.Add(pass, item.entity->material, item.entity->mesh, world, depth, i);
+	}
 
-	// === Sky box drawing ======================
-	// Draw the sky AFTER everything else to prevent overdraw
-	UINT stride = sizeof(Vertex);
-	UINT offset = 0;
+	renderQueue.Sort();
+}
 
-	// Set up sky states
-	context->RSSetState(skyRastState);
-	context->OMSetDepthStencilState(skyDepthState, 0);
+// --------------------------------------------------------
+// Draws the opaque pass of the render queue.  Entities
+// whose material has an instanced shader are batched by
+// mesh and material, one draw per batch.  The batches and
+// any other draws are recorded into command buffers, then
+// played back in order.
+// --------------------------------------------------------
+void Game::DrawOpaque(const RenderSnapshot& snapshot)
+{
+	PROFILE_FUNCTION();
+
+	unsigned int begin, end;
+	renderQueue.GetPassRange(RENDER_PASS_OPAQUE, begin, end);
 
-	// Grab the data from the box mesh
-	ID3D11Buffer* skyVB = meshArr[0]->GetVertexBuffer();
-	ID3D11Buffer* skyIB = meshArr[0]->GetIndexBuffer();
+	// Queue order is already grouped by state and front-to-back
+	opaqueInstances->Begin();
+	recordEntries.clear();
+	for (unsigned int i = begin; i < end; i++) {
+		const RenderQueueEntry& entry = renderQueue.Get(i);
+
+		if (entry.material->GetInstancedVertexShader())
+		{
+			opaqueInstances->Add(entry.mesh, entry.material, entry.World);
+			continue;
+		}
 
-	// Set buffers in the input assembler
-	context->IASetVertexBuffers(0, 1, &skyVB, &stride, &offset);
-	context->IASetIndexBuffer(skyIB, DXGI_FORMAT_R32_UINT, 0);
+		// Resolved here, so recording only ever reads them
+		entry.material->GetShaderHandles();
+		recordEntries.push_back(i);
+	}
+	opaqueInstances->End();
+
+	__int64 recordStart;
+	QueryPerformanceCounter((LARGE_INTEGER*)&recordStart);
+
+	// Batches first, then everything else
+	unsigned int batchCount = opaqueInstances->GetBatchCount();
+	unsigned int recordCount = batchCount + (unsigned int)recordEntries.size();
+	const unsigned int recordGrain = 16;
+	unsigned int chunks = (recordCount + recordGrain - 1) / recordGrain;
+	while (commandBuffers.size() < chunks)
+		commandBuffers.push_back(new CommandBuffer());
+
+	auto recordChunk = [&](unsigned int first, unsigned int last)
+	{
+		CommandBuffer* commands = commandBuffers[first / recordGrain];
+		commands->Reset();
+		for (unsigned int i = first; i < last; i++)
+		{
+			if (i < batchCount)
+			{
+				opaqueInstances->GetBatch(i).material->RecordTextures(*commands);
+				opaqueInstances->RecordBatch(i, *commands);
+			}
+			else
+			{
+				const RenderQueueEntry& entry = renderQueue.Get(recordEntries[i - batchCount]);
+				snapshot.items[entry.Item].entity->Record(*commands, entry.World);
+			}
+		}
+	};
 
-	// Set up the new sky shaders
-	skyVS->SetMatrix4x4("view", camera->currentView);
-	skyVS->SetMatrix4x4("projection", camera->projectionMatrix);
+#if PARALLEL_COMMAND_RECORDING
+	jobs->ParallelFor(recordCount, recordGrain, recordChunk);
+#else
+	for (unsigned int first = 0; first < recordCount; first += recordGrain)
+		recordChunk(first, min(first + recordGrain, recordCount));
+#endif
 
-	skyVS->CopyAllBufferData();
-	skyVS->SetShader();
+	__int64 recordEnd;
+	QueryPerformanceCounter((LARGE_INTEGER*)&recordEnd);
+	recordTicks += recordEnd - recordStart;
 
+	for (unsigned int i = 0; i < chunks; i++)
+	{
+		recordedCommands += commandBuffers[i]->GetCommandCount();
+		renderDevice->Execute(*commandBuffers[i]);
+	}
+}
 
-	skyPS->SetShader();
-	skyPS->SetShaderResourceView("skyTexture", skySRV);
-	skyPS->SetSamplerState("samplerOptions", samplerOptions);
+// --------------------------------------------------------
+// Screen rectangle covered by a mesh's bounding box, or the
+// whole screen if the box crosses the camera plane
+// --------------------------------------------------------
+ScreenRect Game::ProjectBounds(const XMFLOAT4X4& world, Mesh* mesh, FXMMATRIX viewProj)
+{
+	XMMATRIX worldViewProj = XMMatrixMultiply(XMMatrixTranspose(XMLoadFloat4x4(&world)), viewProj);
+	return ProjectBox(mesh->GetBoundsMin(), mesh->GetBoundsMax(), worldViewProj);
+}
+
+// --------------------------------------------------------
+// Screen rectangle covered by a box, or the whole screen
+// if it crosses the camera plane
+// --------------------------------------------------------
+ScreenRect Game::ProjectBox(XMFLOAT3 bmin, XMFLOAT3 bmax, FXMMATRIX worldViewProj)
+{
+	float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX;
+	for (int c = 0; c < 8; c++) {
+		XMVECTOR corner = XMVectorSet(
+			c & 1 ? bmax.x : bmin.x,
+			c & 2 ? bmax.y : bmin.y,
+			c & 4 ? bmax.z : bmin.z, 1.0f);
+		XMFLOAT4 clip;
+		XMStoreFloat4(&clip, XMVector4Transform(corner, worldViewProj));
+
+		if (clip.w <= 0.0001f) {
+			ScreenRect screen = { 0, 0, (int)width, (int)height };
+			return screen;
+		}
+
+		float x = clip.x / clip.w;
+		float y = clip.y / clip.w;
+		minX = min(minX, x);
+		maxX = max(maxX, x);
+		minY = min(minY, y);
+		maxY = max(maxY, y);
+	}
+
+	// NDC to pixels, with y flipped
+	ScreenRect rect;
+	rect.Left = (int)floorf((minX * 0.5f + 0.5f) * width);
+	rect.Right = (int)ceilf((maxX * 0.5f + 0.5f) * width);
+	rect.Top = (int)floorf((0.5f - maxY * 0.5f) * height);
+	rect.Bottom = (int)ceilf((0.5f - minY * 0.5f) * height);
+	return rect;
+}
+
+// --------------------------------------------------------
+// Works out which tiles of the refraction texture no longer
+// match the opaque scene.  A change to the per-frame data
+// (camera, projection, lights) touches every pixel.
+// Otherwise only the opaque things that moved, appeared,
+// disappeared or changed material matter - the tiles under
+// both where they were and where they are now - plus
+// whatever a point or spot light that changed can reach.
+// --------------------------------------------------------
+void Game::InvalidateRefractionBackground(const RenderSnapshot& snapshot, FXMMATRIX viewProj)
+{
+	PROFILE_FUNCTION();
+
+	unsigned int begin, end;
+	renderQueue.GetPassRange(RENDER_PASS_OPAQUE, begin, end);
+
+	currOpaque.clear();
+	for (unsigned int i = begin; i < end; i++) {
+		const RenderQueueEntry& entry = renderQueue.Get(i);
+
+		OpaqueRecord record;
+		record.entity = snapshot.items[entry.Item].entity;
+		record.material = entry.material;
+		record.mesh = entry.mesh;
+		record.World = entry.World;
+		record.Rect = ProjectBounds(entry.World, entry.mesh, viewProj);
+		currOpaque.push_back(record);
+	}
+
+	// Sorted by entity so last frame's list can be walked alongside
+	std::sort(currOpaque.begin(), currOpaque.end(),
+		[](const OpaqueRecord& a, const OpaqueRecord& b) { return a.entity < b.entity; });
+
+	// Lights are matched up by index, so one coming or going
+	// (a block spawning or a line clearing) can't be narrowed down
+	if (!prevOpaqueKnown || memcmp(&perFrameData, &prevFrameData, sizeof(PerFrameData)) != 0 ||
+		prevLights.size() != snapshot.lights.size()) {
+		refractionValid.Clear();
+	}
+	else {
+		refractionDirty.Clear();
+
+		size_t p = 0, c = 0;
+		while (p < prevOpaque.size() || c < currOpaque.size()) {
+			if (c == currOpaque.size() || (p < prevOpaque.size() && prevOpaque[p].entity < currOpaque[c].entity)) {
+				refractionDirty.AddRect(prevOpaque[p++].Rect);
+			}
+			else if (p == prevOpaque.size() || currOpaque[c].entity < prevOpaque[p].entity) {
+				refractionDirty.AddRect(currOpaque[c++].Rect);
+			}
+			else {
+				const OpaqueRecord& prev = prevOpaque[p++];
+				const OpaqueRecord& curr = currOpaque[c++];
+				if (prev.material != curr.material || prev.mesh != curr.mesh ||
+					memcmp(&prev.World, &curr.World, sizeof(XMFLOAT4X4)) != 0) {
+					refractionDirty.AddRect(prev.Rect);
+					refractionDirty.AddRect(curr.Rect);
+				}
+			}
+		}
+
+		for (size_t i = 0; i < snapshot.lights.size(); i++) {
+			const LocalLight* lights[2] = { &prevLights[i], &snapshot.lights[i] };
+			if (memcmp(lights[0], lights[1], sizeof(LocalLight)) == 0)
+				continue;
+
+			for (int l = 0; l < 2; l++) {
+				XMFLOAT3 p = lights[l]->Position;
+				float r = lights[l]->Range;
+				refractionDirty.AddRect(ProjectBox(XMFLOAT3(p.x - r, p.y - r, p.z - r), XMFLOAT3(p.x + r, p.y + r, p.z + r), viewProj));
+			}
+		}
+
+		refractionValid.Subtract(refractionDirty);
+	}
+
+	prevOpaque.swap(currOpaque);
+	prevLights = snapshot.lights;
+	prevFrameData = perFrameData;
+	prevOpaqueKnown = true;
+}
+
+// --------------------------------------------------------
+// Copies the opaque scene from the back buffer into the
+// refraction texture, but only where refractive blocks
+// will sample it.  Each block's bounding box is projected
+// to the screen, grown by the most the refraction can bend
+// a lookup (refrAdjust in RefractPS.hlsl, in UV units) and
+// snapped to tiles.  Tiles still valid from earlier frames
+// are skipped, so only the ones that changed get copied.
+// --------------------------------------------------------
+void Game::CopyRefractionBackground(ID3D11Texture2D* sceneColor, FXMMATRIX viewProj)
+{
+	PROFILE_FUNCTION();
+
+	const float refractionReach = 0.1f;
+
+	unsigned int begin, end;
+	renderQueue.GetPassRange(RENDER_PASS_REFRACT, begin, end);
+	if (begin == end)
+		return;
+
+	int padX = (int)ceilf(refractionReach * width);
+	int padY = (int)ceilf(refractionReach * height);
+
+	refractionTiles.Clear();
+	for (unsigned int i = begin; i < end; i++) {
+		const RenderQueueEntry& entry = renderQueue.Get(i);
+		ScreenRect rect = ProjectBounds(entry.World, entry.mesh, viewProj);
+		rect.Left -= padX;
+		rect.Right += padX;
+		rect.Top -= padY;
+		rect.Bottom += padY;
+		refractionTiles.AddRect(rect);
+	}
+
+	refractionNeededTiles += refractionTiles.GetMarkedCount();
+	refractionTiles.Subtract(refractionValid);
+	refractionCopiedTiles += refractionTiles.GetMarkedCount();
+	refractionTiles.GetRects(refractionRects);
+
+	ID3D11Resource* backBuffer = 0;
+	backBufferRTV->GetResource(&backBuffer);
+	for (size_t i = 0; i < refractionRects.size(); i++) {
+		// Tiles, texture and back buffer are all the same size
+		const ScreenRect& rect = refractionRects[i];
+		D3D11_BOX box = { (UINT)rect.Left, (UINT)rect.Top, 0, (UINT)rect.Right, (UINT)rect.Bottom, 1 };
+		context->CopySubresourceRegion(sceneColor, 0, box.left, box.top, 0, backBuffer, 0, &box);
+		refractionCopiedPixels += (box.right - box.left) * (box.bottom - box.top);
+	}
+	backBuffer->Release();
+
+	refractionValid.Add(refractionTiles);
+}
+
+// --------------------------------------------------------
+// Draws the sky box wherever nothing else has been drawn
+// --------------------------------------------------------
+void Game::DrawSky()
+{
+	PROFILE_FUNCTION();
+
+	Mesh* box = meshArr[0];
+	SimpleSRVHandle skyTexture = skyPS->GetShaderResourceViewHandle("skyTexture");
+	SimpleSamplerHandle skySampler = skyPS->GetSamplerHandle("samplerOptions");
+
+	passCommands.Reset();
+
+	// Set up sky states
+	passCommands.SetRenderState(0, skyDepthState, skyRastState);
+
+	// Set up the new sky shaders (view and projection are per frame)
+	passCommands.SetPipeline(skyVS->GetInputLayout(), skyVS->GetDirectXShader(), skyPS->GetDirectXShader());
+	RecordShaderConstants(passCommands, skyVS, COMMAND_STAGE_VERTEX);
+	RecordShaderConstants(passCommands, skyPS, COMMAND_STAGE_PIXEL);
+	if (skyTexture.IsValid())
+		passCommands.SetTexture(COMMAND_STAGE_PIXEL, skyTexture.BindIndex, skySRV);
+	if (skySampler.IsValid())
+		passCommands.SetSampler(COMMAND_STAGE_PIXEL, skySampler.BindIndex, samplerOptions);
 
 	// Finally do the actual drawing
-	context->DrawIndexed(meshArr[0]->GetIndexCount(), 0, 0);
+	passCommands.SetVertexBuffer(0, box->GetVertexBuffer(), sizeof(Vertex));
+	passCommands.SetIndexBuffer(box->GetIndexBuffer());
+	passCommands.DrawIndexed(box->GetIndexCount());
 
 	// Reset states for next frame
-	context->RSSetState(0);
-	context->OMSetDepthStencilState(0, 0);
-	// Present the back buffer to the user
-	//  - Puts the final frame we're drawing into the window so the user can see it
-	//  - Do this exactly ONCE PER FRAME (always at the very end of the frame)
-	swapChain->Present(0, 0);
+	passCommands.SetRenderState(0, 0, 0);
 
-	// Due to the usage of a more sophisticated swap chain effect,
-	// the render target must be re-bound after every call to Present()
-	context->OMSetRenderTargets(1, &backBufferRTV, depthStencilView);
+	renderDevice->Execute(passCommands);
 }
 
-void Game::DrawRefraction() 
+// --------------------------------------------------------
+// Draws the refractive blocks on top of the scene, which
+// they sample from sceneColor.  They never sample each
+// other, so they can all go out instanced.
+// --------------------------------------------------------
+void Game::DrawRefraction(ID3D11ShaderResourceView* sceneColor)
 {
-	const float color[4] = { 0.4f, 0.6f, 0.75f, 0.0f };
-	for (int i = 0; i < entityArr.size(); i++) {
-		if (entityArr[i]->material != rBlockMaterial)
-			continue;
+	PROFILE_FUNCTION();
 
-		UINT stride = sizeof(Vertex);
-		UINT offset = 0;
-		ID3D11Buffer* vb = entityArr[i]->mesh->GetVertexBuffer();
-		ID3D11Buffer* ib = entityArr[i]->mesh->GetIndexBuffer();
-		context->IASetVertexBuffers(0, 1, &vb, &stride, &offset);
-		context->IASetIndexBuffer(ib, DXGI_FORMAT_R32_UINT, 0);
+	unsigned int begin, end;
+	renderQueue.GetPassRange(RENDER_PASS_REFRACT, begin, end);
 
-		entityArr[i]->material->GetPixelShader()->SetFloat3("CameraPosition", camera->GetPosition());
-		entityArr[i]->DrawRefract(camera->currentView, camera->projectionMatrix,refractionSRV,samplerOptions,refractSampler,camera);
+	refractInstances->Begin();
+	for (unsigned int i = begin; i < end; i++) {
+		const RenderQueueEntry& entry = renderQueue.Get(i);
+		refractInstances->Add(entry.mesh, entry.material, entry.World);
 	}
+	refractInstances->End();
+
+	passCommands.Reset();
+	for (unsigned int i = 0; i < refractInstances->GetBatchCount(); i++)
+	{
+		Material* material = refractInstances->GetBatch(i).material;
+		const MaterialShaderHandles& handles = material->GetShaderHandles();
+
+		if (handles.ScenePixels.IsValid())
+			passCommands.SetTexture(COMMAND_STAGE_PIXEL, handles.ScenePixels.BindIndex, sceneColor);
+		if (handles.NormalMap.IsValid())
+			passCommands.SetTexture(COMMAND_STAGE_PIXEL, handles.NormalMap.BindIndex, material->GetNormalsShaderResourceView());
+		if (handles.BasicSampler.IsValid())
+			passCommands.SetSampler(COMMAND_STAGE_PIXEL, handles.BasicSampler.BindIndex, samplerOptions);
+		if (handles.RefractSampler.IsValid())
+			passCommands.SetSampler(COMMAND_STAGE_PIXEL, handles.RefractSampler.BindIndex, refractSampler);
+
+		refractInstances->RecordBatch(i, passCommands);
+	}
+	renderDevice->Execute(passCommands);
 }
 
 void Game::CheckForLines()
@@ -635,6 +1513,12 @@ void Game::CheckForLines()
 		{
 			for (int i = 0; i < lineArr.size(); i++)
 			{
+				LineFlash flash;
+				flash.Position = blockArr[lineArr[i]]->GetPosition();
+				flash.Position.z -= 1.0f;
+				flash.StartTime = simTime;
+				lineFlashes.push_back(flash);
+
 				for (int j = 0; j < entityArr.size();j++) 
 				{
 					if (blockArr[lineArr[i]] == entityArr[j]) {
@@ -699,8 +1583,10 @@ void Game::OnMouseUp(WPARAM buttonState, int x, int y)
 void Game::OnMouseMove(WPARAM buttonState, int x, int y)
 {
 	// Add any custom code here...
+	// The camera belongs to the sim thread, so just queue up the motion
 	if (buttonState & 0x0002) {
-		camera->SetRotation(camera->GetRotationX() + (y - prevMousePos.y) / 100.0f, camera->GetRotationY() + (x - prevMousePos.x) / 100.0f);
+		pendingMouseX += x - prevMousePos.x;
+		pendingMouseY += y - prevMousePos.y;
 	}
 
 	// Save the previous mouse position, so we have it for the future
@@ -7,10 +7,26 @@
 #include "Entity.h"
 #include "Camera.h"
 #include "Lights.h"
+#include "FrameConstants.h"
 #include <vector>
 #include "Player.h"
 #include "Tetromino.h"
 #include "Block.h"
+#include "RenderSnapshot.h"
+#include "TripleBuffer.h"
+#include "JobSystem.h"
+#include "InstanceRenderer.h"
+#include "RenderQueue.h"
+#include "StateCache.h"
+#include "ScreenTiles.h"
+
+class AssetLoader;
+class ConstantRingBuffer;
+class StaticBatch;
+class RenderDevice;
+class FrameGraph;
+class FrameOverlay;
+class LightClusters;
 
 class Game 
 	: public DXCore
@@ -25,7 +41,6 @@ public:
 	void Init();
 	void OnResize();
 	void Update(float deltaTime, float totalTime);
-	void DrawFullscreenQuad(ID3D11ShaderResourceView* texture);
 	void Draw(float deltaTime, float totalTime);
 
 	// Overridden mouse input helper methods
@@ -70,12 +85,25 @@ private:
 	Material* crabMaterial;
 	Material* rBlockMaterial;
 
+	// Owns the baked mesh for the walls and floor of the well
+	StaticBatch* wallBatch;
+
 	// Initialization helper methods - feel free to customize, combine, etc.
-	void LoadShaders(); 
+	void LoadShaders(AssetLoader* loader);
+	void LoadAssets(AssetLoader* loader);
 	void CreateMatrices();
 	void CreateBasicGeometry();
-	void DrawRefraction();
+	void ShareFrameConstants(ISimpleShader* shader);
+	void BuildRenderQueue(const RenderSnapshot& snapshot, float alpha, DirectX::XMFLOAT4X4 view, DirectX::XMFLOAT3 cameraPosition);
+	void DrawOpaque(const RenderSnapshot& snapshot);
+	ScreenRect ProjectBounds(const DirectX::XMFLOAT4X4& world, Mesh* mesh, DirectX::FXMMATRIX viewProj);
+	ScreenRect ProjectBox(DirectX::XMFLOAT3 bmin, DirectX::XMFLOAT3 bmax, DirectX::FXMMATRIX worldViewProj);
+	void InvalidateRefractionBackground(const RenderSnapshot& snapshot, DirectX::FXMMATRIX viewProj);
+	void CopyRefractionBackground(ID3D11Texture2D* sceneColor, DirectX::FXMMATRIX viewProj);
+	void DrawRefraction(ID3D11ShaderResourceView* sceneColor);
+	void DrawSky();
 	void CheckForLines();
+	void PublishSnapshot();
 
 	ID3D11ShaderResourceView* skySRV;
 	ID3D11RasterizerState* skyRastState;
@@ -88,15 +116,97 @@ private:
 	SimplePixelShader* pixelShader;
 	SimpleVertexShader* rVertexShader;
 	SimplePixelShader* rPixelShader;
-	SimpleVertexShader* quadVS;
-	SimplePixelShader* quadPS;
 
 	ID3D11SamplerState* refractSampler;
-	ID3D11RenderTargetView* refractionRTV;
-	ID3D11ShaderResourceView* refractionSRV;
+
+	// Passes and screen-sized targets for the frame
+	FrameGraph* frameGraph;
+
+	// Which parts of the opaque scene the refraction pass
+	// needs copied (only behind the refractive blocks)
+	ScreenTileMask refractionTiles;
+	std::vector<ScreenRect> refractionRects;
+	unsigned long long refractionCopiedPixels;
+	unsigned int refractionNeededTiles;
+	unsigned int refractionCopiedTiles;
+
+	// Tiles of the scene copy that still match the opaque
+	// scene, kept across frames, and what that scene was
+	ScreenTileMask refractionValid;
+	ScreenTileMask refractionDirty;
+	struct OpaqueRecord
+	{
+		Entity* entity;
+		Material* material;
+		Mesh* mesh;
+		DirectX::XMFLOAT4X4 World;
+		ScreenRect Rect;
+	};
+	std::vector<OpaqueRecord> prevOpaque;
+	std::vector<OpaqueRecord> currOpaque;
+	PerFrameData prevFrameData;
+	std::vector<LocalLight> prevLights;
+	bool prevOpaqueKnown;
 	SimpleVertexShader* skyVS;
 	SimplePixelShader* skyPS;
 
+	// Frame time graph and percentiles in the corner
+	SimpleVertexShader* overlayVS;
+	SimplePixelShader* overlayPS;
+	FrameOverlay* frameOverlay;
+
+	// Point and spot lights sorted into clusters for the
+	// lighting pixel shader
+	LightClusters* lightClusters;
+
+	// Lines cleared recently, lit up for a moment.  Sim
+	// thread only.
+	struct LineFlash
+	{
+		DirectX::XMFLOAT3 Position;
+		float StartTime;
+	};
+	std::vector<LineFlash> lineFlashes;
+	float simTime;
+
+	// Instanced versions of the lighting and refraction vertex
+	// shaders, plus the per-pass batches that use them
+	SimpleVertexShader* instancedVS;
+	SimpleVertexShader* instancedRefractVS;
+	InstanceRenderer* opaqueInstances;
+	InstanceRenderer* refractInstances;
+
+	// Everything visible this frame, sorted by pass and state
+	RenderQueue renderQueue;
+	float nextRenderStatsTime;
+	unsigned int statsFrameCount;
+
+	// World space bounding spheres of this frame's candidates,
+	// one array per component for the SIMD frustum test
+	std::vector<unsigned int> cullItems;
+	std::vector<DirectX::XMFLOAT4X4> cullWorlds;
+	std::vector<float> cullX;
+	std::vector<float> cullY;
+	std::vector<float> cullZ;
+	std::vector<float> cullRadius;
+	std::vector<unsigned char> cullVisible;
+	unsigned int culledCount;
+
+	// The opaque pass - instanced batches, then any other
+	// draws - recorded on the workers in chunks (one command
+	// buffer each) and played back in order
+	std::vector<unsigned int> recordEntries;
+	std::vector<CommandBuffer*> commandBuffers;
+	__int64 recordTicks;		// Since the last stats print
+	unsigned int recordedCommands;
+	RenderDevice* renderDevice;
+
+	// Refraction and sky, recorded on the render thread
+	CommandBuffer passCommands;
+
+	// Drops binds that match what the context already has
+	StateCache* stateCache;
+
 	// The matrices to go from model space to screen space
 	DirectX::XMFLOAT4X4 worldMatrix;
 	DirectX::XMFLOAT4X4 viewMatrix;
@@ -105,6 +215,32 @@ private:
 	DirectionalLight light;
 	DirectionalLight light2;
 
+	// Shared by every shader at b0, uploaded once per frame
+	PerFrameData perFrameData;
+	ID3D11Buffer* perFrameBuffer;
+
+	// Per-draw constants go here when supported (0 otherwise)
+	ConstantRingBuffer* constantRing;
+	void UpdatePerFrameData(DirectX::XMFLOAT4X4 view, DirectX::XMFLOAT3 cameraPosition);
+
+	// Sim -> render handoff.  Update() fills and publishes,
+	// Draw() always renders the latest published snapshot.
+	TripleBuffer<RenderSnapshot> snapshots;
+	unsigned long long simTick;
+
+	// Camera at the start of the current tick, for interpolation
+	DirectX::XMFLOAT3 prevCameraPosition;
+	DirectX::XMFLOAT2 prevCameraRotation;
+
+	// Mouse look is captured on the window thread but applied
+	// to the camera on the sim thread
+	std::atomic<int> pendingMouseX;
+	std::atomic<int> pendingMouseY;
+
+	// Worker pool shared by anything that wants to fan out work
+	JobSystem* jobs;
+	float nextJobStatsTime;
+
 	// Keeps track of the old mouse position.  Useful for 
 	// determining how far the mouse moved in a single frame.
 	POINT prevMousePos;
@@ -0,0 +1,183 @@
+#include "InstanceRenderer.h"
+#include "Mesh.h"
+#include "Material.h"
+#include "Vertex.h"
+#include <stdio.h>
+#include <string.h>
+
+using namespace DirectX;
+
+InstanceRenderer::InstanceRenderer(RenderDevice* renderDevice, unsigned int initialCapacity)
+{
+	this->renderDevice = renderDevice;
+
+	instanceBuffer = 0;
+	capacity = 0;
+	instanceCount = 0;
+	batchesUsed = 0;
+
+	for (unsigned int i = 0; i < MaxMaterials; i++)
+		materialUVScale[i] = XMFLOAT4(1, 1, 0, 0);
+
+	CreateInstanceBuffer(initialCapacity);
+}
+
+InstanceRenderer::~InstanceRenderer()
+{
+	if (instanceBuffer)
+		renderDevice->DestroyBuffer(instanceBuffer);
+}
+
+// --------------------------------------------------------
+// (Re)creates the dynamic instance buffer
+// --------------------------------------------------------
+void InstanceRenderer::CreateInstanceBuffer(unsigned int newCapacity)
+{
+	if (instanceBuffer)
+		renderDevice->DestroyBuffer(instanceBuffer);
+
+	RenderBufferDesc desc;
+	desc.Type = RENDER_BUFFER_VERTEX;
+	desc.Size = sizeof(InstanceData) * newCapacity;
+	desc.Dynamic = true;
+	instanceBuffer = renderDevice->CreateBuffer(desc, 0);
+
+	capacity = newCapacity;
+}
+
+// --------------------------------------------------------
+// Materials can share a draw if everything that isn't in
+// the per-material table is the same
+// --------------------------------------------------------
+bool InstanceRenderer::SameGroup(Material* a, Material* b)
+{
+	return a == b || (
+		a->GetInstancedVertexShader() == b->GetInstancedVertexShader() &&
+		a->GetPixelShader() == b->GetPixelShader() &&
+		a->GetAlbedoShaderResourceView() == b->GetAlbedoShaderResourceView() &&
+		a->GetNormalsShaderResourceView() == b->GetNormalsShaderResourceView() &&
+		a->GetRoughnessShaderResourceView() == b->GetRoughnessShaderResourceView() &&
+		a->GetMetalShaderResourceView() == b->GetMetalShaderResourceView() &&
+		a->GetSamplerState() == b->GetSamplerState());
+}
+
+// --------------------------------------------------------
+// Finds (or assigns) the material's slot in the table
+// --------------------------------------------------------
+unsigned int InstanceRenderer::GetMaterialIndex(Material* material)
+{
+	for (unsigned int i = 0; i < materials.size(); i++)
+	{
+		if (materials[i] == material)
+			return i;
+	}
+
+	if (materials.size() == MaxMaterials)
+	{
+		printf("InstanceRenderer: too many materials, sharing slot 0\n");
+		return 0;
+	}
+
+	XMFLOAT2 uvScale = material->GetUVScale();
+	materialUVScale[materials.size()] = XMFLOAT4(uvScale.x, uvScale.y, 0, 0);
+	materials.push_back(material);
+	return (unsigned int)materials.size() - 1;
+}
+
+void InstanceRenderer::Begin()
+{
+	for (unsigned int i = 0; i < batchesUsed; i++)
+		batches[i].instances.clear();
+
+	batchesUsed = 0;
+	instanceCount = 0;
+}
+
+// --------------------------------------------------------
+// Adds one instance to the batch for its mesh and group
+// --------------------------------------------------------
+void InstanceRenderer::Add(Mesh* mesh, Material* material, const XMFLOAT4X4& world)
+{
+	InstanceData data;
+	data.World = world;
+	data.MaterialIndex = GetMaterialIndex(material);
+
+	// Only a handful of batches, so a linear search is fine.  Start
+	// from the newest, since sorted input hits it straight away.
+	for (unsigned int i = batchesUsed; i-- > 0; )
+	{
+		if (batches[i].mesh == mesh && SameGroup(batches[i].material, material))
+		{
+			batches[i].instances.push_back(data);
+			instanceCount++;
+			return;
+		}
+	}
+
+	if (batchesUsed == batches.size())
+		batches.push_back(InstanceBatch());
+
+	// Resolved here, so recording only ever reads them
+	material->GetShaderHandles();
+
+	InstanceBatch& batch = batches[batchesUsed++];
+	batch.mesh = mesh;
+	batch.material = material;
+	batch.firstInstance = 0;
+	batch.instances.push_back(data);
+	instanceCount++;
+}
+
+// --------------------------------------------------------
+// Uploads every batch's instances, back to back, with a
+// single update of the instance buffer
+// --------------------------------------------------------
+void InstanceRenderer::End()
+{
+	if (instanceCount == 0)
+		return;
+
+	if (instanceCount > capacity)
+	{
+		unsigned int newCapacity = capacity * 2;
+		while (newCapacity < instanceCount)
+			newCapacity *= 2;
+		CreateInstanceBuffer(newCapacity);
+	}
+
+	packed.resize(instanceCount);
+	unsigned int offset = 0;
+	for (unsigned int i = 0; i < batchesUsed; i++)
+	{
+		InstanceBatch& batch = batches[i];
+		batch.firstInstance = offset;
+		memcpy(&packed[offset], &batch.instances[0], sizeof(InstanceData) * batch.instances.size());
+		offset += (unsigned int)batch.instances.size();
+	}
+
+	renderDevice->UpdateBuffer(instanceBuffer, &packed[0], sizeof(InstanceData) * instanceCount);
+}
+
+void InstanceRenderer::RecordBatch(unsigned int index, CommandBuffer& commands)
+{
+	const InstanceBatch& batch = batches[index];
+	Material* material = batch.material;
+	SimpleVertexShader* vs = material->GetInstancedVertexShader();
+	SimplePixelShader* ps = material->GetPixelShader();
+
+	commands.SetPipeline(vs->GetInputLayout(), vs->GetDirectXShader(), ps->GetDirectXShader());
+
+	ConstantPatch table = { material->GetShaderHandles().MaterialTable, materialUVScale, sizeof(materialUVScale) };
+	RecordShaderConstants(commands, vs, COMMAND_STAGE_VERTEX, &table, 1);
+	RecordShaderConstants(commands, ps, COMMAND_STAGE_PIXEL);
+
+	commands.SetVertexBuffer(0, batch.mesh->GetVertexBuffer(), sizeof(Vertex));
+	commands.SetVertexBuffer(1, instanceBuffer, sizeof(InstanceData));
+	commands.SetIndexBuffer(batch.mesh->GetIndexBuffer());
+	commands.DrawIndexedInstanced(
+		batch.mesh->GetIndexCount(),
+		(unsigned int)batch.instances.size(),
+		0,
+		0,
+		batch.firstInstance);
+}
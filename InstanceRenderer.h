@@ -0,0 +1,90 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+#include "RenderDevice.h"
+
+class Mesh;
+class Material;
+
+// --------------------------------------------------------
+// One instance worth of data in the second vertex buffer.
+// Must match the _PER_INSTANCE inputs of InstancedVS.hlsl.
+// --------------------------------------------------------
+struct InstanceData
+{
+	DirectX::XMFLOAT4X4 World;		// Transposed, same as for a cbuffer
+	unsigned int MaterialIndex;
+};
+
+// --------------------------------------------------------
+// A run of instances that can go out in a single
+// DrawIndexedInstanced call
+// --------------------------------------------------------
+struct InstanceBatch
+{
+	Mesh* mesh;
+	Material* material;		// First material added to the batch
+	unsigned int firstInstance;	// Into the instance buffer
+	std::vector<InstanceData> instances;
+};
+
+// --------------------------------------------------------
+// Collects entities that share a mesh and material group
+// each frame, packs them into one dynamic instance buffer
+// and records each group as a single instanced draw.
+//
+// Materials that share shaders, textures and sampler land
+// in the same group; whatever else differs between them
+// (uvScale for now) is looked up in the shader through
+// the per-instance material index.
+//
+// Usage per frame: Begin(), Add() ..., End(), then for
+// each batch record whatever textures its pixel shader
+// needs and call RecordBatch().
+// --------------------------------------------------------
+class InstanceRenderer
+{
+public:
+	// Must match MAX_INSTANCE_MATERIALS in InstancedVS.hlsl
+	static const unsigned int MaxMaterials = 16;
+
+	InstanceRenderer(RenderDevice* renderDevice, unsigned int initialCapacity = 256);
+	~InstanceRenderer();
+
+	void Begin();
+	void Add(Mesh* mesh, Material* material, const DirectX::XMFLOAT4X4& world);
+	void End();
+
+	unsigned int GetBatchCount() { return batchesUsed; }
+	const InstanceBatch& GetBatch(unsigned int index) { return batches[index]; }
+
+	// Records the batch's shaders and constants (with the
+	// per-material table), the mesh and instance buffers and
+	// a draw of every instance.  Only reads, so batches can
+	// be recorded on any thread once End() has been called.
+	void RecordBatch(unsigned int index, CommandBuffer& commands);
+
+	unsigned int GetInstanceCount() { return instanceCount; }
+
+private:
+	RenderDevice* renderDevice;
+
+	CommandHandle instanceBuffer;
+	unsigned int capacity;
+	unsigned int instanceCount;
+
+	// Every batch's instances back to back, as uploaded
+	std::vector<InstanceData> packed;
+
+	// Batches are reused from frame to frame to keep their storage
+	std::vector<InstanceBatch> batches;
+	unsigned int batchesUsed;
+
+	std::vector<Material*> materials;
+	DirectX::XMFLOAT4 materialUVScale[MaxMaterials];
+
+	unsigned int GetMaterialIndex(Material* material);
+	bool SameGroup(Material* a, Material* b);
+	void CreateInstanceBuffer(unsigned int newCapacity);
+};
@@ -0,0 +1,51 @@
+#include "FrameConstants.hlsli"
+
+// Per-vertex data matches the Vertex struct; the world
+// matrix rows come from the instance buffer
+struct VertexShaderInput 
+{
+	float3 position		: POSITION;
+	float3 normal		: NORMAL;
+	float2 uv			: TEXCOORD;
+	float3 tangent		: TANGENT;
+
+	float4 world0		: WORLD_PER_INSTANCE0;
+	float4 world1		: WORLD_PER_INSTANCE1;
+	float4 world2		: WORLD_PER_INSTANCE2;
+	float4 world3		: WORLD_PER_INSTANCE3;
+};
+
+struct VertexToPixel
+{
+	float4 position		: SV_POSITION;
+	float2 uv			: TEXCOORD;
+	float3 normal		: NORMAL;
+	float3 tangent		: TANGENT;
+	float3 worldPos		: POSITION;
+	noperspective float2 screenUV		: TEXCOORD1;
+};
+
+VertexToPixel main(VertexShaderInput input)
+{
+	VertexToPixel output;
+
+	matrix world = transpose(float4x4(input.world0, input.world1, input.world2, input.world3));
+
+	matrix worldViewProj = mul(mul(world, view), projection);
+	output.position = mul(float4(input.position, 1.0f), worldViewProj);
+
+	output.worldPos = mul(float4(input.position, 1.0f), world).xyz;
+
+	output.normal = mul(input.normal, (float3x3)world);
+	output.normal = normalize(output.normal);
+
+	output.tangent = normalize(mul(input.tangent, (float3x3)world));
+
+	output.uv = input.uv;
+
+	output.screenUV = (output.position.xy / output.position.w);
+	output.screenUV.x = output.screenUV.x * 0.5f + 0.5f;
+	output.screenUV.y = -output.screenUV.y * 0.5f + 0.5f;
+
+	return output;
+}
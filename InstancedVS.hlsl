@@ -0,0 +1,68 @@
+
+// Must match InstanceRenderer::MaxMaterials
+#define MAX_INSTANCE_MATERIALS 16
+
+#include "FrameConstants.hlsli"
+
+cbuffer instanceMaterials : register(b1)
+{
+	// Per-material values, picked by each instance's material index
+	// (xy = uvScale, zw unused)
+	float4 materialUVScale[MAX_INSTANCE_MATERIALS];
+};
+
+// Struct representing a single vertex worth of data.  The
+// _PER_INSTANCE semantics come from the second vertex buffer.
+struct VertexShaderInput
+{
+	float3 position		: POSITION;
+	float3 normal		: NORMAL;
+	float2 uv			: TEXCOORD;
+	float3 tangent		: TANGENT;
+
+	// Rows of the transposed (HLSL-ready) world matrix,
+	// exactly as it would be sent to a constant buffer
+	float4 world0		: WORLD_PER_INSTANCE0;
+	float4 world1		: WORLD_PER_INSTANCE1;
+	float4 world2		: WORLD_PER_INSTANCE2;
+	float4 world3		: WORLD_PER_INSTANCE3;
+	uint materialIndex	: MATERIAL_PER_INSTANCE;
+};
+
+// Out of the vertex shader (and eventually input to the PS)
+struct VertexToPixel
+{
+	float4 position		: SV_POSITION;
+	float2 uv			: TEXCOORD;
+	float3 normal		: NORMAL;
+	float3 tangent		: TANGENT;
+	float3 worldPos		: POSITION; // The world position of this vertex
+};
+
+// --------------------------------------------------------
+// Same as VertexShader.hlsl, but the world matrix and
+// material come from the instance instead of the cbuffer
+// --------------------------------------------------------
+VertexToPixel main(VertexShaderInput input)
+{
+	// Set up output
+	VertexToPixel output;
+
+	matrix world = transpose(float4x4(input.world0, input.world1, input.world2, input.world3));
+
+	// Calculate output position
+	matrix worldViewProj = mul(mul(world, view), projection);
+	output.position = mul(float4(input.position, 1.0f), worldViewProj);
+
+	// Calculate the world position of this vertex
+	output.worldPos = mul(float4(input.position, 1.0f), world).xyz;
+
+	// Make sure the normal is in WORLD space, not "local" space
+	output.normal = normalize(mul(input.normal, (float3x3)world));
+	output.tangent = normalize(mul(input.tangent, (float3x3)world));
+
+	// Pass through the uv
+	output.uv = input.uv * materialUVScale[input.materialIndex].xy;
+
+	return output;
+}
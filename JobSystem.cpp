@@ -0,0 +1,303 @@
+#include "JobSystem.h"
+#include "Profiler.h"
+#include <stdio.h>
+
+// Which worker (if any) the current thread is
+static thread_local int currentWorker = -1;
+
+// --------------------------------------------------------
+// Constructor - starts the worker threads
+// --------------------------------------------------------
+JobSystem::JobSystem(unsigned int workerCount)
+{
+	if (workerCount == 0)
+	{
+		unsigned int cores = std::thread::hardware_concurrency();
+		workerCount = cores > 3 ? cores - 2 : 1;
+	}
+
+	running = true;
+	nextWorker = 0;
+	queuedJobs = 0;
+
+	for (unsigned int i = 0; i < workerCount; i++)
+	{
+		Worker* w = new Worker();
+		w->JobsExecuted = 0;
+		w->JobsStolen = 0;
+		w->BusyNanoseconds = 0;
+		workers.push_back(w);
+	}
+
+	statsStart = std::chrono::steady_clock::now();
+
+	// Start threads only once every deque exists, since they steal
+	for (unsigned int i = 0; i < workerCount; i++)
+		workers[i]->Thread = std::thread(&JobSystem::WorkerLoop, this, i);
+}
+
+// --------------------------------------------------------
+// Destructor - lets queued work finish, then stops workers
+// --------------------------------------------------------
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(wakeLock);
+		running = false;
+	}
+	wake.notify_all();
+
+	for (unsigned int i = 0; i < workers.size(); i++)
+	{
+		workers[i]->Thread.join();
+		delete workers[i];
+	}
+}
+
+// --------------------------------------------------------
+// Queues a job on the calling worker's own deque, or on
+// the next worker in line when called from outside the pool
+// --------------------------------------------------------
+void JobSystem::Run(JobFunction job, JobCounter* counter)
+{
+	if (counter)
+		counter->Value++;
+
+	unsigned int index = currentWorker >= 0 ?
+		(unsigned int)currentWorker :
+		nextWorker++ % (unsigned int)workers.size();
+
+	Worker* w = workers[index];
+	{
+		std::lock_guard<std::mutex> lock(w->Lock);
+		Job j;
+		j.Function = job;
+		j.Counter = counter;
+		w->Jobs.push_back(j);
+
+		// Counted under the same lock as the push and pop, so
+		// the count never runs ahead of or behind the deques
+		queuedJobs++;
+	}
+
+	// Sleeping workers check the count under the wake lock, so
+	// taking it here means the notify can't slip in between
+	// a worker's check and its wait
+	{
+		std::lock_guard<std::mutex> lock(wakeLock);
+	}
+	wake.notify_one();
+}
+
+// --------------------------------------------------------
+// Pops from our own deque first, then tries to steal from
+// everyone else.  Returns false if there's nothing to do.
+// --------------------------------------------------------
+bool JobSystem::TryGetJob(int workerIndex, Job& job, bool& stolen)
+{
+	unsigned int count = (unsigned int)workers.size();
+
+	// Own deque - newest first
+	if (workerIndex >= 0)
+	{
+		Worker* w = workers[workerIndex];
+		std::lock_guard<std::mutex> lock(w->Lock);
+		if (!w->Jobs.empty())
+		{
+			job = w->Jobs.back();
+			w->Jobs.pop_back();
+			queuedJobs--;
+			stolen = false;
+			return true;
+		}
+	}
+
+	// Steal - oldest first, starting from our neighbour
+	unsigned int start = workerIndex >= 0 ? (unsigned int)workerIndex + 1 : 0;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		unsigned int victim = (start + i) % count;
+		if ((int)victim == workerIndex)
+			continue;
+
+		Worker* w = workers[victim];
+		std::lock_guard<std::mutex> lock(w->Lock);
+		if (!w->Jobs.empty())
+		{
+			job = w->Jobs.front();
+			w->Jobs.pop_front();
+			queuedJobs--;
+			stolen = true;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// --------------------------------------------------------
+// Takes the oldest queued job that belongs to the counter,
+// from any deque.  Threads outside the pool wait with this
+// instead, so they only ever run their own work.
+// --------------------------------------------------------
+bool JobSystem::TryGetJobFor(JobCounter* counter, Job& job)
+{
+	for (unsigned int i = 0; i < workers.size(); i++)
+	{
+		Worker* w = workers[i];
+		std::lock_guard<std::mutex> lock(w->Lock);
+		for (std::deque<Job>::iterator it = w->Jobs.begin(); it != w->Jobs.end(); ++it)
+		{
+			if (it->Counter == counter)
+			{
+				job = *it;
+				w->Jobs.erase(it);
+				queuedJobs--;
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+// --------------------------------------------------------
+// Runs a job, updates stats and signals its counter
+// --------------------------------------------------------
+void JobSystem::Execute(Job& job, int workerIndex, bool stolen)
+{
+	PROFILE_SCOPE("Job");
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	job.Function();
+	std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+	// Only pool threads count towards worker stats
+	if (workerIndex >= 0)
+	{
+		Worker* w = workers[workerIndex];
+		w->JobsExecuted++;
+		if (stolen)
+			w->JobsStolen++;
+		w->BusyNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+	}
+
+	if (job.Counter)
+		job.Counter->Value--;
+}
+
+// --------------------------------------------------------
+// Each worker runs jobs until there are none left, then
+// sleeps until more are queued or the pool shuts down
+// --------------------------------------------------------
+void JobSystem::WorkerLoop(unsigned int index)
+{
+	currentWorker = (int)index;
+
+#if PROFILER_ENABLED
+	char name[32];
+	snprintf(name, sizeof(name), "Worker %u", index);
+	PROFILE_THREAD_NAME(name);
+#endif
+
+	while (true)
+	{
+		Job job;
+		bool stolen;
+		if (TryGetJob(currentWorker, job, stolen))
+		{
+			Execute(job, currentWorker, stolen);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(wakeLock);
+		wake.wait(lock, [this] { return queuedJobs > 0 || !running; });
+
+		if (!running && queuedJobs <= 0)
+			return;
+	}
+}
+
+// --------------------------------------------------------
+// Helps run jobs until the counter reaches zero.  Safe to
+// call from inside a job, which is how dependent jobs wait.
+// Workers help with anything; other threads only with the
+// counter's own jobs, since the sim and render threads
+// share the pool and must never hold each other up.
+// --------------------------------------------------------
+void JobSystem::Wait(JobCounter* counter)
+{
+	while (counter->Value > 0)
+	{
+		Job job;
+		bool stolen = true;
+		bool found = currentWorker >= 0 ?
+			TryGetJob(currentWorker, job, stolen) :
+			TryGetJobFor(counter, job);
+
+		if (found)
+			Execute(job, currentWorker, stolen);
+		else
+			std::this_thread::yield();
+	}
+}
+
+// --------------------------------------------------------
+// Runs function over [0, count) in chunks of grainSize.
+// Small ranges are just run inline on the calling thread.
+// --------------------------------------------------------
+void JobSystem::ParallelFor(unsigned int count, unsigned int grainSize, RangeFunction function)
+{
+	if (grainSize == 0)
+		grainSize = 1;
+
+	if (count <= grainSize)
+	{
+		if (count > 0)
+			function(0, count);
+		return;
+	}
+
+	JobCounter counter;
+	for (unsigned int begin = grainSize; begin < count; begin += grainSize)
+	{
+		unsigned int end = begin + grainSize < count ? begin + grainSize : count;
+		Run([function, begin, end]() { function(begin, end); }, &counter);
+	}
+
+	// The calling thread takes the first chunk itself
+	function(0, grainSize);
+	Wait(&counter);
+}
+
+// --------------------------------------------------------
+// Gets profiling info for one worker
+// --------------------------------------------------------
+JobWorkerStats JobSystem::GetWorkerStats(unsigned int worker)
+{
+	JobWorkerStats stats = {};
+	if (worker >= workers.size())
+		return stats;
+
+	Worker* w = workers[worker];
+	double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - statsStart).count();
+
+	stats.JobsExecuted = w->JobsExecuted;
+	stats.JobsStolen = w->JobsStolen;
+	stats.BusySeconds = w->BusyNanoseconds / 1e9;
+	stats.Utilization = wallSeconds > 0 ? stats.BusySeconds / wallSeconds : 0;
+	return stats;
+}
+
+// --------------------------------------------------------
+// Starts a new profiling window
+// --------------------------------------------------------
+void JobSystem::ResetStats()
+{
+	for (unsigned int i = 0; i < workers.size(); i++)
+	{
+		workers[i]->JobsExecuted = 0;
+		workers[i]->JobsStolen = 0;
+		workers[i]->BusyNanoseconds = 0;
+	}
+	statsStart = std::chrono::steady_clock::now();
+}
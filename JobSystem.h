@@ -0,0 +1,109 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// --------------------------------------------------------
+// Counts outstanding jobs.  Hand one to Run() for each job
+// you want to track, then Wait() on it.  A counter can be
+// reused once it has reached zero.
+// --------------------------------------------------------
+struct JobCounter
+{
+	std::atomic<int> Value;
+	JobCounter() : Value(0) { }
+};
+
+// --------------------------------------------------------
+// Per-worker profiling info, since the last ResetStats()
+// --------------------------------------------------------
+struct JobWorkerStats
+{
+	unsigned int JobsExecuted;
+	unsigned int JobsStolen;
+	double BusySeconds;
+	double Utilization;		// Busy time / wall time (0-1)
+};
+
+// --------------------------------------------------------
+// Work-stealing thread pool.
+//
+// Each worker owns a deque: it pushes and pops its own
+// jobs at the back (LIFO, cache friendly) and steals from
+// the front of other workers' deques when it runs dry.
+// Threads outside the pool (main, sim, render) hand their
+// jobs to the workers round-robin.  While waiting they
+// only help with jobs for the counter they're waiting on,
+// so one of them can never end up running another's work
+// (a render chunk holding up a sim tick, say).
+//
+// Dependencies are expressed with counters - a job that
+// needs another job's results simply Wait()s on its counter,
+// which runs other jobs instead of blocking.
+// --------------------------------------------------------
+class JobSystem
+{
+public:
+	typedef std::function<void()> JobFunction;
+	typedef std::function<void(unsigned int begin, unsigned int end)> RangeFunction;
+
+	// workerCount of 0 picks one per core, leaving room
+	// for the main and sim threads
+	JobSystem(unsigned int workerCount = 0);
+	~JobSystem();
+
+	// Queues a job.  The counter (optional) is incremented
+	// now and decremented when the job finishes.
+	void Run(JobFunction job, JobCounter* counter = 0);
+
+	// Runs other jobs until the counter reaches zero.  From
+	// outside the pool, only the counter's own jobs.
+	void Wait(JobCounter* counter);
+
+	// Splits [0, count) into chunks of grainSize and runs the
+	// chunks across the pool.  Returns once every chunk is done.
+	void ParallelFor(unsigned int count, unsigned int grainSize, RangeFunction function);
+
+	unsigned int GetWorkerCount() { return (unsigned int)workers.size(); }
+	JobWorkerStats GetWorkerStats(unsigned int worker);
+	void ResetStats();
+
+private:
+	struct Job
+	{
+		JobFunction Function;
+		JobCounter* Counter;
+	};
+
+	struct Worker
+	{
+		std::mutex Lock;
+		std::deque<Job> Jobs;
+		std::thread Thread;
+
+		std::atomic<unsigned int> JobsExecuted;
+		std::atomic<unsigned int> JobsStolen;
+		std::atomic<long long> BusyNanoseconds;
+	};
+
+	std::vector<Worker*> workers;
+	std::atomic<bool> running;
+	std::atomic<unsigned int> nextWorker;
+	std::chrono::steady_clock::time_point statsStart;
+
+	// Idle workers sleep here until something is queued
+	std::mutex wakeLock;
+	std::condition_variable wake;
+	std::atomic<int> queuedJobs;
+
+	void WorkerLoop(unsigned int index);
+	bool TryGetJob(int workerIndex, Job& job, bool& stolen);
+	bool TryGetJobFor(JobCounter* counter, Job& job);
+	void Execute(Job& job, int workerIndex, bool stolen);
+};
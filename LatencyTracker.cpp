@@ -0,0 +1,218 @@
+#include "LatencyTracker.h"
+
+#include <algorithm>
+#include <string.h>
+
+LatencyTracker::LatencyTracker()
+{
+	__int64 perfFreq;
+	QueryPerformanceFrequency((LARGE_INTEGER*)&perfFreq);
+	perfCounterMs = 1000.0 / (double)perfFreq;
+
+	nextId = 0;
+	sampleCount = 0;
+	sampleHead = 0;
+	memset(keysHeld, 0, sizeof(keysHeld));
+	memset(keysPressed, 0, sizeof(keysPressed));
+	memset(tickKeys, 0, sizeof(tickKeys));
+}
+
+LatencyTracker::~LatencyTracker()
+{
+	WriteSummary();
+	if (log.is_open())
+		log.close();
+}
+
+// --------------------------------------------------------
+// Opens the per-event log file.  Every presented event
+// gets one line with the time spent in each stage.
+// --------------------------------------------------------
+bool LatencyTracker::OpenLog(const char* filename, const char* summaryFilename)
+{
+	this->summaryFilename = summaryFilename;
+
+	log.open(filename, std::ios::out | std::ios::trunc);
+	if (!log.is_open())
+		return false;
+
+	log << "id,key,capture_to_consume_ms,consume_to_draw_ms,draw_to_present_ms,total_ms\n";
+	return true;
+}
+
+__int64 LatencyTracker::Now()
+{
+	__int64 now;
+	QueryPerformanceCounter((LARGE_INTEGER*)&now);
+	return now;
+}
+
+float LatencyTracker::ToMs(__int64 start, __int64 end)
+{
+	return (float)((end - start) * perfCounterMs);
+}
+
+// --------------------------------------------------------
+// Called from the message handler when a key goes down
+// --------------------------------------------------------
+void LatencyTracker::CaptureInput(unsigned int key)
+{
+	InputEvent e = {};
+	e.Key = key;
+	e.CaptureTime = Now();
+
+	std::lock_guard<std::mutex> lock(eventLock);
+	e.Id = nextId++;
+	pending.push_back(e);
+
+	if (key < KeyCount)
+	{
+		keysHeld[key] = true;
+		keysPressed[key] = true;
+	}
+}
+
+void LatencyTracker::ReleaseInput(unsigned int key)
+{
+	std::lock_guard<std::mutex> lock(eventLock);
+	if (key < KeyCount)
+		keysHeld[key] = false;
+}
+
+void LatencyTracker::ReleaseAllInputs()
+{
+	std::lock_guard<std::mutex> lock(eventLock);
+	memset(keysHeld, 0, sizeof(keysHeld));
+}
+
+bool LatencyTracker::IsKeyDown(unsigned int key)
+{
+	return key < KeyCount && tickKeys[key];
+}
+
+// --------------------------------------------------------
+// Called at the start of a sim tick.  Everything captured
+// since the last tick is tagged with that tick and stamped
+// with the time the tick picked it up, and the keys the
+// tick will see are latched.
+// --------------------------------------------------------
+void LatencyTracker::ConsumeInputs(unsigned long long tick)
+{
+	__int64 now = Now();
+
+	std::lock_guard<std::mutex> lock(eventLock);
+	for (unsigned int i = 0; i < pending.size(); i++)
+	{
+		pending[i].Tick = tick;
+		pending[i].ConsumeTime = now;
+		inFlight.push_back(pending[i]);
+	}
+	pending.clear();
+
+	for (unsigned int k = 0; k < KeyCount; k++)
+		tickKeys[k] = keysHeld[k] || keysPressed[k];
+	memset(keysPressed, 0, sizeof(keysPressed));
+}
+
+// --------------------------------------------------------
+// Called once a frame built from the given tick has been
+// submitted.  The renderer may skip ticks, so everything
+// consumed at or before this tick counts as drawn.
+// --------------------------------------------------------
+void LatencyTracker::MarkDrawn(unsigned long long tick)
+{
+	__int64 now = Now();
+
+	std::lock_guard<std::mutex> lock(eventLock);
+	for (unsigned int i = 0; i < inFlight.size(); i++)
+	{
+		if (inFlight[i].Tick <= tick && inFlight[i].DrawTime == 0)
+			inFlight[i].DrawTime = now;
+	}
+}
+
+// --------------------------------------------------------
+// Called right after Present() - finishes the drawn events,
+// records their total latency and logs them
+// --------------------------------------------------------
+void LatencyTracker::MarkPresented(unsigned long long tick)
+{
+	__int64 now = Now();
+
+	std::lock_guard<std::mutex> lock(eventLock);
+	unsigned int kept = 0;
+	for (unsigned int i = 0; i < inFlight.size(); i++)
+	{
+		InputEvent& e = inFlight[i];
+		if (e.Tick > tick || e.DrawTime == 0)
+		{
+			inFlight[kept++] = e;
+			continue;
+		}
+
+		e.PresentTime = now;
+
+		float total = ToMs(e.CaptureTime, e.PresentTime);
+		samples[sampleHead] = total;
+		sampleHead = (sampleHead + 1) % SampleCount;
+		if (sampleCount < SampleCount)
+			sampleCount++;
+
+		if (log.is_open())
+		{
+			log << e.Id << "," << e.Key << "," <<
+				ToMs(e.CaptureTime, e.ConsumeTime) << "," <<
+				ToMs(e.ConsumeTime, e.DrawTime) << "," <<
+				ToMs(e.DrawTime, e.PresentTime) << "," <<
+				total << "\n";
+		}
+	}
+	inFlight.resize(kept);
+}
+
+// --------------------------------------------------------
+// Returns the given percentile (0-100) of total latency
+// over the recorded events, or 0 if there are none
+// --------------------------------------------------------
+float LatencyTracker::GetPercentile(float percentile)
+{
+	std::lock_guard<std::mutex> lock(eventLock);
+	return GetPercentileLocked(percentile);
+}
+
+float LatencyTracker::GetPercentileLocked(float percentile)
+{
+	if (sampleCount == 0)
+		return 0.0f;
+
+	std::vector<float> sorted(samples, samples + sampleCount);
+	unsigned int n = (unsigned int)(percentile / 100.0f * (sampleCount - 1) + 0.5f);
+	std::nth_element(sorted.begin(), sorted.begin() + n, sorted.end());
+	return sorted[n];
+}
+
+unsigned int LatencyTracker::GetSampleCount()
+{
+	std::lock_guard<std::mutex> lock(eventLock);
+	return sampleCount;
+}
+
+// --------------------------------------------------------
+// Writes the final percentiles to their own file, so the
+// per-event log stays plain CSV
+// --------------------------------------------------------
+void LatencyTracker::WriteSummary()
+{
+	std::lock_guard<std::mutex> lock(eventLock);
+	if (summaryFilename.empty() || sampleCount == 0)
+		return;
+
+	std::ofstream summary(summaryFilename.c_str(), std::ios::out | std::ios::trunc);
+	if (!summary.is_open())
+		return;
+
+	summary << "events: " << sampleCount <<
+		"  p50: " << GetPercentileLocked(50) <<
+		"ms  p95: " << GetPercentileLocked(95) <<
+		"ms  p99: " << GetPercentileLocked(99) << "ms\n";
+}
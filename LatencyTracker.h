@@ -0,0 +1,92 @@
+#pragma once
+
+#include <Windows.h>
+#include <vector>
+#include <fstream>
+#include <mutex>
+#include <string>
+
+// --------------------------------------------------------
+// A single key press, stamped at each stage of the frame
+// pipeline it passes through on its way to the screen
+// --------------------------------------------------------
+struct InputEvent
+{
+	unsigned int Id;
+	unsigned int Key;
+	unsigned long long Tick;	// Sim tick that consumed it
+	__int64 CaptureTime;	// WM_KEYDOWN arrived
+	__int64 ConsumeTime;	// Sim tick that read the input
+	__int64 DrawTime;		// Draw that rendered the result
+	__int64 PresentTime;	// Present() returned
+};
+
+// --------------------------------------------------------
+// Tracks input-to-present latency for key presses and
+// reports percentiles over the most recent events.
+//
+// Capture happens on the message thread, consumption on
+// the sim thread and draw/present on the render thread,
+// so events are matched up by sim tick number.
+//
+// The sim reads its keys from here too (IsKeyDown), so the
+// presses being timed are the ones that actually drive it.
+// A key is down for a tick if it was held when the tick
+// started or pressed at any point since the last one.
+// --------------------------------------------------------
+class LatencyTracker
+{
+public:
+	LatencyTracker();
+	~LatencyTracker();
+
+	// One CSV line per event goes to filename.  The
+	// percentiles are written to summaryFilename on exit.
+	bool OpenLog(const char* filename, const char* summaryFilename);
+
+	// Pipeline stages, in order
+	void CaptureInput(unsigned int key);
+	void ConsumeInputs(unsigned long long tick);
+	void MarkDrawn(unsigned long long tick);
+	void MarkPresented(unsigned long long tick);
+
+	// Stats over the last SampleCount events (milliseconds)
+	float GetPercentile(float percentile);
+	unsigned int GetSampleCount();
+
+	// Key releases from the message thread (focus loss
+	// releases everything)
+	void ReleaseInput(unsigned int key);
+	void ReleaseAllInputs();
+
+	// Virtual key state as of the start of the current sim
+	// tick.  Sim thread only.
+	bool IsKeyDown(unsigned int key);
+
+private:
+	static const unsigned int SampleCount = 512;
+	static const unsigned int KeyCount = 256;
+
+	double perfCounterMs;
+	unsigned int nextId;
+
+	// Guards the event lists, which cross threads
+	std::mutex eventLock;
+	std::vector<InputEvent> pending;
+	std::vector<InputEvent> inFlight;
+	bool keysHeld[KeyCount];
+	bool keysPressed[KeyCount];		// Since the last tick
+	bool tickKeys[KeyCount];
+
+	float samples[SampleCount];
+	unsigned int sampleCount;
+	unsigned int sampleHead;
+
+	std::ofstream log;
+	std::string summaryFilename;
+
+	__int64 Now();
+	float ToMs(__int64 start, __int64 end);
+	float GetPercentileLocked(float percentile);
+	void WriteSummary();
+};
@@ -0,0 +1,322 @@
+#include "LightClusters.h"
+#include "StateCache.h"
+#include "Profiler.h"
+#include <math.h>
+#include <string.h>
+
+using namespace DirectX;
+
+LightClusters::LightClusters(ID3D11Device* device, ID3D11DeviceContext* context)
+{
+	this->device = device;
+	this->context = context;
+
+	nearZ = 0.1f;
+	farZ = 100.0f;
+	sliceScale = 0.0f;
+	sliceBias = 0.0f;
+	stats = {};
+
+	lightBuffer = 0;
+	lightSRV = 0;
+	lightCapacity = 0;
+	indexBuffer = 0;
+	indexSRV = 0;
+	indexCapacity = 0;
+
+	clusterRanges.resize(ClusterCount * 2);
+	CreateStructuredBuffer(sizeof(unsigned int) * 2, ClusterCount, &rangeBuffer, &rangeSRV);
+}
+
+LightClusters::~LightClusters()
+{
+	if (lightSRV) lightSRV->Release();
+	if (lightBuffer) lightBuffer->Release();
+	if (rangeSRV) rangeSRV->Release();
+	if (rangeBuffer) rangeBuffer->Release();
+	if (indexSRV) indexSRV->Release();
+	if (indexBuffer) indexBuffer->Release();
+}
+
+void LightClusters::CreateStructuredBuffer(unsigned int stride, unsigned int count, ID3D11Buffer** buffer, ID3D11ShaderResourceView** srv)
+{
+	D3D11_BUFFER_DESC desc = {};
+	desc.ByteWidth = stride * count;
+	desc.Usage = D3D11_USAGE_DYNAMIC;
+	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	desc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+	desc.StructureByteStride = stride;
+	device->CreateBuffer(&desc, 0, buffer);
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Format = DXGI_FORMAT_UNKNOWN;
+	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+	srvDesc.Buffer.FirstElement = 0;
+	srvDesc.Buffer.NumElements = count;
+	device->CreateShaderResourceView(*buffer, &srvDesc, srv);
+}
+
+// --------------------------------------------------------
+// Pulls the frustum out of a perspective projection and
+// sets up the slice mapping and the column/row planes
+// --------------------------------------------------------
+void LightClusters::SetProjection(CXMMATRIX projection)
+{
+	XMFLOAT4X4 p;
+	XMStoreFloat4x4(&p, projection);
+
+	float tanX = 1.0f / p._11;
+	float tanY = 1.0f / p._22;
+	nearZ = -p._43 / p._33;
+	farZ = p._43 / (1.0f - p._33);
+
+	// Slice = log(depth) * scale + bias, so slice 0 starts at
+	// the near plane and the last one ends at the far plane
+	float logRange = logf(farZ / nearZ);
+	sliceScale = CountZ / logRange;
+	sliceBias = -(CountZ * logf(nearZ)) / logRange;
+
+	// Plane b sits between column b - 1 and column b
+	for (unsigned int b = 1; b < CountX; b++)
+	{
+		float s = (-1.0f + 2.0f * b / CountX) * tanX;
+		float invLength = 1.0f / sqrtf(1.0f + s * s);
+		columnA[b] = invLength;
+		columnC[b] = -s * invLength;
+	}
+
+	// Rows count down from the top of the screen
+	for (unsigned int b = 1; b < CountY; b++)
+	{
+		float s = (1.0f - 2.0f * b / CountY) * tanY;
+		float invLength = 1.0f / sqrtf(1.0f + s * s);
+		rowA[b] = -invLength;
+		rowC[b] = s * invLength;
+	}
+}
+
+unsigned int LightClusters::GetSlice(float depth)
+{
+	if (depth <= nearZ)
+		return 0;
+
+	float slice = logf(depth) * sliceScale + sliceBias;
+	return slice >= CountZ - 1 ? CountZ - 1 : (unsigned int)slice;
+}
+
+void LightClusters::Bin(const std::vector<LocalLight>& lights, FXMMATRIX view)
+{
+	unsigned int count = (unsigned int)lights.size();
+	unsigned int padded = (count + 3) & ~3u;
+
+	sphereX.resize(padded);
+	sphereY.resize(padded);
+	sphereZ.resize(padded);
+	sphereRadius.resize(padded);
+	minColumn.resize(padded);
+	maxColumn.resize(padded);
+	minRow.resize(padded);
+	maxRow.resize(padded);
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		XMFLOAT3 position;
+		XMStoreFloat3(&position, XMVector3TransformCoord(XMLoadFloat3(&lights[i].Position), view));
+		sphereX[i] = position.x;
+		sphereY[i] = position.y;
+		sphereZ[i] = position.z;
+		sphereRadius[i] = lights[i].Range;
+	}
+	for (unsigned int i = count; i < padded; i++)
+	{
+		sphereX[i] = sphereY[i] = sphereZ[i] = 0.0f;
+		sphereRadius[i] = 0.0f;
+	}
+
+	// Four spheres against every column and row plane.  Each
+	// plane a sphere is entirely past pushes its first column
+	// (or row) along by one; each it's entirely before pulls
+	// its last one back.
+	XMVECTOR one = XMVectorSplatOne();
+	for (unsigned int i = 0; i < padded; i += 4)
+	{
+		XMVECTOR x = XMLoadFloat4((const XMFLOAT4*)&sphereX[i]);
+		XMVECTOR y = XMLoadFloat4((const XMFLOAT4*)&sphereY[i]);
+		XMVECTOR z = XMLoadFloat4((const XMFLOAT4*)&sphereZ[i]);
+		XMVECTOR r = XMLoadFloat4((const XMFLOAT4*)&sphereRadius[i]);
+		XMVECTOR negR = -r;
+
+		XMVECTOR past = XMVectorZero();
+		XMVECTOR before = XMVectorZero();
+		for (unsigned int b = 1; b < CountX; b++)
+		{
+			XMVECTOR d = x * XMVectorReplicate(columnA[b]) + z * XMVectorReplicate(columnC[b]);
+			past += XMVectorAndInt(XMVectorGreater(d, r), one);
+			before += XMVectorAndInt(XMVectorLess(d, negR), one);
+		}
+		XMStoreFloat4((XMFLOAT4*)&minColumn[i], past);
+		XMStoreFloat4((XMFLOAT4*)&maxColumn[i], XMVectorReplicate(CountX - 1.0f) - before);
+
+		past = XMVectorZero();
+		before = XMVectorZero();
+		for (unsigned int b = 1; b < CountY; b++)
+		{
+			XMVECTOR d = y * XMVectorReplicate(rowA[b]) + z * XMVectorReplicate(rowC[b]);
+			past += XMVectorAndInt(XMVectorGreater(d, r), one);
+			before += XMVectorAndInt(XMVectorLess(d, negR), one);
+		}
+		XMStoreFloat4((XMFLOAT4*)&minRow[i], past);
+		XMStoreFloat4((XMFLOAT4*)&maxRow[i], XMVectorReplicate(CountY - 1.0f) - before);
+	}
+
+	// Drop whatever's out of view and find each light's box of
+	// clusters, counting how many lights land in each cluster
+	visible.clear();
+	visibleLights.clear();
+	memset(&clusterRanges[0], 0, sizeof(unsigned int) * clusterRanges.size());
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		float z = sphereZ[i];
+		float r = sphereRadius[i];
+		if (r <= 0.0f || z + r < nearZ || z - r > farZ)
+			continue;
+
+		LightBounds bounds;
+		bounds.Light = (unsigned int)visibleLights.size();
+		bounds.MinZ = GetSlice(z - r);
+		bounds.MaxZ = GetSlice(z + r);
+
+		// The plane tests only order the columns properly in
+		// front of the camera, so a sphere reaching behind it
+		// is treated as touching all of them
+		if (z < r)
+		{
+			bounds.MinX = 0;
+			bounds.MaxX = CountX - 1;
+			bounds.MinY = 0;
+			bounds.MaxY = CountY - 1;
+		}
+		else
+		{
+			if (minColumn[i] > maxColumn[i] || minRow[i] > maxRow[i])
+				continue;
+			bounds.MinX = (unsigned int)minColumn[i];
+			bounds.MaxX = (unsigned int)maxColumn[i];
+			bounds.MinY = (unsigned int)minRow[i];
+			bounds.MaxY = (unsigned int)maxRow[i];
+		}
+
+		for (unsigned int cz = bounds.MinZ; cz <= bounds.MaxZ; cz++)
+			for (unsigned int cy = bounds.MinY; cy <= bounds.MaxY; cy++)
+				for (unsigned int cx = bounds.MinX; cx <= bounds.MaxX; cx++)
+					clusterRanges[((cz * CountY + cy) * CountX + cx) * 2 + 1]++;
+
+		visible.push_back(bounds);
+		visibleLights.push_back(lights[i]);
+	}
+
+	// Counts to offsets, then fill in the indices.  The counts
+	// are rebuilt as each cluster's write cursor.
+	unsigned int total = 0;
+	stats = {};
+	for (unsigned int c = 0; c < ClusterCount; c++)
+	{
+		unsigned int clusterLights = clusterRanges[c * 2 + 1];
+		clusterRanges[c * 2] = total;
+		clusterRanges[c * 2 + 1] = 0;
+		total += clusterLights;
+
+		stats.OccupiedClusters += clusterLights ? 1 : 0;
+		if (clusterLights > stats.MaxPerCluster)
+			stats.MaxPerCluster = clusterLights;
+	}
+
+	lightIndices.resize(total);
+	for (size_t v = 0; v < visible.size(); v++)
+	{
+		const LightBounds& bounds = visible[v];
+		for (unsigned int cz = bounds.MinZ; cz <= bounds.MaxZ; cz++)
+			for (unsigned int cy = bounds.MinY; cy <= bounds.MaxY; cy++)
+				for (unsigned int cx = bounds.MinX; cx <= bounds.MaxX; cx++)
+				{
+					unsigned int* range = &clusterRanges[((cz * CountY + cy) * CountX + cx) * 2];
+					lightIndices[range[0] + range[1]++] = bounds.Light;
+				}
+	}
+
+	stats.Lights = count;
+	stats.VisibleLights = (unsigned int)visibleLights.size();
+	stats.Indices = total;
+}
+
+void LightClusters::UploadBuffer(ID3D11Buffer* buffer, const void* data, size_t size)
+{
+	if (size == 0)
+		return;
+
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	if (FAILED(context->Map(buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+		return;
+	memcpy(mapped.pData, data, size);
+	context->Unmap(buffer, 0);
+}
+
+// --------------------------------------------------------
+// Grows the light and index buffers (doubling, so they
+// settle quickly) and copies this frame's data in
+// --------------------------------------------------------
+void LightClusters::Upload()
+{
+	unsigned int lightCount = (unsigned int)visibleLights.size();
+	if (lightCount > lightCapacity || !lightBuffer)
+	{
+		if (lightSRV) lightSRV->Release();
+		if (lightBuffer) lightBuffer->Release();
+		lightCapacity = lightCapacity ? lightCapacity : 64;
+		while (lightCapacity < lightCount)
+			lightCapacity *= 2;
+		CreateStructuredBuffer(sizeof(LocalLight), lightCapacity, &lightBuffer, &lightSRV);
+	}
+
+	unsigned int indexCount = (unsigned int)lightIndices.size();
+	if (indexCount > indexCapacity || !indexBuffer)
+	{
+		if (indexSRV) indexSRV->Release();
+		if (indexBuffer) indexBuffer->Release();
+		indexCapacity = indexCapacity ? indexCapacity : 1024;
+		while (indexCapacity < indexCount)
+			indexCapacity *= 2;
+		CreateStructuredBuffer(sizeof(unsigned int), indexCapacity, &indexBuffer, &indexSRV);
+	}
+
+	UploadBuffer(lightBuffer, visibleLights.data(), sizeof(LocalLight) * lightCount);
+	UploadBuffer(rangeBuffer, clusterRanges.data(), sizeof(unsigned int) * clusterRanges.size());
+	UploadBuffer(indexBuffer, lightIndices.data(), sizeof(unsigned int) * indexCount);
+}
+
+void LightClusters::Update(const std::vector<LocalLight>& lights, FXMMATRIX view, CXMMATRIX projection)
+{
+	PROFILE_FUNCTION();
+
+	SetProjection(projection);
+	Bin(lights, view);
+	Upload();
+}
+
+void LightClusters::SetFrameConstants(PerFrameData& data, unsigned int width, unsigned int height)
+{
+	data.ClusterTileScale = XMFLOAT2((float)CountX / width, (float)CountY / height);
+	data.ClusterSliceScale = sliceScale;
+	data.ClusterSliceBias = sliceBias;
+	data.ClusterCounts = XMUINT3(CountX, CountY, CountZ);
+	data.LocalLightCount = (unsigned int)visibleLights.size();
+}
+
+void LightClusters::Bind(StateCache* stateCache)
+{
+	stateCache->SetShaderResource(SHADER_STAGE_PIXEL, LightsSlot, lightSRV);
+	stateCache->SetShaderResource(SHADER_STAGE_PIXEL, RangesSlot, rangeSRV);
+	stateCache->SetShaderResource(SHADER_STAGE_PIXEL, IndicesSlot, indexSRV);
+}
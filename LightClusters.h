@@ -0,0 +1,118 @@
+#pragma once
+
+#include <d3d11.h>
+#include <DirectXMath.h>
+#include <vector>
+#include "Lights.h"
+#include "FrameConstants.h"
+
+class StateCache;
+
+struct LightClusterStats
+{
+	unsigned int Lights;
+	unsigned int VisibleLights;
+	unsigned int Indices;			// Light-in-cluster entries
+	unsigned int OccupiedClusters;
+	unsigned int MaxPerCluster;
+};
+
+// --------------------------------------------------------
+// Sorts point and spot lights into a grid of clusters over
+// the view frustum - screen tiles, each cut into slices by
+// depth - so a pixel only has to look at the lights that
+// can reach its cluster.
+//
+// Binning works on each light's bounding sphere in view
+// space.  Depth slices come straight from the sphere's near
+// and far depth.  Columns and rows are found by testing the
+// sphere against the planes between them, four lights at a
+// time in SIMD registers: the number of planes a sphere is
+// completely past is the first column (or row) it touches.
+// Each column, row and slice is tested on its own, so a
+// light can be put in a corner cluster it doesn't actually
+// reach, but never left out of one it does.
+//
+// The results go to the GPU as three structured buffers:
+// the visible lights, an (offset, count) range per cluster
+// and the packed light indices the ranges point into.
+// --------------------------------------------------------
+class LightClusters
+{
+public:
+	// Grid size.  Shaders get it from the per-frame constants,
+	// so it can change without touching them.
+	static const unsigned int CountX = 16;
+	static const unsigned int CountY = 9;
+	static const unsigned int CountZ = 24;
+	static const unsigned int ClusterCount = CountX * CountY * CountZ;
+
+	// Pixel shader registers, see LightClusters.hlsli
+	static const unsigned int LightsSlot = 8;
+	static const unsigned int RangesSlot = 9;
+	static const unsigned int IndicesSlot = 10;
+
+	LightClusters(ID3D11Device* device, ID3D11DeviceContext* context);
+	~LightClusters();
+
+	// Bins the lights for a (row vector, not transposed) view
+	// and perspective projection, and uploads the results
+	void Update(const std::vector<LocalLight>& lights, DirectX::FXMMATRIX view, DirectX::CXMMATRIX projection);
+
+	// Cluster lookup constants for the shaders
+	void SetFrameConstants(PerFrameData& data, unsigned int width, unsigned int height);
+
+	void Bind(StateCache* stateCache);
+
+	const LightClusterStats& GetStats() { return stats; }
+
+private:
+	struct LightBounds
+	{
+		unsigned int Light;
+		unsigned int MinX, MaxX;
+		unsigned int MinY, MaxY;
+		unsigned int MinZ, MaxZ;
+	};
+
+	ID3D11Device* device;
+	ID3D11DeviceContext* context;
+
+	float nearZ;
+	float farZ;
+	float sliceScale;
+	float sliceBias;
+
+	// Planes between columns and rows, through the camera.
+	// Signed distance is x * A + z * C (columns, positive to
+	// the right) or y * A + z * C (rows, positive downwards).
+	float columnA[CountX], columnC[CountX];
+	float rowA[CountY], rowC[CountY];
+
+	// View space bounding spheres, padded to a multiple of four
+	std::vector<float> sphereX, sphereY, sphereZ, sphereRadius;
+	std::vector<float> minColumn, maxColumn, minRow, maxRow;
+
+	std::vector<LightBounds> visible;
+	std::vector<LocalLight> visibleLights;
+	std::vector<unsigned int> clusterRanges;	// Offset, count pairs
+	std::vector<unsigned int> lightIndices;
+
+	ID3D11Buffer* lightBuffer;
+	ID3D11ShaderResourceView* lightSRV;
+	unsigned int lightCapacity;
+	ID3D11Buffer* rangeBuffer;
+	ID3D11ShaderResourceView* rangeSRV;
+	ID3D11Buffer* indexBuffer;
+	ID3D11ShaderResourceView* indexSRV;
+	unsigned int indexCapacity;
+
+	LightClusterStats stats;
+
+	void SetProjection(DirectX::CXMMATRIX projection);
+	void Bin(const std::vector<LocalLight>& lights, DirectX::FXMMATRIX view);
+	void Upload();
+	void CreateStructuredBuffer(unsigned int stride, unsigned int count, ID3D11Buffer** buffer, ID3D11ShaderResourceView** srv);
+	void UploadBuffer(ID3D11Buffer* buffer, const void* data, size_t size);
+	unsigned int GetSlice(float depth);
+};
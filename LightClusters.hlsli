@@ -0,0 +1,49 @@
+#ifndef __LIGHT_CLUSTERS_HLSLI__
+#define __LIGHT_CLUSTERS_HLSLI__
+
+// Needs the cluster constants from the perFrame cbuffer
+#include "FrameConstants.hlsli"
+
+// See LocalLight in Lights.h
+struct LocalLight
+{
+	float3 Position;
+	float Range;
+	float3 Color;
+	float SpotScale;
+	float3 Direction;
+	float SpotOffset;
+};
+
+// Filled in by LightClusters every frame.  Each cluster's
+// range is (first index, count) into LightIndices.
+StructuredBuffer<LocalLight> LocalLights	: register(t8);
+StructuredBuffer<uint2> LightClusterRanges	: register(t9);
+StructuredBuffer<uint> LightIndices			: register(t10);
+
+// --------------------------------------------------------
+// Which cluster a pixel falls in: a screen tile, then a
+// slice by view depth (exponentially spaced, so slices
+// far away are as deep as they are wide)
+// --------------------------------------------------------
+uint GetLightCluster(float2 pixel, float3 worldPos)
+{
+	float depth = mul(float4(worldPos, 1.0f), view).z;
+
+	uint3 cell;
+	cell.xy = (uint2)(pixel * ClusterTileScale);
+	cell.z = (uint)max(log(max(depth, 0.0001f)) * ClusterSliceScale + ClusterSliceBias, 0.0f);
+	cell = min(cell, ClusterCounts - 1);
+
+	return (cell.z * ClusterCounts.y + cell.y) * ClusterCounts.x + cell.x;
+}
+
+// Smooth falloff to zero at the light's range
+float GetLocalLightAttenuation(LocalLight light, float3 toLight, float distance)
+{
+	float falloff = saturate(1.0f - (distance * distance) / (light.Range * light.Range));
+	float spot = saturate(dot(-toLight, light.Direction) * light.SpotScale + light.SpotOffset);
+	return falloff * falloff * spot;
+}
+
+#endif
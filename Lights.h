@@ -1,10 +1,47 @@
 #pragma once
 
 #include <DirectXMath.h>
+#include <math.h>
 
 struct DirectionalLight
 {
 	DirectX::XMFLOAT4 AmbientColor;
 	DirectX::XMFLOAT4 DiffuseColor;
 	DirectX::XMFLOAT3 Direction;
-};
\ No newline at end of file
+};
+
+// --------------------------------------------------------
+// A point or spot light with a limited range.  Matches
+// LocalLight in LightClusters.hlsli (48 bytes).
+//
+// The cone falloff is saturate(cos * SpotScale + SpotOffset),
+// with cos the angle from Direction - a point light is just
+// a spot with scale 0 and offset 1.
+// --------------------------------------------------------
+struct LocalLight
+{
+	DirectX::XMFLOAT3 Position;
+	float Range;
+	DirectX::XMFLOAT3 Color;	// Intensity included
+	float SpotScale;
+	DirectX::XMFLOAT3 Direction;
+	float SpotOffset;
+};
+
+inline LocalLight MakePointLight(DirectX::XMFLOAT3 position, float range, DirectX::XMFLOAT3 color)
+{
+	LocalLight light = { position, range, color, 0.0f, DirectX::XMFLOAT3(0, 0, 1), 1.0f };
+	return light;
+}
+
+// Angles are half angles of the cone, in radians.  Full
+// brightness inside innerAngle, fading out by outerAngle.
+inline LocalLight MakeSpotLight(DirectX::XMFLOAT3 position, DirectX::XMFLOAT3 direction, float range, DirectX::XMFLOAT3 color, float innerAngle, float outerAngle)
+{
+	float cosInner = cosf(innerAngle);
+	float cosOuter = cosf(outerAngle);
+	float scale = 1.0f / fmaxf(cosInner - cosOuter, 0.001f);
+
+	LocalLight light = { position, range, color, scale, direction, -cosOuter * scale };
+	return light;
+}
@@ -1,4 +1,5 @@
 #include "Material.h"
+#include <string.h>
 
 Material::Material(SimpleVertexShader* vertShaderPtr, SimplePixelShader* pixelShaderPtr, DirectX::XMFLOAT4 color, float shininess, DirectX::XMFLOAT2 uvScale, ID3D11ShaderResourceView* albedo, ID3D11ShaderResourceView* normals, ID3D11ShaderResourceView* roughness, ID3D11ShaderResourceView* metal, ID3D11SamplerState* samplerState)
 {
@@ -12,6 +13,8 @@ Material::Material(SimpleVertexShader* vertShaderPtr, SimplePixelShader* pixelSh
 	this->metalSRV = metal;
 	this->samplerState = samplerState;
 	this->uvScale = uvScale;
+	this->instancedVertShader = 0;
+	this->handlesResolved = false;
 }
 
 SimpleVertexShader* Material::GetVertexShader()
@@ -63,3 +66,73 @@ ID3D11SamplerState* Material::GetSamplerState()
 {
 	return samplerState;
 }
+
+SimpleVertexShader* Material::GetInstancedVertexShader()
+{
+	return instancedVertShader;
+}
+
+void Material::SetInstancedVertexShader(SimpleVertexShader* instancedVertShaderPtr)
+{
+	instancedVertShader = instancedVertShaderPtr;
+	handlesResolved = false;
+}
+
+const MaterialShaderHandles& Material::GetShaderHandles()
+{
+	if (!handlesResolved)
+	{
+		handles.World = vertShader->GetVariableHandle("world");
+		handles.UVScale = vertShader->GetVariableHandle("uvScale");
+		if (instancedVertShader)
+			handles.MaterialTable = instancedVertShader->GetVariableHandle("materialUVScale");
+
+		handles.AlbedoTexture = pixelShader->GetShaderResourceViewHandle("AlbedoTexture");
+		handles.NormalTexture = pixelShader->GetShaderResourceViewHandle("NormalTexture");
+		handles.RoughnessTexture = pixelShader->GetShaderResourceViewHandle("RoughnessTexture");
+		handles.MetalTexture = pixelShader->GetShaderResourceViewHandle("MetalTexture");
+		handles.BasicSampler = pixelShader->GetSamplerHandle("BasicSampler");
+
+		handles.ScenePixels = pixelShader->GetShaderResourceViewHandle("ScenePixels");
+		handles.NormalMap = pixelShader->GetShaderResourceViewHandle("NormalMap");
+		handles.RefractSampler = pixelShader->GetSamplerHandle("RefractSampler");
+
+		handlesResolved = true;
+	}
+	return handles;
+}
+
+void Material::RecordTextures(CommandBuffer& commands)
+{
+	if (handles.AlbedoTexture.IsValid())
+		commands.SetTexture(COMMAND_STAGE_PIXEL, handles.AlbedoTexture.BindIndex, albedoSRV);
+	if (handles.NormalTexture.IsValid())
+		commands.SetTexture(COMMAND_STAGE_PIXEL, handles.NormalTexture.BindIndex, normalSRV);
+	if (handles.RoughnessTexture.IsValid())
+		commands.SetTexture(COMMAND_STAGE_PIXEL, handles.RoughnessTexture.BindIndex, roughnessSRV);
+	if (handles.MetalTexture.IsValid())
+		commands.SetTexture(COMMAND_STAGE_PIXEL, handles.MetalTexture.BindIndex, metalSRV);
+	if (handles.BasicSampler.IsValid())
+		commands.SetSampler(COMMAND_STAGE_PIXEL, handles.BasicSampler.BindIndex, samplerState);
+}
+
+void RecordShaderConstants(CommandBuffer& commands, ISimpleShader* shader, CommandStage stage, const ConstantPatch* patches, unsigned int patchCount)
+{
+	for (unsigned int i = 0; i < shader->GetBufferCount(); i++)
+	{
+		const SimpleConstantBuffer* cb = shader->GetBufferInfo(i);
+		if (cb->External)
+		{
+			commands.SetConstantBuffer(stage, cb->BindIndex, cb->ConstantBuffer);
+			continue;
+		}
+
+		unsigned char* data = commands.SetConstants(stage, cb->BindIndex, cb->LocalDataBuffer, cb->Size);
+		for (unsigned int p = 0; p < patchCount; p++)
+		{
+			const SimpleVariableHandle& variable = patches[p].Variable;
+			if (variable.IsValid() && variable.ConstantBufferIndex == i)
+				memcpy(data + variable.ByteOffset, patches[p].Data, patches[p].Size < variable.Size ? patches[p].Size : variable.Size);
+		}
+	}
+}
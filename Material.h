@@ -3,6 +3,53 @@
 #include <DirectXMath.h>
 #include "DXCore.h"
 #include "SimpleShader.h"
+#include "CommandBuffer.h"
+
+// --------------------------------------------------------
+// Handles for everything Entity sets on a material's
+// shaders each draw.  Names a shader doesn't have just end
+// up as invalid handles, which the Set methods ignore.
+// --------------------------------------------------------
+struct MaterialShaderHandles
+{
+	// Vertex shader
+	SimpleVariableHandle World;
+	SimpleVariableHandle UVScale;
+
+	// Instanced vertex shader
+	SimpleVariableHandle MaterialTable;
+
+	// Pixel shader
+	SimpleSRVHandle AlbedoTexture;
+	SimpleSRVHandle NormalTexture;
+	SimpleSRVHandle RoughnessTexture;
+	SimpleSRVHandle MetalTexture;
+	SimpleSamplerHandle BasicSampler;
+
+	// Refraction pixel shader
+	SimpleSRVHandle ScenePixels;
+	SimpleSRVHandle NormalMap;
+	SimpleSamplerHandle RefractSampler;
+};
+
+// --------------------------------------------------------
+// A value to write over a shader variable when recording
+// its constants
+// --------------------------------------------------------
+struct ConstantPatch
+{
+	SimpleVariableHandle Variable;
+	const void* Data;
+	unsigned int Size;
+};
+
+// --------------------------------------------------------
+// Records every constant buffer a shader uses: a copy of
+// each of its own, with any patches applied, and a bind
+// for each external one (the per-frame constants).  Only
+// reads the shader, so any thread can do it.
+// --------------------------------------------------------
+void RecordShaderConstants(CommandBuffer& commands, ISimpleShader* shader, CommandStage stage, const ConstantPatch* patches = 0, unsigned int patchCount = 0);
 
 class Material
 {
@@ -20,10 +67,24 @@ public:
 	float GetShininess();
 	ID3D11SamplerState* GetSamplerState();
 
+	// Optional vertex shader that takes the world matrix and
+	// material index per instance (see InstanceRenderer)
+	SimpleVertexShader* GetInstancedVertexShader();
+	void SetInstancedVertexShader(SimpleVertexShader* instancedVertShaderPtr);
+
+	// Resolved the first time they're asked for, since the
+	// shaders may still be loading when we're created
+	const MaterialShaderHandles& GetShaderHandles();
+
+	// Records the textures and sampler the pixel shader
+	// samples.  Handles must already be resolved.
+	void RecordTextures(CommandBuffer& commands);
+
 private:
 
 	SimpleVertexShader* vertShader;
 	SimplePixelShader* pixelShader;
+	SimpleVertexShader* instancedVertShader;
 	
 	DirectX::XMFLOAT2 uvScale;
 	DirectX::XMFLOAT4 color;
@@ -34,5 +95,8 @@ private:
 	ID3D11ShaderResourceView* roughnessSRV;
 	ID3D11ShaderResourceView* metalSRV;
 	ID3D11SamplerState* samplerState;
+
+	MaterialShaderHandles handles;
+	bool handlesResolved;
 };
 
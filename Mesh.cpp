@@ -1,7 +1,10 @@
 #include "Mesh.h"
+#include "Profiler.h"
 #include <DirectXMath.h>
 #include <fstream>
 #include <vector>
+#include <float.h>
+#include <math.h>
 using namespace DirectX;
 
 
@@ -13,19 +16,51 @@ Mesh::Mesh(Vertex* vertices, int numVerts, unsigned int* indices, int numIndices
 
 Mesh::Mesh(char* objFile, ID3D11Device* device)
 {
+	std::vector<Vertex> verts;
+	std::vector<unsigned int> indices;
+	if (!LoadOBJ(objFile, verts, indices))
+		return;
+
+	CreateGPUBuffers(&verts[0], (int)verts.size(), &indices[0], (int)indices.size(), device);
+}
+
+// --------------------------------------------------------
+// Builds a mesh from vertices that already have tangents,
+// such as those from LoadOBJ().  Only creates the buffers,
+// and keeps a copy of the vertices and indices if asked.
+// --------------------------------------------------------
+Mesh::Mesh(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, ID3D11Device* device, bool keepCPUCopy)
+{
+	CreateGPUBuffers(&vertices[0], (int)vertices.size(), &indices[0], (int)indices.size(), device);
+
+	if (keepCPUCopy)
+	{
+		cpuVertices = vertices;
+		cpuIndices = indices;
+	}
+}
+
+// --------------------------------------------------------
+// Parses an OBJ file and calculates its tangents.  Touches
+// no D3D objects, so it's safe to call from any thread.
+//
+// Returns false if the file can't be opened or is empty
+// --------------------------------------------------------
+bool Mesh::LoadOBJ(const char* objFile, std::vector<Vertex>& verts, std::vector<unsigned int>& indices)
+{
+	PROFILE_FUNCTION();
+
 	// File input object
 	std::ifstream obj(objFile);
 
 	// Check for successful open
 	if (!obj.is_open())
-		return;
+		return false;
 
 	// Variables used while reading the file
 	std::vector<XMFLOAT3> positions;     // Positions from the file
 	std::vector<XMFLOAT3> normals;       // Normals from the file
 	std::vector<XMFLOAT2> uvs;           // UVs from the file
-	std::vector<Vertex> verts;           // Verts we're assembling
-	std::vector<UINT> indices;           // Indices of these verts
 	unsigned int vertCounter = 0;        // Count of vertices/indices
 	char chars[100];                     // String for line reading
 
@@ -166,22 +201,14 @@ Mesh::Mesh(char* objFile, ID3D11Device* device)
 		}
 	}
 
-	// Close the file and create the actual buffers
+	// Close the file
 	obj.close();
 
+	if (vertCounter == 0)
+		return false;
 
-	// - At this point, "verts" is a vector of Vertex structs, and can be used
-	//    directly to create a vertex buffer:  &verts[0] is the address of the first vert
-	//
-	// - The vector "indices" is similar. It's a vector of unsigned ints and
-	//    can be used directly for the index buffer: &indices[0] is the address of the first int
-	//
-	// - "vertCounter" is BOTH the number of vertices and the number of indices
-	// - Yes, the indices are a bit redundant here (one per vertex).  Could you skip using
-	//    an index buffer in this case?  Sure!  Though, if your mesh class assumes you have
-	//    one, you'll need to write some extra code to handle cases when you don't.
-
-	CreateBuffer(&verts[0], vertCounter, &indices[0], vertCounter, device);
+	CalculateTangents(&verts[0], vertCounter, &indices[0], vertCounter);
+	return true;
 }
 
 Mesh::~Mesh()
@@ -209,6 +236,51 @@ void Mesh::CreateBuffer(Vertex* vertices, int numVerts, unsigned int* indices, i
 {
 	// Calculate the tangents before copying to buffer
 	CalculateTangents(vertices, numVerts, indices, numIndices);
+	CreateGPUBuffers(vertices, numVerts, indices, numIndices, device);
+}
+
+// --------------------------------------------------------
+// Axis-aligned box around the vertices, and a sphere around
+// the box's center that holds every vertex (not the
+// tightest sphere, but close enough for culling)
+// --------------------------------------------------------
+void Mesh::CalculateBounds(Vertex* verts, int numVerts)
+{
+	XMVECTOR minV = XMVectorReplicate(FLT_MAX);
+	XMVECTOR maxV = XMVectorReplicate(-FLT_MAX);
+	for (int i = 0; i < numVerts; i++)
+	{
+		XMVECTOR p = XMLoadFloat3(&verts[i].Position);
+		minV = XMVectorMin(minV, p);
+		maxV = XMVectorMax(maxV, p);
+	}
+
+	if (numVerts == 0)
+	{
+		minV = XMVectorZero();
+		maxV = XMVectorZero();
+	}
+
+	XMVECTOR center = (minV + maxV) * 0.5f;
+	XMVECTOR radiusSq = XMVectorZero();
+	for (int i = 0; i < numVerts; i++)
+	{
+		XMVECTOR p = XMLoadFloat3(&verts[i].Position);
+		radiusSq = XMVectorMax(radiusSq, XMVector3LengthSq(p - center));
+	}
+
+	XMStoreFloat3(&boundsMin, minV);
+	XMStoreFloat3(&boundsMax, maxV);
+	XMStoreFloat3(&sphereCenter, center);
+	sphereRadius = sqrtf(XMVectorGetX(radiusSq));
+}
+
+void Mesh::CreateGPUBuffers(Vertex* vertices, int numVerts, unsigned int* indices, int numIndices, ID3D11Device* device)
+{
+	PROFILE_FUNCTION();
+
+	// Every constructor ends up here, so this is where bounds get made
+	CalculateBounds(vertices, numVerts);
 
 	// Set up the vertices of the triangle we would like to draw
 	// - We're going to copy this array, exactly as it exists in memory
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <d3d11.h>
+#include <vector>
 #include "Vertex.h"
 
 class Mesh
@@ -8,6 +9,7 @@ class Mesh
 public:
 	Mesh(Vertex* vertices, int numVerts, unsigned int* indices, int numIndices, ID3D11Device* device);
 	Mesh(char* filename, ID3D11Device* device);
+	Mesh(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, ID3D11Device* device, bool keepCPUCopy = false);
 	
 	~Mesh();
 	ID3D11Buffer* GetVertexBuffer();
@@ -15,11 +17,36 @@ public:
 
 	int GetIndexCount();
 
+	// Local space bounds, from the vertices at creation
+	DirectX::XMFLOAT3 GetBoundsMin() { return boundsMin; }
+	DirectX::XMFLOAT3 GetBoundsMax() { return boundsMax; }
+	DirectX::XMFLOAT3 GetBoundingSphereCenter() { return sphereCenter; }
+	float GetBoundingSphereRadius() { return sphereRadius; }
+
+	// Copy of what went into the buffers, for baking into
+	// static batches.  Empty unless the mesh was made with
+	// keepCPUCopy.
+	const std::vector<Vertex>& GetVertices() { return cpuVertices; }
+	const std::vector<unsigned int>& GetIndices() { return cpuIndices; }
+
+	// CPU half of loading a model - thread safe, no D3D calls
+	static bool LoadOBJ(const char* filename, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+
 private:
 	ID3D11Buffer* vertexBuffer;
 	ID3D11Buffer* indexBuffer;
 	void CreateBuffer(Vertex* vertices, int numVerts, unsigned int* indices, int numIndices, ID3D11Device* device);
-	void CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices);
+	void CreateGPUBuffers(Vertex* vertices, int numVerts, unsigned int* indices, int numIndices, ID3D11Device* device);
+	static void CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices);
+	void CalculateBounds(Vertex* verts, int numVerts);
 	int indexVerts;
+
+	DirectX::XMFLOAT3 boundsMin;
+	DirectX::XMFLOAT3 boundsMax;
+	DirectX::XMFLOAT3 sphereCenter;
+	float sphereRadius;
+
+	std::vector<Vertex> cpuVertices;
+	std::vector<unsigned int> cpuIndices;
 };
 
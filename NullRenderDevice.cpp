@@ -0,0 +1,93 @@
+#include "NullRenderDevice.h"
+
+NullRenderDevice::NullRenderDevice()
+{
+}
+
+CommandHandle NullRenderDevice::AddResource(unsigned int size)
+{
+	Resource resource;
+	resource.Live = true;
+	resource.Size = size;
+
+	unsigned int index;
+	if (!freeResources.empty())
+	{
+		index = freeResources.back();
+		freeResources.pop_back();
+		resources[index] = resource;
+	}
+	else
+	{
+		index = (unsigned int)resources.size();
+		resources.push_back(resource);
+	}
+
+	stats.Buffers++;
+	stats.ResourceBytes += size;
+
+	return (CommandHandle)(uintptr_t)(index + 1);
+}
+
+void NullRenderDevice::RemoveResource(CommandHandle handle)
+{
+	uintptr_t index = (uintptr_t)handle - 1;
+	if (index >= resources.size() || !resources[index].Live)
+		return;
+
+	Resource& resource = resources[index];
+	stats.Buffers--;
+	stats.ResourceBytes -= resource.Size;
+
+	resource.Live = false;
+	freeResources.push_back((unsigned int)index);
+}
+
+CommandHandle NullRenderDevice::CreateBuffer(const RenderBufferDesc& desc, const void* data)
+{
+	if (data)
+		stats.UploadedBytes += desc.Size;
+	return AddResource(desc.Size);
+}
+
+void NullRenderDevice::UpdateBuffer(CommandHandle buffer, const void* data, unsigned int size)
+{
+	(void)buffer;
+	(void)data;
+	stats.UploadedBytes += size;
+}
+
+void NullRenderDevice::DestroyBuffer(CommandHandle buffer)
+{
+	RemoveResource(buffer);
+}
+
+void NullRenderDevice::Execute(const CommandBuffer& commands)
+{
+	size_t offset = 0;
+	const CommandHeader* header;
+	const void* payload;
+
+	while (commands.Read(offset, header, payload))
+	{
+		switch (header->Type)
+		{
+		case COMMAND_DRAW_INDEXED:
+			stats.Draws++;
+			break;
+
+		case COMMAND_SET_CONSTANTS:
+			stats.UploadedBytes += ((const SetConstantsCommand*)payload)->Size;
+			stats.Binds++;
+			break;
+
+		default:
+			stats.Binds++;
+			break;
+		}
+
+		stats.Commands++;
+	}
+
+	stats.CommandBuffers++;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <vector>
+#include "RenderDevice.h"
+
+// --------------------------------------------------------
+// A device with nothing behind it.  Buffers are just sizes
+// in a table and command buffers are walked and counted,
+// but nothing is drawn.
+//
+// Only uses the standard library, like CommandBuffer.
+// --------------------------------------------------------
+class NullRenderDevice : public RenderDevice
+{
+public:
+	NullRenderDevice();
+
+	CommandHandle CreateBuffer(const RenderBufferDesc& desc, const void* data);
+	void UpdateBuffer(CommandHandle buffer, const void* data, unsigned int size);
+	void DestroyBuffer(CommandHandle buffer);
+
+	void Execute(const CommandBuffer& commands);
+
+private:
+	struct Resource
+	{
+		bool Live;
+		unsigned int Size;
+	};
+
+	// Handles are index + 1, so zero is never a valid one
+	std::vector<Resource> resources;
+	std::vector<unsigned int> freeResources;
+
+	CommandHandle AddResource(unsigned int size);
+	void RemoveResource(CommandHandle handle);
+};
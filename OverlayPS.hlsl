@@ -0,0 +1,38 @@
+
+// Defines the input to this pixel shader
+// - Should match the output of our corresponding vertex shader
+struct VertexToPixel
+{
+	float4 position		: SV_POSITION;
+	float2 cell			: TEXCOORD;
+	float4 color		: COLOR;
+	nointerpolation uint glyph : GLYPH;
+};
+
+// Quads that aren't text
+#define SOLID_GLYPH 0xFFFFFFFF
+
+// A 3x5 pixel font, one bit per pixel, row by row from the
+// top left.  Same order as FrameOverlay's glyph string.
+static const uint Glyphs[44] =
+{
+	0x0000, 0x7B6F, 0x749A, 0x73E7, 0x79A7, 0x49ED, 0x79CF, 0x7BCF,	// space 0123456
+	0x24A7, 0x7BEF, 0x79EF, 0x5BEA, 0x3AEB, 0x624E, 0x3B6B, 0x72CF,	// 789ABCDE
+	0x12CF, 0x6B4E, 0x5BED, 0x7497, 0x2B24, 0x5AED, 0x7249, 0x5BFD,	// FGHIJKLM
+	0x5B6B, 0x2B6A, 0x12EB, 0x676A, 0x5AEB, 0x388E, 0x2497, 0x7B6D,	// NOPQRSTU
+	0x2B6D, 0x5FED, 0x5AAD, 0x24AD, 0x72A7, 0x2000, 0x0410, 0x12A4,	// VWXYZ.:/
+	0x52A5, 0x01C0, 0x224A, 0x2922,									// %-()
+};
+
+// Entry point for this pixel shader
+float4 main(VertexToPixel input) : SV_TARGET
+{
+	if (input.glyph != SOLID_GLYPH)
+	{
+		uint2 pixel = min((uint2)input.cell, uint2(2, 4));
+		if (((Glyphs[input.glyph] >> (pixel.y * 3 + pixel.x)) & 1) == 0)
+			discard;
+	}
+
+	return input.color;
+}
@@ -0,0 +1,32 @@
+
+// Positions are already in clip space - the overlay is
+// laid out in pixels on the CPU
+struct VertexShaderInput
+{
+	float2 position		: POSITION;
+	float2 cell			: TEXCOORD;
+	float4 color		: COLOR;
+	uint glyph			: GLYPH;
+};
+
+// Out of the vertex shader (and eventually input to the PS)
+struct VertexToPixel
+{
+	float4 position		: SV_POSITION;
+	float2 cell			: TEXCOORD;	// Font pixel within the glyph
+	float4 color		: COLOR;
+	nointerpolation uint glyph : GLYPH;
+};
+
+// --------------------------------------------------------
+// The entry point (main method) for our vertex shader
+// --------------------------------------------------------
+VertexToPixel main(VertexShaderInput input)
+{
+	VertexToPixel output;
+	output.position = float4(input.position, 0.0f, 1.0f);
+	output.cell = input.cell;
+	output.color = input.color;
+	output.glyph = input.glyph;
+	return output;
+}
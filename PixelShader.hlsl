@@ -1,20 +1,6 @@
+#include "FrameConstants.hlsli"
+#include "LightClusters.hlsli"
 
-struct DirectionalLight {
-
-	float4 AmbientColor;
-	float4 DiffuseColor;
-	float3 Direction;
-};
-
-cbuffer perFrame : register(b0)
-{
-	float3 CameraPosition;
-}
-
-cbuffer lightBuffer : register(b1) {
-	DirectionalLight light;
-	DirectionalLight light2;
-};
 // Struct representing the data we expect to receive from earlier pipeline stages
 // - Should match the output of our corresponding vertex shader
 // - The name of the struct itself is unimportant
@@ -173,5 +159,33 @@ float4 main(VertexToPixel input) : SV_TARGET
 
 	totalColor += (balance * surfaceColor + spec) * 1.05f * light2.DiffuseColor + light2.AmbientColor;
 
+	//Point and spot lights - only the ones binned into this pixel's cluster
+	uint2 clusterRange = LightClusterRanges[GetLightCluster(input.position.xy, input.worldPos)];
+
+	[loop]
+	for (uint i = 0; i < clusterRange.y; i++)
+	{
+		LocalLight localLight = LocalLights[LightIndices[clusterRange.x + i]];
+
+		toLight = localLight.Position - input.worldPos;
+		float distance = length(toLight);
+		toLight /= max(distance, 0.0001f);
+
+		float attenuation = GetLocalLightAttenuation(localLight, toLight, distance);
+		NdotL = saturate(dot(input.normal, toLight));
+
+		//Same microfacet BRDF, with a proper half vector for each light
+		h = normalize(toCam + toLight);
+		NdotH = saturate(dot(input.normal, h));
+		denomToSquare = NdotH * NdotH * (a2 - 1) + 1;
+		SpecDis = a2 / (3.14159265359f * denomToSquare * denomToSquare);
+		Fres = specColor + (1 - specColor) * pow(1 - saturate(dot(toCam, h)), 5);
+		geoShad = geo1 * (NdotL / (NdotL * (1 - k) + k));
+		spec = (SpecDis * Fres * geoShad) / max(4 * NdotV * NdotL, 0.0001f);
+
+		balance = (1 - saturate(spec)) * (1 - metal);
+		totalColor += (balance * surfaceColor.rgb + spec) * NdotL * localLight.Color * attenuation;
+	}
+
 	return float4(totalColor, 1.0f);
 }
\ No newline at end of file
@@ -7,21 +7,21 @@ Player::Player(Mesh* meshPtr, ID3D11DeviceContext* context, Material* mat) : Ent
 
 }
 
-void Player::Update(float deltaTime, std::vector<Block*> blocks)
+void Player::Update(float deltaTime, std::vector<Block*> blocks, LatencyTracker& input)
 {
 	//Update positions with player input
-	if (GetAsyncKeyState('A') & 0x8000) 
+	if (input.IsKeyDown('A')) 
 	{
 		Move(XMFLOAT3(deltaTime * -speed,0,0),blocks);
 	}
-	if (GetAsyncKeyState('D') & 0x8000) 
+	if (input.IsKeyDown('D')) 
 	{
 		Move(XMFLOAT3(deltaTime * speed, 0, 0),blocks);
 	}
 
 	TestGrounded(blocks);
 
-	if (GetAsyncKeyState('W') & 0x8000 && grounded)
+	if (input.IsKeyDown('W') && grounded)
 	{
 		Jump();
 	}
@@ -41,6 +41,9 @@ void Player::Update(float deltaTime, std::vector<Block*> blocks)
 void Player::Move(DirectX::XMFLOAT3 movement, std::vector<Block*> blocks)
 {
 	grounded = false;
+
+	// Work on a copy and store it once at the end
+	XMFLOAT3 position = GetPosition();
 	XMFLOAT3 hypPos = XMFLOAT3(position);
 
 	position.x += movement.x;
@@ -90,11 +93,16 @@ void Player::Move(DirectX::XMFLOAT3 movement, std::vector<Block*> blocks)
 	{
 		grounded = true;
 	}
+
+	// Only store it if it changed, so standing still doesn't
+	// mark the transform dirty every tick
+	if (position.x != hypPos.x || position.y != hypPos.y || position.z != hypPos.z)
+		SetPosition(position);
 }
 
 void Player::TestGrounded(std::vector<Block*> blocks)
 {
-	if (position.y == -9) 
+	if (GetPosition().y == -9) 
 	{
 		grounded = true;
 		return;
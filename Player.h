@@ -1,6 +1,7 @@
 #pragma once
 #include "Entity.h"
 #include "Block.h"
+#include "LatencyTracker.h"
 class Player :
 	public Entity
 {
@@ -8,7 +9,8 @@ class Player :
 public:
 
 	Player(Mesh* meshPtr, ID3D11DeviceContext* context, Material* mat);
-	void Update(float, std::vector<Block*>);
+	// Keys come from the tracker, as of the start of the tick
+	void Update(float, std::vector<Block*>, LatencyTracker& input);
 
 	void Move(DirectX::XMFLOAT3 movement, std::vector<Block*> blocks);
 
@@ -0,0 +1,176 @@
+#include "Profiler.h"
+
+#include <fstream>
+#include <functional>
+#include <thread>
+#include <stdio.h>
+#include <string.h>
+
+std::atomic<bool> Profiler::capturing(false);
+std::atomic<unsigned int> Profiler::generation(0);
+std::atomic<long long> Profiler::captureStart(0);
+Profiler::BufferList Profiler::buffers;
+thread_local Profiler::ThreadBuffer* Profiler::threadBuffer = 0;
+
+Profiler::BufferList::~BufferList()
+{
+	for (size_t i = 0; i < Buffers.size(); i++)
+		delete Buffers[i];
+}
+
+Profiler::ThreadBuffer* Profiler::GetThreadBuffer()
+{
+	if (threadBuffer)
+		return threadBuffer;
+
+	ThreadBuffer* buffer = new ThreadBuffer();
+#ifdef _WIN32
+	buffer->ThreadId = GetCurrentThreadId();
+#else
+	buffer->ThreadId = (unsigned long)std::hash<std::thread::id>()(std::this_thread::get_id());
+#endif
+	snprintf(buffer->Name, sizeof(buffer->Name), "Thread %lu", (unsigned long)buffer->ThreadId);
+	buffer->Generation = generation.load();
+	buffer->Count = 0;
+	buffer->Dropped = 0;
+
+	std::lock_guard<std::mutex> lock(buffers.Lock);
+	buffers.Buffers.push_back(buffer);
+	threadBuffer = buffer;
+	return buffer;
+}
+
+void Profiler::SetThreadName(const char* name)
+{
+	ThreadBuffer* buffer = GetThreadBuffer();
+	snprintf(buffer->Name, sizeof(buffer->Name), "%s", name);
+}
+
+// --------------------------------------------------------
+// Threads notice the new generation the next time they
+// record, and empty their own buffers then - nobody else
+// ever writes to them
+// --------------------------------------------------------
+void Profiler::BeginCapture()
+{
+	// Stored before the generation changes, so a thread that
+	// sees the new generation sees the new start too
+	captureStart.store(Now(), std::memory_order_relaxed);
+	generation.fetch_add(1, std::memory_order_release);
+	capturing = true;
+}
+
+void Profiler::Record(const char* name, long long start, long long end)
+{
+	ThreadBuffer* buffer = GetThreadBuffer();
+
+	unsigned int current = generation.load(std::memory_order_acquire);
+	if (buffer->Generation.load(std::memory_order_relaxed) != current)
+	{
+		buffer->Count.store(0, std::memory_order_relaxed);
+		buffer->Dropped.store(0, std::memory_order_relaxed);
+		buffer->Generation.store(current, std::memory_order_release);
+	}
+
+	// Only allocated once the thread has something to record
+	if (buffer->Events.empty())
+		buffer->Events.resize(EventsPerThread);
+
+	unsigned int index = buffer->Count.load(std::memory_order_relaxed);
+	if (index >= EventsPerThread)
+	{
+		buffer->Dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	// Scopes already open when the capture began are cut off
+	// at its start, so nothing lands before zero in the trace
+	long long begin = captureStart.load(std::memory_order_relaxed);
+	if (start < begin)
+		start = begin;
+	if (end < start)
+		end = start;
+
+	ProfileEvent& e = buffer->Events[index];
+	e.Name = name;
+	e.Start = start;
+	e.End = end;
+	buffer->Count.store(index + 1, std::memory_order_release);
+}
+
+// --------------------------------------------------------
+// Chrome wants JSON strings, so quotes and backslashes in
+// names (unlikely, but __FUNCTION__ can be odd) get escaped
+// --------------------------------------------------------
+static void WriteEscaped(std::ofstream& out, const char* string)
+{
+	for (const char* c = string; *c; c++)
+	{
+		if (*c == '"' || *c == '\\')
+			out << '\\';
+		out << *c;
+	}
+}
+
+// --------------------------------------------------------
+// Stops recording and writes every event from this capture
+// as a complete ("X") event, with times in microseconds
+// from the start of the capture
+// --------------------------------------------------------
+bool Profiler::EndCapture(const char* filename)
+{
+	capturing = false;
+
+	std::ofstream out(filename, std::ios::out | std::ios::trunc);
+	if (!out.is_open())
+		return false;
+
+	double perfCounterUs = 1000000.0 / (double)Frequency();
+	long long start = captureStart.load(std::memory_order_relaxed);
+
+	unsigned int current = generation.load();
+	unsigned int events = 0;
+	unsigned int dropped = 0;
+	bool first = true;
+	char line[256];
+
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+	std::lock_guard<std::mutex> lock(buffers.Lock);
+	for (size_t b = 0; b < buffers.Buffers.size(); b++)
+	{
+		ThreadBuffer* buffer = buffers.Buffers[b];
+
+		// Thread names come through as metadata events
+		out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->ThreadId << ",\"args\":{\"name\":\"";
+		WriteEscaped(out, buffer->Name);
+		out << "\"}}";
+		first = false;
+
+		if (buffer->Generation.load(std::memory_order_acquire) != current)
+			continue;
+
+		unsigned int count = buffer->Count.load(std::memory_order_acquire);
+		for (unsigned int i = 0; i < count; i++)
+		{
+			const ProfileEvent& e = buffer->Events[i];
+			out << ",\n{\"name\":\"";
+			WriteEscaped(out, e.Name);
+			snprintf(line, sizeof(line), "\",\"ph\":\"X\",\"pid\":1,\"tid\":%lu,\"ts\":%.3f,\"dur\":%.3f}",
+				(unsigned long)buffer->ThreadId,
+				(e.Start - start) * perfCounterUs,
+				(e.End - e.Start) * perfCounterUs);
+			out << line;
+		}
+
+		events += count;
+		dropped += buffer->Dropped.load(std::memory_order_relaxed);
+	}
+
+	out << "\n]}\n";
+
+#if defined(DEBUG) || defined(_DEBUG)
+	printf("Profiler: wrote %u events to %s (%u dropped)\n", events, filename, dropped);
+#endif
+	return true;
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <chrono>
+#endif
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+// Profiling is compiled in for debug builds.  Define
+// PROFILER_ENABLED as 1 in the project settings to keep it
+// in release, or 0 to take it out of debug.
+#ifndef PROFILER_ENABLED
+#if defined(DEBUG) || defined(_DEBUG)
+#define PROFILER_ENABLED 1
+#else
+#define PROFILER_ENABLED 0
+#endif
+#endif
+
+// --------------------------------------------------------
+// One timed scope.  Names must outlive the capture (string
+// literals or __FUNCTION__).
+// --------------------------------------------------------
+struct ProfileEvent
+{
+	const char* Name;
+	long long Start;
+	long long End;
+};
+
+// --------------------------------------------------------
+// Records timed scopes from any thread and writes them out
+// in Chrome's trace event format (chrome://tracing, or
+// ui.perfetto.dev).
+//
+// Each thread appends to a buffer of its own, so recording
+// takes no locks; the buffer's count is only published
+// once an event is fully written, which lets EndCapture()
+// read from the main thread while the others carry on.
+// A full buffer drops events until the next capture.
+//
+// Nothing is recorded outside a capture, so scopes cost one
+// atomic load when the profiler is idle.
+// --------------------------------------------------------
+class Profiler
+{
+public:
+	static const unsigned int EventsPerThread = 1 << 17;
+
+	// Shows up as the thread's name in the trace
+	static void SetThreadName(const char* name);
+
+	static void BeginCapture();
+	static bool EndCapture(const char* filename);
+	static bool IsCapturing() { return capturing.load(std::memory_order_relaxed); }
+
+	static void Record(const char* name, long long start, long long end);
+
+	// Ticks of the performance counter (steady_clock off
+	// Windows, so the job system still builds there)
+	static long long Now()
+	{
+#ifdef _WIN32
+		long long now;
+		QueryPerformanceCounter((LARGE_INTEGER*)&now);
+		return now;
+#else
+		return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+	}
+
+	static long long Frequency()
+	{
+#ifdef _WIN32
+		long long frequency;
+		QueryPerformanceFrequency((LARGE_INTEGER*)&frequency);
+		return frequency;
+#else
+		return std::chrono::steady_clock::period::den / std::chrono::steady_clock::period::num;
+#endif
+	}
+
+private:
+	struct ThreadBuffer
+	{
+		unsigned long ThreadId;
+		char Name[32];
+		std::atomic<unsigned int> Generation;	// Capture the events belong to
+		std::atomic<unsigned int> Count;
+		std::atomic<unsigned int> Dropped;
+		std::vector<ProfileEvent> Events;
+	};
+
+	// Every thread's buffer, kept until the program exits so
+	// threads that have finished still show up in the trace
+	struct BufferList
+	{
+		std::mutex Lock;
+		std::vector<ThreadBuffer*> Buffers;
+		~BufferList();
+	};
+
+	static BufferList buffers;
+	static thread_local ThreadBuffer* threadBuffer;
+
+	static std::atomic<bool> capturing;
+	static std::atomic<unsigned int> generation;
+	static std::atomic<long long> captureStart;	// Published by generation
+
+	static ThreadBuffer* GetThreadBuffer();
+};
+
+// --------------------------------------------------------
+// Times from construction to destruction
+// --------------------------------------------------------
+class ProfileScope
+{
+public:
+	ProfileScope(const char* name)
+	{
+		this->name = name;
+		start = Profiler::IsCapturing() ? Profiler::Now() : 0;
+	}
+
+	~ProfileScope()
+	{
+		if (start)
+			Profiler::Record(name, start, Profiler::Now());
+	}
+
+private:
+	const char* name;
+	long long start;
+};
+
+#if PROFILER_ENABLED
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_SCOPE(__FUNCTION__)
+#define PROFILE_THREAD_NAME(name) Profiler::SetThreadName(name)
+#else
+#define PROFILE_SCOPE(name)
+#define PROFILE_FUNCTION()
+#define PROFILE_THREAD_NAME(name)
+#endif
@@ -1,8 +1,4 @@
-cbuffer externalData : register(b0)
-{
-	matrix view;
-	float3 CameraPosition;
-};
+#include "FrameConstants.hlsli"
 
 struct VertexToPixel
 {
@@ -1,8 +1,8 @@
-cbuffer externalData : register(b0)
+#include "FrameConstants.hlsli"
+
+cbuffer perObject : register(b1)
 {
 	matrix world;
-	matrix view;
-	matrix projection;
 };
 
 struct VertexShaderInput 
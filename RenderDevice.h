@@ -0,0 +1,74 @@
+#pragma once
+
+#include "CommandBuffer.h"
+
+enum RenderBufferType
+{
+	RENDER_BUFFER_VERTEX,
+	RENDER_BUFFER_INDEX,
+	RENDER_BUFFER_CONSTANT,
+};
+
+struct RenderBufferDesc
+{
+	RenderBufferType Type;
+	unsigned int Size;
+	bool Dynamic;		// Rewritten often (otherwise set once)
+};
+
+// --------------------------------------------------------
+// What a device has been asked to do since the last reset,
+// plus what it's holding on to right now
+// --------------------------------------------------------
+struct RenderDeviceStats
+{
+	unsigned int CommandBuffers;
+	unsigned int Commands;
+	unsigned int Draws;
+	unsigned int Binds;		// Pipeline, buffer, texture, sampler and constant binds
+	unsigned long long UploadedBytes;	// Constants and buffer updates
+
+	// Live resources (not reset)
+	unsigned int Buffers;
+	unsigned long long ResourceBytes;
+};
+
+// --------------------------------------------------------
+// The parts of a graphics API the renderer needs each
+// frame: making and filling the buffers it rewrites (the
+// instance data, the stats overlay) and playing back
+// command buffers.  Handles are whatever the backend wants
+// them to be.
+//
+// D3D11RenderDevice draws for real.  NullRenderDevice
+// accepts everything and only keeps count, so the cost of
+// building and recording a frame can be measured without
+// drawing it.  Meshes, shaders and textures are still made
+// on the ID3D11Device at load time, so a device is needed
+// either way.
+// --------------------------------------------------------
+class RenderDevice
+{
+public:
+	virtual ~RenderDevice() { }
+
+	// data (optional) is the initial contents
+	virtual CommandHandle CreateBuffer(const RenderBufferDesc& desc, const void* data) = 0;
+	virtual void UpdateBuffer(CommandHandle buffer, const void* data, unsigned int size) = 0;
+	virtual void DestroyBuffer(CommandHandle buffer) = 0;
+
+	virtual void Execute(const CommandBuffer& commands) = 0;
+
+	const RenderDeviceStats& GetStats() { return stats; }
+	void ResetStats()
+	{
+		stats.CommandBuffers = 0;
+		stats.Commands = 0;
+		stats.Draws = 0;
+		stats.Binds = 0;
+		stats.UploadedBytes = 0;
+	}
+
+protected:
+	RenderDeviceStats stats = {};
+};
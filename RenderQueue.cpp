@@ -0,0 +1,190 @@
+#include "RenderQueue.h"
+#include "Material.h"
+#include "Mesh.h"
+#include <string.h>
+
+using namespace DirectX;
+
+RenderQueue::RenderQueue()
+{
+	stats = {};
+	for (unsigned int i = 0; i <= RENDER_PASS_COUNT; i++)
+		passStart[i] = 0;
+}
+
+void RenderQueue::Clear()
+{
+	entries.clear();
+	order.clear();
+}
+
+// --------------------------------------------------------
+// Small, stable id for a pointer.  Tables only ever hold a
+// handful of things, so a linear search is plenty.
+// --------------------------------------------------------
+unsigned int RenderQueue::GetId(std::vector<const void*>& table, const void* ptr)
+{
+	for (unsigned int i = 0; i < table.size(); i++)
+	{
+		if (table[i] == ptr)
+			return i;
+	}
+
+	// Out of bits - share the last id rather than corrupt the key
+	if (table.size() == MaxIds)
+		return MaxIds - 1;
+
+	table.push_back(ptr);
+	return (unsigned int)table.size() - 1;
+}
+
+// --------------------------------------------------------
+// Materials that use the same vertex/pixel shader pair
+// get the same shader id
+// --------------------------------------------------------
+unsigned int RenderQueue::GetShaderId(Material* material)
+{
+	const void* vs = material->GetInstancedVertexShader() ?
+		(const void*)material->GetInstancedVertexShader() :
+		(const void*)material->GetVertexShader();
+	const void* ps = material->GetPixelShader();
+
+	for (unsigned int i = 0; i < shaderVS.size(); i++)
+	{
+		if (shaderVS[i] == vs && shaderPS[i] == ps)
+			return i;
+	}
+
+	if (shaderVS.size() == MaxIds)
+		return MaxIds - 1;
+
+	shaderVS.push_back(vs);
+	shaderPS.push_back(ps);
+	return (unsigned int)shaderVS.size() - 1;
+}
+
+// --------------------------------------------------------
+// Builds the key and adds an entry.  Depth is any positive
+// distance from the camera - only its ordering matters.
+// --------------------------------------------------------
+void RenderQueue::Add(RenderPass pass, Material* material, Mesh* mesh, const XMFLOAT4X4& world, float depth, unsigned int item)
+{
+	// Positive floats sort the same as their bit patterns
+	if (depth < 0.0f)
+		depth = 0.0f;
+	unsigned int depthBits;
+	memcpy(&depthBits, &depth, sizeof(float));
+
+	// Refraction is drawn over the scene, so go back-to-front
+	if (pass == RENDER_PASS_REFRACT)
+		depthBits = ~depthBits;
+
+	unsigned long long key =
+		((unsigned long long)pass << 62) |
+		((unsigned long long)GetShaderId(material) << 52) |
+		((unsigned long long)GetId(materials, material) << 42) |
+		((unsigned long long)GetId(meshes, mesh) << 32) |
+		(unsigned long long)depthBits;
+
+	RenderQueueEntry entry;
+	entry.Key = key;
+	entry.Item = item;
+	entry.material = material;
+	entry.mesh = mesh;
+	entry.World = world;
+
+	SortKey sortKey;
+	sortKey.Key = key;
+	sortKey.Entry = (unsigned int)entries.size();
+
+	entries.push_back(entry);
+	order.push_back(sortKey);
+}
+
+// --------------------------------------------------------
+// LSD radix sort, a byte at a time.  Bytes that are the
+// same for every key (most of the high ones, usually) are
+// skipped without moving anything.
+// --------------------------------------------------------
+void RenderQueue::Sort()
+{
+	// Counted in insertion order first, for comparison
+	CountStateChanges(stats.UnsortedShaderChanges, stats.UnsortedMaterialChanges, stats.UnsortedMeshChanges);
+
+	unsigned int count = (unsigned int)order.size();
+	scratch.resize(count);
+
+	for (unsigned int shift = 0; shift < 64 && count > 1; shift += 8)
+	{
+		unsigned int histogram[256] = {};
+		for (unsigned int i = 0; i < count; i++)
+			histogram[(order[i].Key >> shift) & 0xFF]++;
+
+		// All in one bucket?  Then this byte is already sorted.
+		if (histogram[(order[0].Key >> shift) & 0xFF] == count)
+			continue;
+
+		unsigned int offset = 0;
+		for (unsigned int b = 0; b < 256; b++)
+		{
+			unsigned int bucketSize = histogram[b];
+			histogram[b] = offset;
+			offset += bucketSize;
+		}
+
+		for (unsigned int i = 0; i < count; i++)
+			scratch[histogram[(order[i].Key >> shift) & 0xFF]++] = order[i];
+
+		order.swap(scratch);
+	}
+
+	// Find where each pass starts
+	unsigned int index = 0;
+	for (unsigned int p = 0; p < RENDER_PASS_COUNT; p++)
+	{
+		passStart[p] = index;
+		while (index < count && (order[index].Key >> 62) == p)
+			index++;
+	}
+	passStart[RENDER_PASS_COUNT] = count;
+
+	stats.Entries = count;
+	CountStateChanges(stats.ShaderChanges, stats.MaterialChanges, stats.MeshChanges);
+}
+
+void RenderQueue::GetPassRange(RenderPass pass, unsigned int& begin, unsigned int& end)
+{
+	begin = passStart[pass];
+	end = passStart[pass + 1];
+}
+
+// --------------------------------------------------------
+// Counts how often each part of the state differs from the
+// previous entry, walking the entries in the current order
+// --------------------------------------------------------
+void RenderQueue::CountStateChanges(unsigned int& shaderChanges, unsigned int& materialChanges, unsigned int& meshChanges)
+{
+	const unsigned long long idMask = MaxIds - 1;
+	const unsigned long long shaderMask = (0x3ull << 62) | (idMask << 52);	// Pass + shader
+	const unsigned long long materialMask = idMask << 42;
+	const unsigned long long meshMask = idMask << 32;
+
+	shaderChanges = 0;
+	materialChanges = 0;
+	meshChanges = 0;
+
+	for (unsigned int i = 0; i < order.size(); i++)
+	{
+		unsigned long long key = order[i].Key;
+		if (i == 0)
+		{
+			shaderChanges = materialChanges = meshChanges = 1;
+			continue;
+		}
+
+		unsigned long long prev = order[i - 1].Key;
+		if ((key & shaderMask) != (prev & shaderMask)) shaderChanges++;
+		if ((key & materialMask) != (prev & materialMask)) materialChanges++;
+		if ((key & meshMask) != (prev & meshMask)) meshChanges++;
+	}
+}
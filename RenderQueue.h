@@ -0,0 +1,111 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+class Mesh;
+class Material;
+
+// --------------------------------------------------------
+// Passes, in the order they're drawn.  The pass is the top
+// of the sort key, so each pass ends up contiguous.
+// --------------------------------------------------------
+enum RenderPass
+{
+	RENDER_PASS_OPAQUE = 0,
+	RENDER_PASS_REFRACT = 1,
+	RENDER_PASS_COUNT
+};
+
+// --------------------------------------------------------
+// One visible thing to draw.  Item is whatever index the
+// caller wants back (a render snapshot item, for us).
+// --------------------------------------------------------
+struct RenderQueueEntry
+{
+	unsigned long long Key;
+	unsigned int Item;
+	Material* material;
+	Mesh* mesh;
+	DirectX::XMFLOAT4X4 World;
+};
+
+// --------------------------------------------------------
+// Per-frame counts of how often the shader, material and
+// mesh change between consecutive entries.  The unsorted
+// counts are for the order the entries were added in, to
+// show what the sort is buying us.
+// --------------------------------------------------------
+struct RenderQueueStats
+{
+	unsigned int Entries;
+	unsigned int ShaderChanges;
+	unsigned int MaterialChanges;
+	unsigned int MeshChanges;
+	unsigned int UnsortedShaderChanges;
+	unsigned int UnsortedMaterialChanges;
+	unsigned int UnsortedMeshChanges;
+};
+
+// --------------------------------------------------------
+// Flat list of everything to draw this frame, ordered by a
+// 64-bit key:
+//
+//   63-62  pass
+//   61-52  shader (vertex + pixel pair)
+//   51-42  material
+//   41-32  mesh
+//   31-0   depth (front-to-back, or back-to-front for
+//          passes that blend)
+//
+// so state changes are grouped and opaque things are drawn
+// nearest first.  Sorted with an LSD radix sort.
+// --------------------------------------------------------
+class RenderQueue
+{
+public:
+	RenderQueue();
+
+	void Clear();
+	void Add(RenderPass pass, Material* material, Mesh* mesh, const DirectX::XMFLOAT4X4& world, float depth, unsigned int item);
+	void Sort();
+
+	// Entries in sorted order (after Sort)
+	unsigned int GetCount() { return (unsigned int)entries.size(); }
+	const RenderQueueEntry& Get(unsigned int index) { return entries[order[index].Entry]; }
+
+	// Range of sorted entries [begin, end) for one pass
+	void GetPassRange(RenderPass pass, unsigned int& begin, unsigned int& end);
+
+	const RenderQueueStats& GetStats() { return stats; }
+
+private:
+	static const unsigned int IdBits = 10;
+	static const unsigned int MaxIds = 1 << IdBits;
+
+	// Only the small key/index pairs get shuffled around by
+	// the sort - the entries themselves stay put
+	struct SortKey
+	{
+		unsigned long long Key;
+		unsigned int Entry;
+	};
+
+	std::vector<RenderQueueEntry> entries;
+	std::vector<SortKey> order;
+	std::vector<SortKey> scratch;
+
+	// Pointer -> small id tables, kept between frames so
+	// ids (and therefore the draw order) stay stable
+	std::vector<const void*> shaderVS;
+	std::vector<const void*> shaderPS;
+	std::vector<const void*> materials;
+	std::vector<const void*> meshes;
+
+	unsigned int passStart[RENDER_PASS_COUNT + 1];
+	RenderQueueStats stats;
+
+	unsigned int GetShaderId(Material* material);
+	unsigned int GetId(std::vector<const void*>& table, const void* ptr);
+	void CountStateChanges(unsigned int& shaderChanges, unsigned int& materialChanges, unsigned int& meshChanges);
+};
@@ -0,0 +1,42 @@
+#include "RenderSnapshot.h"
+#include "Entity.h"
+#include "Camera.h"
+
+using namespace DirectX;
+
+XMFLOAT4X4 RenderItem::GetInterpolatedWorld(float alpha) const
+{
+	// Most things don't move on any given tick
+	if (!moved)
+		return world;
+
+	XMFLOAT3 pos, rot, scl;
+	XMStoreFloat3(&pos, XMVectorLerp(XMLoadFloat3(&prevPosition), XMLoadFloat3(&position), alpha));
+	XMStoreFloat3(&rot, XMVectorLerp(XMLoadFloat3(&prevRotation), XMLoadFloat3(&rotation), alpha));
+	XMStoreFloat3(&scl, XMVectorLerp(XMLoadFloat3(&prevScale), XMLoadFloat3(&scale), alpha));
+
+	return Entity::BuildWorldMatrix(pos, rot, scl);
+}
+
+float RenderSnapshot::GetAlpha(float renderTime) const
+{
+	if (tickInterval <= 0.0f)
+		return 1.0f;
+
+	float alpha = (renderTime - publishTime) / tickInterval;
+	return max(0.0f, min(alpha, 1.0f));
+}
+
+XMFLOAT3 RenderSnapshot::GetCameraPosition(float alpha) const
+{
+	XMFLOAT3 pos;
+	XMStoreFloat3(&pos, XMVectorLerp(XMLoadFloat3(&prevCameraPosition), XMLoadFloat3(&cameraPosition), alpha));
+	return pos;
+}
+
+XMFLOAT4X4 RenderSnapshot::GetView(float alpha) const
+{
+	float xRot = prevCameraRotation.x + (cameraRotation.x - prevCameraRotation.x) * alpha;
+	float yRot = prevCameraRotation.y + (cameraRotation.y - prevCameraRotation.y) * alpha;
+	return Camera::BuildViewMatrix(GetCameraPosition(alpha), xRot, yRot);
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+#include "Lights.h"
+
+class Entity;
+
+// --------------------------------------------------------
+// Everything the renderer needs to know about one entity
+// for one sim tick.  The entity pointer is only used for
+// its mesh and material, which never change after creation.
+//
+// Both the start- and end-of-tick transforms are kept so
+// the renderer can blend between them.
+// --------------------------------------------------------
+struct RenderItem
+{
+	Entity* entity;
+	DirectX::XMFLOAT4X4 world;	// End of tick, already built
+	bool visible;
+	bool moved;					// Did the transform change this tick?
+
+	DirectX::XMFLOAT3 prevPosition;
+	DirectX::XMFLOAT3 prevRotation;
+	DirectX::XMFLOAT3 prevScale;
+	DirectX::XMFLOAT3 position;
+	DirectX::XMFLOAT3 rotation;
+	DirectX::XMFLOAT3 scale;
+
+	// World matrix blended between the two tick states
+	// (alpha 0 = start of tick, 1 = end of tick)
+	DirectX::XMFLOAT4X4 GetInterpolatedWorld(float alpha) const;
+};
+
+// --------------------------------------------------------
+// Immutable copy of the sim state, published once per tick
+// and consumed by Draw on the render thread
+// --------------------------------------------------------
+struct RenderSnapshot
+{
+	unsigned long long tick = 0;
+
+	// When the tick was published and how far apart ticks are,
+	// on the same clock as Draw's totalTime
+	float publishTime = 0.0f;
+	float tickInterval = 0.0f;
+
+	DirectX::XMFLOAT3 prevCameraPosition;
+	DirectX::XMFLOAT3 cameraPosition;
+	DirectX::XMFLOAT2 prevCameraRotation;
+	DirectX::XMFLOAT2 cameraRotation;
+
+	std::vector<RenderItem> items;
+
+	// Point and spot lights at the end of the tick
+	std::vector<LocalLight> lights;
+
+	// How far (0-1) a frame drawn at renderTime is between
+	// the start and end of this tick
+	float GetAlpha(float renderTime) const;
+
+	DirectX::XMFLOAT3 GetCameraPosition(float alpha) const;
+	DirectX::XMFLOAT4X4 GetView(float alpha) const;
+};
@@ -0,0 +1,111 @@
+#include "ScreenTiles.h"
+
+ScreenTileMask::ScreenTileMask(unsigned int tileSize)
+{
+	this->tileSize = tileSize;
+	width = 0;
+	height = 0;
+	tilesX = 0;
+	tilesY = 0;
+}
+
+void ScreenTileMask::Resize(unsigned int width, unsigned int height)
+{
+	this->width = width;
+	this->height = height;
+	tilesX = (width + tileSize - 1) / tileSize;
+	tilesY = (height + tileSize - 1) / tileSize;
+	tiles.assign(tilesX * tilesY, 0);
+}
+
+void ScreenTileMask::Clear()
+{
+	tiles.assign(tiles.size(), 0);
+}
+
+void ScreenTileMask::Add(const ScreenTileMask& other)
+{
+	for (size_t i = 0; i < tiles.size() && i < other.tiles.size(); i++)
+		tiles[i] |= other.tiles[i];
+}
+
+void ScreenTileMask::Subtract(const ScreenTileMask& other)
+{
+	for (size_t i = 0; i < tiles.size() && i < other.tiles.size(); i++)
+		tiles[i] &= ~other.tiles[i];
+}
+
+void ScreenTileMask::AddRect(const ScreenRect& rect)
+{
+	int left = rect.Left < 0 ? 0 : rect.Left;
+	int top = rect.Top < 0 ? 0 : rect.Top;
+	int right = rect.Right > (int)width ? (int)width : rect.Right;
+	int bottom = rect.Bottom > (int)height ? (int)height : rect.Bottom;
+	if (left >= right || top >= bottom)
+		return;
+
+	unsigned int x0 = left / tileSize;
+	unsigned int y0 = top / tileSize;
+	unsigned int x1 = (right - 1) / tileSize;
+	unsigned int y1 = (bottom - 1) / tileSize;
+
+	for (unsigned int y = y0; y <= y1; y++)
+	{
+		for (unsigned int x = x0; x <= x1; x++)
+			tiles[y * tilesX + x] = 1;
+	}
+}
+
+void ScreenTileMask::GetRects(std::vector<ScreenRect>& rects)
+{
+	rects.clear();
+
+	for (unsigned int y = 0; y < tilesY; y++)
+	{
+		const unsigned char* row = &tiles[y * tilesX];
+
+		unsigned int x = 0;
+		while (x < tilesX)
+		{
+			if (!row[x])
+			{
+				x++;
+				continue;
+			}
+
+			unsigned int start = x;
+			while (x < tilesX && row[x])
+				x++;
+
+			ScreenRect run;
+			run.Left = start * tileSize;
+			run.Right = x * tileSize > width ? (int)width : (int)(x * tileSize);
+			run.Top = y * tileSize;
+			run.Bottom = (y + 1) * tileSize > height ? (int)height : (int)((y + 1) * tileSize);
+
+			// Same span as a rect that reached the row above?
+			bool merged = false;
+			for (size_t i = 0; i < rects.size(); i++)
+			{
+				ScreenRect& open = rects[i];
+				if (open.Left == run.Left && open.Right == run.Right && open.Bottom == run.Top)
+				{
+					open.Bottom = run.Bottom;
+					merged = true;
+					break;
+				}
+			}
+
+			if (!merged)
+				rects.push_back(run);
+		}
+	}
+}
+
+unsigned int ScreenTileMask::GetMarkedCount()
+{
+	unsigned int count = 0;
+	for (size_t i = 0; i < tiles.size(); i++)
+		count += tiles[i];
+	return count;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+
+// --------------------------------------------------------
+// A rectangle of pixels.  Right and bottom are exclusive.
+// --------------------------------------------------------
+struct ScreenRect
+{
+	int Left;
+	int Top;
+	int Right;
+	int Bottom;
+};
+
+// --------------------------------------------------------
+// The screen cut into square tiles, each either marked or
+// not.  Rectangles are snapped out to whole tiles, so lots
+// of small overlapping ones (a block and its neighbours)
+// collapse into a few big ones.
+// --------------------------------------------------------
+class ScreenTileMask
+{
+public:
+	ScreenTileMask(unsigned int tileSize = 32);
+
+	void Resize(unsigned int width, unsigned int height);
+	void Clear();
+
+	// Tile by tile OR and AND NOT with a mask of the same size
+	void Add(const ScreenTileMask& other);
+	void Subtract(const ScreenTileMask& other);
+
+	// Marks every tile the rectangle touches (clipped to the screen)
+	void AddRect(const ScreenRect& rect);
+
+	// The marked tiles as rectangles: runs along each row,
+	// with runs of the same span on following rows merged in.
+	// Clipped to the screen.
+	void GetRects(std::vector<ScreenRect>& rects);
+
+	unsigned int GetMarkedCount();
+	unsigned int GetTileCount() { return (unsigned int)tiles.size(); }
+
+private:
+	unsigned int tileSize;
+	unsigned int width;
+	unsigned int height;
+	unsigned int tilesX;
+	unsigned int tilesY;
+	std::vector<unsigned char> tiles;
+};
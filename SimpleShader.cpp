@@ -1,4 +1,8 @@
 #include "SimpleShader.h"
+#include "Profiler.h"
+#include "ConstantRingBuffer.h"
+
+SimpleShaderUploadStats ISimpleShader::uploadStats = {};
 
 ///////////////////////////////////////////////////////////////////////////////
 // ------ BASE SIMPLE SHADER --------------------------------------------------
@@ -13,6 +17,20 @@ ISimpleShader::ISimpleShader(ID3D11Device* device, ID3D11DeviceContext* context)
 	this->device = device;
 	this->deviceContext = context;
 
+	// Binds go through the context's cache so repeats are dropped
+	this->stateCache = StateCache::Get(context);
+
+	// Only changed parts of a buffer get uploaded, if the
+	// driver lets us update part of a constant buffer
+	this->deviceContext1 = 0;
+	this->ringBuffer = 0;
+	D3D11_FEATURE_DATA_D3D11_OPTIONS options = {};
+	if (SUCCEEDED(device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options))) &&
+		options.ConstantBufferPartialUpdate)
+	{
+		context->QueryInterface(__uuidof(ID3D11DeviceContext1), (void**)&deviceContext1);
+	}
+
 	// Set up fields
 	constantBufferCount = 0;
 	constantBuffers = 0;
@@ -28,6 +46,9 @@ ISimpleShader::~ISimpleShader()
 	// Derived class destructors will call this class's CleanUp method
 	if(shaderBlob)
 		shaderBlob->Release();
+
+	if (deviceContext1)
+		deviceContext1->Release();
 }
 
 // --------------------------------------------------------
@@ -74,12 +95,33 @@ void ISimpleShader::CleanUp()
 bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 {
 	// Load the shader to a blob and ensure it worked
-	HRESULT hr = D3DReadFileToBlob(shaderFile, &shaderBlob);
+	ID3DBlob* blob;
+	HRESULT hr = D3DReadFileToBlob(shaderFile, &blob);
 	if (hr != S_OK)
 	{
 		return false;
 	}
 
+	bool result = LoadShaderBlob(blob);
+	blob->Release();
+	return result;
+}
+
+// --------------------------------------------------------
+// Creates the shader from compiled code that has already
+// been read into memory (on a loader thread, for instance)
+// and builds the variable table using shader reflection.
+//
+// blob - The compiled shader.  The shader keeps its own
+//        reference, so the caller still releases theirs.
+//
+// Returns true if shader is loaded properly, false otherwise
+// --------------------------------------------------------
+bool ISimpleShader::LoadShaderBlob(ID3DBlob* blob)
+{
+	shaderBlob = blob;
+	shaderBlob->AddRef();
+
 	// Create the shader - Calls an overloaded version of this abstract
 	// method in the appropriate child class
 	shaderValid = CreateShader(shaderBlob);
@@ -181,6 +223,10 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 		constantBuffers[b].LocalDataBuffer = new unsigned char[bufferDesc.Size];
 		ZeroMemory(constantBuffers[b].LocalDataBuffer, bufferDesc.Size);
 
+		// The GPU copy hasn't been filled in yet
+		constantBuffers[b].DirtyStart = 0;
+		constantBuffers[b].DirtyEnd = bufferDesc.Size;
+
 		// Loop through all variables in this buffer
 		for (unsigned int v = 0; v < bufferDesc.Variables; v++)
 		{
@@ -277,16 +323,19 @@ void ISimpleShader::SetShader()
 // --------------------------------------------------------
 void ISimpleShader::CopyAllBufferData()
 {
+	PROFILE_FUNCTION();
+
 	// Ensure the shader is valid
 	if (!shaderValid) return;
 
 	// Loop through the constant buffers and copy all data
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
-		// Copy the entire local data buffer
-		deviceContext->UpdateSubresource(
-			constantBuffers[i].ConstantBuffer, 0, 0,
-			constantBuffers[i].LocalDataBuffer, 0, 0);
+		// Someone else keeps external buffers up to date
+		if (constantBuffers[i].External)
+			continue;
+
+		UploadBuffer(&constantBuffers[i]);
 	}
 }
 
@@ -312,12 +361,10 @@ void ISimpleShader::CopyBufferData(unsigned int index)
 
 	// Check for the buffer
 	SimpleConstantBuffer* cb = &this->constantBuffers[index];
-	if (!cb) return;
+	if (!cb || cb->External) return;
 
 	// Copy the data and get out
-	deviceContext->UpdateSubresource(
-		cb->ConstantBuffer, 0, 0, 
-		cb->LocalDataBuffer, 0, 0);
+	UploadBuffer(cb);
 }
 
 // --------------------------------------------------------
@@ -334,12 +381,136 @@ void ISimpleShader::CopyBufferData(std::string bufferName)
 
 	// Check for the buffer
 	SimpleConstantBuffer* cb = this->FindConstantBuffer(bufferName);
-	if (!cb) return;
+	if (!cb || cb->External) return;
 
 	// Copy the data and get out
-	deviceContext->UpdateSubresource(
-		cb->ConstantBuffer, 0, 0, 
-		cb->LocalDataBuffer, 0, 0);
+	UploadBuffer(cb);
+}
+
+// --------------------------------------------------------
+// Sends whatever changed in the local data buffer since the
+// last upload to the GPU.  Unchanged buffers aren't touched,
+// and if the driver supports partial updates only the dirty
+// range (rounded out to 16 bytes) is sent.
+// --------------------------------------------------------
+void ISimpleShader::UploadBuffer(SimpleConstantBuffer* cb)
+{
+	uploadStats.RequestedBytes += cb->Size;
+
+	// Ring buffer data has to be rewritten if the ring has
+	// started over since, even when nothing changed.  Each
+	// write lands somewhere new, so it's bound right away.
+	if (ringBuffer)
+	{
+		if (cb->DirtyEnd <= cb->DirtyStart && cb->RingGeneration == ringBuffer->GetGeneration())
+		{
+			uploadStats.Skipped++;
+			return;
+		}
+
+		if (!ringBuffer->Write(cb->LocalDataBuffer, cb->Size, cb->RingFirstConstant, cb->RingNumConstants))
+			return;
+
+		cb->RingGeneration = ringBuffer->GetGeneration();
+		cb->DirtyStart = cb->Size;
+		cb->DirtyEnd = 0;
+		uploadStats.Uploads++;
+		uploadStats.UploadedBytes += cb->Size;
+
+		BindConstantBuffer(cb);
+		return;
+	}
+
+	if (cb->DirtyEnd <= cb->DirtyStart)
+	{
+		uploadStats.Skipped++;
+		return;
+	}
+
+	unsigned int left = cb->DirtyStart & ~15u;
+	unsigned int right = (cb->DirtyEnd + 15) & ~15u;
+	if (right > cb->Size)
+		right = cb->Size;
+
+	if (deviceContext1 && (left > 0 || right < cb->Size))
+	{
+		D3D11_BOX box = { left, 0, 0, right, 1, 1 };
+		deviceContext1->UpdateSubresource1(
+			cb->ConstantBuffer, 0, &box,
+			cb->LocalDataBuffer + left, 0, 0, 0);
+		uploadStats.UploadedBytes += right - left;
+	}
+	else
+	{
+		deviceContext->UpdateSubresource(
+			cb->ConstantBuffer, 0, 0,
+			cb->LocalDataBuffer, 0, 0);
+		uploadStats.UploadedBytes += cb->Size;
+	}
+
+	uploadStats.Uploads++;
+	cb->DirtyStart = cb->Size;
+	cb->DirtyEnd = 0;
+}
+
+// --------------------------------------------------------
+// Binds one of this shader's constant buffers - either its
+// own buffer, or its latest piece of the ring buffer
+// --------------------------------------------------------
+void ISimpleShader::BindConstantBuffer(SimpleConstantBuffer* cb)
+{
+	if (ringBuffer && !cb->External && cb->RingGeneration != 0)
+	{
+		stateCache->SetConstantBuffer(GetStage(), cb->BindIndex,
+			ringBuffer->GetBuffer(), cb->RingFirstConstant, cb->RingNumConstants);
+	}
+	else
+	{
+		stateCache->SetConstantBuffer(GetStage(), cb->BindIndex, cb->ConstantBuffer);
+	}
+}
+
+void ISimpleShader::SetConstantRingBuffer(ConstantRingBuffer* ring)
+{
+	ringBuffer = ring;
+
+	// Whatever is in the old place doesn't count any more
+	for (unsigned int i = 0; i < constantBufferCount; i++)
+	{
+		constantBuffers[i].RingGeneration = 0;
+		constantBuffers[i].DirtyStart = 0;
+		constantBuffers[i].DirtyEnd = constantBuffers[i].Size;
+	}
+}
+
+void ISimpleShader::ResetUploadStats()
+{
+	uploadStats = {};
+}
+
+// --------------------------------------------------------
+// Replaces one of this shader's constant buffers with a
+// buffer owned by someone else.  The shader keeps binding
+// it in SetShader(), but the Copy methods skip it, so its
+// contents are entirely up to the owner.
+//
+// bufferName - The name of the cbuffer in the shader
+// buffer     - The replacement (must be at least as big)
+//
+// Returns false if the shader has no buffer by that name
+// --------------------------------------------------------
+bool ISimpleShader::SetExternalConstantBuffer(std::string bufferName, ID3D11Buffer* buffer)
+{
+	SimpleConstantBuffer* cb = this->FindConstantBuffer(bufferName);
+	if (!cb) return false;
+
+	// Swap out our own buffer.  Holding a reference keeps
+	// CleanUp() the same for both kinds of buffer.
+	buffer->AddRef();
+	cb->ConstantBuffer->Release();
+	cb->ConstantBuffer = buffer;
+	cb->External = true;
+	return true;
 }
 
 
@@ -361,15 +532,30 @@ bool ISimpleShader::SetData(std::string name, const void* data, unsigned int siz
 		return false;
 
 	// Set the data in the local data buffer
-	memcpy(
-		constantBuffers[var->ConstantBufferIndex].LocalDataBuffer + var->ByteOffset,
-		data,
-		size);
+	WriteVariable(&constantBuffers[var->ConstantBufferIndex], var->ByteOffset, data, size);
 
 	// Success
 	return true;
 }
 
+// --------------------------------------------------------
+// Copies data into a local data buffer, but only if it
+// differs from what's there, and marks what changed
+// --------------------------------------------------------
+void ISimpleShader::WriteVariable(SimpleConstantBuffer* cb, unsigned int byteOffset, const void* data, unsigned int size)
+{
+	unsigned char* dest = cb->LocalDataBuffer + byteOffset;
+	if (memcmp(dest, data, size) == 0)
+		return;
+
+	memcpy(dest, data, size);
+
+	if (byteOffset < cb->DirtyStart)
+		cb->DirtyStart = byteOffset;
+	if (byteOffset + size > cb->DirtyEnd)
+		cb->DirtyEnd = byteOffset + size;
+}
+
 // --------------------------------------------------------
 // Sets INTEGER data
 // --------------------------------------------------------
@@ -450,6 +636,118 @@ bool ISimpleShader::SetMatrix4x4(std::string name, const DirectX::XMFLOAT4X4 dat
 	return this->SetData(name, &data, sizeof(float) * 16);
 }
 
+// --------------------------------------------------------
+// Looks up a variable once, so it can be set later without
+// the name.  Check IsValid() on the result.
+// --------------------------------------------------------
+SimpleVariableHandle ISimpleShader::GetVariableHandle(std::string name)
+{
+	SimpleVariableHandle handle;
+	SimpleShaderVariable* var = FindVariable(name, -1);
+	if (var)
+	{
+		handle.ConstantBufferIndex = var->ConstantBufferIndex;
+		handle.ByteOffset = var->ByteOffset;
+		handle.Size = var->Size;
+	}
+	return handle;
+}
+
+// --------------------------------------------------------
+// Looks up an SRV's register once
+// --------------------------------------------------------
+SimpleSRVHandle ISimpleShader::GetShaderResourceViewHandle(std::string name)
+{
+	SimpleSRVHandle handle;
+	const SimpleSRV* srvInfo = GetShaderResourceViewInfo(name);
+	if (srvInfo)
+		handle.BindIndex = srvInfo->BindIndex;
+	return handle;
+}
+
+// --------------------------------------------------------
+// Looks up a sampler's register once
+// --------------------------------------------------------
+SimpleSamplerHandle ISimpleShader::GetSamplerHandle(std::string name)
+{
+	SimpleSamplerHandle handle;
+	const SimpleSampler* sampInfo = GetSamplerInfo(name);
+	if (sampInfo)
+		handle.BindIndex = sampInfo->BindIndex;
+	return handle;
+}
+
+// --------------------------------------------------------
+// Sets a variable through a handle from GetVariableHandle()
+//
+// Returns false if the handle is invalid or the size
+// doesn't match the variable's
+// --------------------------------------------------------
+bool ISimpleShader::SetData(SimpleVariableHandle handle, const void* data, unsigned int size)
+{
+	if (!handle.IsValid() || handle.Size != size || handle.ConstantBufferIndex >= constantBufferCount)
+		return false;
+
+	WriteVariable(&constantBuffers[handle.ConstantBufferIndex], handle.ByteOffset, data, size);
+	return true;
+}
+
+bool ISimpleShader::SetInt(SimpleVariableHandle handle, int data)
+{
+	return this->SetData(handle, &data, sizeof(int));
+}
+
+bool ISimpleShader::SetFloat(SimpleVariableHandle handle, float data)
+{
+	return this->SetData(handle, &data, sizeof(float));
+}
+
+bool ISimpleShader::SetFloat2(SimpleVariableHandle handle, const DirectX::XMFLOAT2& data)
+{
+	return this->SetData(handle, &data, sizeof(float) * 2);
+}
+
+bool ISimpleShader::SetFloat3(SimpleVariableHandle handle, const DirectX::XMFLOAT3& data)
+{
+	return this->SetData(handle, &data, sizeof(float) * 3);
+}
+
+bool ISimpleShader::SetFloat4(SimpleVariableHandle handle, const DirectX::XMFLOAT4& data)
+{
+	return this->SetData(handle, &data, sizeof(float) * 4);
+}
+
+bool ISimpleShader::SetMatrix4x4(SimpleVariableHandle handle, const DirectX::XMFLOAT4X4& data)
+{
+	return this->SetData(handle, &data, sizeof(float) * 16);
+}
+
+// --------------------------------------------------------
+// Sets an SRV through a handle, in whichever stage this
+// shader is for
+// --------------------------------------------------------
+bool ISimpleShader::SetShaderResourceView(SimpleSRVHandle handle, ID3D11ShaderResourceView* srv)
+{
+	if (!handle.IsValid())
+		return false;
+
+	stateCache->SetShaderResource(GetStage(), handle.BindIndex, srv);
+	return true;
+}
+
+// --------------------------------------------------------
+// Sets a sampler through a handle, in whichever stage this
+// shader is for
+// --------------------------------------------------------
+bool ISimpleShader::SetSamplerState(SimpleSamplerHandle handle, ID3D11SamplerState* samplerState)
+{
+	if (!handle.IsValid())
+		return false;
+
+	stateCache->SetSampler(GetStage(), handle.BindIndex, samplerState);
+	return true;
+}
+
 // --------------------------------------------------------
 // Gets info about a shader variable, if it exists
 // --------------------------------------------------------
@@ -759,8 +1057,8 @@ void SimpleVertexShader::SetShaderAndCBs()
 	if (!shaderValid) return;
 
 	// Set the shader and input layout
-	deviceContext->IASetInputLayout(inputLayout);
-	deviceContext->VSSetShader(shader, 0, 0);
+	stateCache->SetInputLayout(inputLayout);
+	stateCache->SetShader(SHADER_STAGE_VERTEX, shader);
 
 	// Set the constant buffers
 	for (unsigned int i = 0; i < constantBufferCount; i++)
@@ -770,10 +1068,7 @@ void SimpleVertexShader::SetShaderAndCBs()
 			continue;
 
 		// This is a real constant buffer, so set it
-		deviceContext->VSSetConstantBuffers(
-			constantBuffers[i].BindIndex,
-			1,
-			&constantBuffers[i].ConstantBuffer);
+		BindConstantBuffer(&constantBuffers[i]);
 	}
 }
 
@@ -793,7 +1088,7 @@ bool SimpleVertexShader::SetShaderResourceView(std::string name, ID3D11ShaderRes
 		return false;
 
 	// Set the shader resource view
-	deviceContext->VSSetShaderResources(srvInfo->BindIndex, 1, &srv);
+	stateCache->SetShaderResource(SHADER_STAGE_VERTEX, srvInfo->BindIndex, srv);
 
 	// Success
 	return true;
@@ -815,7 +1110,7 @@ bool SimpleVertexShader::SetSamplerState(std::string name, ID3D11SamplerState* s
 		return false;
 
 	// Set the shader resource view
-	deviceContext->VSSetSamplers(sampInfo->BindIndex, 1, &samplerState);
+	stateCache->SetSampler(SHADER_STAGE_VERTEX, sampInfo->BindIndex, samplerState);
 
 	// Success
 	return true;
@@ -886,7 +1181,7 @@ void SimplePixelShader::SetShaderAndCBs()
 	if (!shaderValid) return;
 	
 	// Set the shader
-	deviceContext->PSSetShader(shader, 0, 0);
+	stateCache->SetShader(SHADER_STAGE_PIXEL, shader);
 
 	// Set the constant buffers
 	for (unsigned int i = 0; i < constantBufferCount; i++)
@@ -896,10 +1191,7 @@ void SimplePixelShader::SetShaderAndCBs()
 			continue;
 
 		// This is a real constant buffer, so set it
-		deviceContext->PSSetConstantBuffers(
-			constantBuffers[i].BindIndex,
-			1,
-			&constantBuffers[i].ConstantBuffer);
+		BindConstantBuffer(&constantBuffers[i]);
 	}
 }
 
@@ -919,7 +1211,7 @@ bool SimplePixelShader::SetShaderResourceView(std::string name, ID3D11ShaderReso
 		return false;
 
 	// Set the shader resource view
-	deviceContext->PSSetShaderResources(srvInfo->BindIndex, 1, &srv);
+	stateCache->SetShaderResource(SHADER_STAGE_PIXEL, srvInfo->BindIndex, srv);
 
 	// Success
 	return true;
@@ -941,7 +1233,7 @@ bool SimplePixelShader::SetSamplerState(std::string name, ID3D11SamplerState* sa
 		return false;
 
 	// Set the shader resource view
-	deviceContext->PSSetSamplers(sampInfo->BindIndex, 1, &samplerState);
+	stateCache->SetSampler(SHADER_STAGE_PIXEL, sampInfo->BindIndex, samplerState);
 
 	// Success
 	return true;
@@ -1014,7 +1306,7 @@ void SimpleDomainShader::SetShaderAndCBs()
 	if (!shaderValid) return;
 
 	// Set the shader
-	deviceContext->DSSetShader(shader, 0, 0);
+	stateCache->SetShader(SHADER_STAGE_DOMAIN, shader);
 
 	// Set the constant buffers
 	for (unsigned int i = 0; i < constantBufferCount; i++)
@@ -1024,10 +1316,7 @@ void SimpleDomainShader::SetShaderAndCBs()
 			continue;
 
 		// This is a real constant buffer, so set it
-		deviceContext->DSSetConstantBuffers(
-			constantBuffers[i].BindIndex,
-			1,
-			&constantBuffers[i].ConstantBuffer);
+		BindConstantBuffer(&constantBuffers[i]);
 	}
 }
 
@@ -1047,7 +1336,7 @@ bool SimpleDomainShader::SetShaderResourceView(std::string name, ID3D11ShaderRes
 		return false;
 
 	// Set the shader resource view
-	deviceContext->DSSetShaderResources(srvInfo->BindIndex, 1, &srv);
+	stateCache->SetShaderResource(SHADER_STAGE_DOMAIN, srvInfo->BindIndex, srv);
 
 	// Success
 	return true;
@@ -1069,7 +1358,7 @@ bool SimpleDomainShader::SetSamplerState(std::string name, ID3D11SamplerState* s
 		return false;
 
 	// Set the shader resource view
-	deviceContext->DSSetSamplers(sampInfo->BindIndex, 1, &samplerState);
+	stateCache->SetSampler(SHADER_STAGE_DOMAIN, sampInfo->BindIndex, samplerState);
 
 	// Success
 	return true;
@@ -1141,7 +1430,7 @@ void SimpleHullShader::SetShaderAndCBs()
 	if (!shaderValid) return;
 
 	// Set the shader
-	deviceContext->HSSetShader(shader, 0, 0);
+	stateCache->SetShader(SHADER_STAGE_HULL, shader);
 
 	// Set the constant buffers?
 	for (unsigned int i = 0; i < constantBufferCount; i++)
@@ -1151,10 +1440,7 @@ void SimpleHullShader::SetShaderAndCBs()
 			continue;
 
 		// This is a real constant buffer, so set it
-		deviceContext->HSSetConstantBuffers(
-			constantBuffers[i].BindIndex,
-			1,
-			&constantBuffers[i].ConstantBuffer);
+		BindConstantBuffer(&constantBuffers[i]);
 	}
 }
 
@@ -1174,7 +1460,7 @@ bool SimpleHullShader::SetShaderResourceView(std::string name, ID3D11ShaderResou
 		return false;
 
 	// Set the shader resource view
-	deviceContext->HSSetShaderResources(srvInfo->BindIndex, 1, &srv);
+	stateCache->SetShaderResource(SHADER_STAGE_HULL, srvInfo->BindIndex, srv);
 
 	// Success
 	return true;
@@ -1196,7 +1482,7 @@ bool SimpleHullShader::SetSamplerState(std::string name, ID3D11SamplerState* sam
 		return false;
 
 	// Set the shader resource view
-	deviceContext->HSSetSamplers(sampInfo->BindIndex, 1, &samplerState);
+	stateCache->SetSampler(SHADER_STAGE_HULL, sampInfo->BindIndex, samplerState);
 
 	// Success
 	return true;
@@ -1391,7 +1677,7 @@ void SimpleGeometryShader::SetShaderAndCBs()
 	if (!shaderValid) return;
 
 	// Set the shader
-	deviceContext->GSSetShader(shader, 0, 0);
+	stateCache->SetShader(SHADER_STAGE_GEOMETRY, shader);
 
 	// Set the constant buffers?
 	for (unsigned int i = 0; i < constantBufferCount; i++)
@@ -1401,10 +1687,7 @@ void SimpleGeometryShader::SetShaderAndCBs()
 			continue;
 
 		// This is a real constant buffer, so set it
-		deviceContext->GSSetConstantBuffers(
-			constantBuffers[i].BindIndex,
-			1,
-			&constantBuffers[i].ConstantBuffer);
+		BindConstantBuffer(&constantBuffers[i]);
 	}
 }
 
@@ -1424,7 +1707,7 @@ bool SimpleGeometryShader::SetShaderResourceView(std::string name, ID3D11ShaderR
 		return false;
 
 	// Set the shader resource view
-	deviceContext->GSSetShaderResources(srvInfo->BindIndex, 1, &srv);
+	stateCache->SetShaderResource(SHADER_STAGE_GEOMETRY, srvInfo->BindIndex, srv);
 
 	// Success
 	return true;
@@ -1446,7 +1729,7 @@ bool SimpleGeometryShader::SetSamplerState(std::string name, ID3D11SamplerState*
 		return false;
 
 	// Set the shader resource view
-	deviceContext->GSSetSamplers(sampInfo->BindIndex, 1, &samplerState);
+	stateCache->SetSampler(SHADER_STAGE_GEOMETRY, sampInfo->BindIndex, samplerState);
 
 	// Success
 	return true;
@@ -1586,7 +1869,7 @@ void SimpleComputeShader::SetShaderAndCBs()
 	if (!shaderValid) return;
 
 	// Set the shader
-	deviceContext->CSSetShader(shader, 0, 0);
+	stateCache->SetShader(SHADER_STAGE_COMPUTE, shader);
 
 	// Set the constant buffers?
 	for (unsigned int i = 0; i < constantBufferCount; i++)
@@ -1596,10 +1879,7 @@ void SimpleComputeShader::SetShaderAndCBs()
 			continue;
 
 		// This is a real constant buffer, so set it
-		deviceContext->CSSetConstantBuffers(
-			constantBuffers[i].BindIndex,
-			1,
-			&constantBuffers[i].ConstantBuffer);
+		BindConstantBuffer(&constantBuffers[i]);
 	}
 }
 
@@ -1672,7 +1952,7 @@ bool SimpleComputeShader::SetShaderResourceView(std::string name, ID3D11ShaderRe
 		return false;
 
 	// Set the shader resource view
-	deviceContext->CSSetShaderResources(srvInfo->BindIndex, 1, &srv);
+	stateCache->SetShaderResource(SHADER_STAGE_COMPUTE, srvInfo->BindIndex, srv);
 
 	// Success
 	return true;
@@ -1694,7 +1974,7 @@ bool SimpleComputeShader::SetSamplerState(std::string name, ID3D11SamplerState*
 		return false;
 
 	// Set the shader resource view
-	deviceContext->CSSetSamplers(sampInfo->BindIndex, 1, &samplerState);
+	stateCache->SetSampler(SHADER_STAGE_COMPUTE, sampInfo->BindIndex, samplerState);
 
 	// Success
 	return true;
@@ -1719,6 +1999,9 @@ bool SimpleComputeShader::SetUnorderedAccessView(std::string name, ID3D11Unorder
 	// Set the shader resource view
 	deviceContext->CSSetUnorderedAccessViews(bindIndex, 1, &uav, &appendConsumeOffset);
 
+	// D3D unbinds the resource anywhere it was bound as an SRV
+	stateCache->InvalidateShaderResources();
+
 	// Success
 	return true;
 }
@@ -3,9 +3,12 @@
 #pragma comment(lib, "d3dcompiler.lib")
 
 #include <d3d11.h>
+#include <d3d11_1.h>
 #include <d3dcompiler.h>
 #include <DirectXMath.h>
 
+#include "StateCache.h"
+
 #include <unordered_map>
 #include <vector>
 #include <string>
@@ -34,9 +37,29 @@ struct SimpleConstantBuffer
 	unsigned int BindIndex = 0;
 	ID3D11Buffer* ConstantBuffer = 0;
 	unsigned char* LocalDataBuffer = 0;
+	bool External = false;	// Buffer is owned and filled by someone else
+	unsigned int DirtyStart = 0;	// Bytes [DirtyStart, DirtyEnd) changed
+	unsigned int DirtyEnd = 0;		// since the last upload (empty if Start >= End)
+	unsigned int RingGeneration = 0;	// Where the data last went in the ring buffer,
+	unsigned int RingFirstConstant = 0;	// if the shader uses one
+	unsigned int RingNumConstants = 0;
 	std::vector<SimpleShaderVariable> Variables;
 };
 
+// --------------------------------------------------------
+// Constant buffer upload counts across all shaders.
+// "Requested" is what would have been sent if every copy
+// uploaded the whole buffer; "Uploaded" is what actually
+// went out after skipping unchanged data.
+// --------------------------------------------------------
+struct SimpleShaderUploadStats
+{
+	unsigned int Uploads;
+	unsigned int Skipped;
+	unsigned long long RequestedBytes;
+	unsigned long long UploadedBytes;
+};
+
 // --------------------------------------------------------
 // Contains info about a single SRV in a shader
 // --------------------------------------------------------
@@ -55,6 +78,35 @@ struct SimpleSampler
 	unsigned int BindIndex; // The register of the Sampler
 };
 
+// --------------------------------------------------------
+// Pre-resolved references to a shader variable, SRV or
+// sampler, from the Get*Handle() methods.  Setting through
+// a handle skips the name lookup (and the std::string) so
+// it's just a copy.  Resolve once and keep them around -
+// they stay good until the shader is reloaded.
+// --------------------------------------------------------
+struct SimpleVariableHandle
+{
+	unsigned int ConstantBufferIndex = 0;
+	unsigned int ByteOffset = 0;
+	unsigned int Size = 0;	// Zero if the variable wasn't found
+	bool IsValid() const { return Size > 0; }
+};
+
+struct SimpleSRVHandle
+{
+	unsigned int BindIndex = (unsigned int)-1;	// -1 if not found
+	bool IsValid() const { return BindIndex != (unsigned int)-1; }
+};
+
+struct SimpleSamplerHandle
+{
+	unsigned int BindIndex = (unsigned int)-1;	// -1 if not found
+	bool IsValid() const { return BindIndex != (unsigned int)-1; }
+};
+
+class ConstantRingBuffer;
+
 // --------------------------------------------------------
 // Base abstract class for simplifying shader handling
 // --------------------------------------------------------
@@ -67,6 +119,7 @@ public:
 	// Initialization method (since we can't invoke derived class
 	// overrides in the base class constructor)
 	bool LoadShaderFile(LPCWSTR shaderFile);
+	bool LoadShaderBlob(ID3DBlob* blob);
 
 	// Simple helpers
 	bool IsShaderValid() { return shaderValid; }
@@ -77,6 +130,15 @@ public:
 	void CopyBufferData(unsigned int index);
 	void CopyBufferData(std::string bufferName);
 
+	// Shares a buffer that is filled elsewhere (once per frame,
+	// for instance) - it gets bound with the shader but never copied
+	bool SetExternalConstantBuffer(std::string bufferName, ID3D11Buffer* buffer);
+
+	// Sends this shader's (non-external) constants through a
+	// shared ring buffer instead of its own buffers.  Pass 0
+	// to go back to the shader's own buffers.
+	void SetConstantRingBuffer(ConstantRingBuffer* ring);
+
 	// Sets arbitrary shader data
 	bool SetData(std::string name, const void* data, unsigned int size);
 
@@ -95,6 +157,22 @@ public:
 	virtual bool SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv) = 0;
 	virtual bool SetSamplerState(std::string name, ID3D11SamplerState* samplerState) = 0;
 
+	// Looking names up once, for the handle versions below
+	SimpleVariableHandle GetVariableHandle(std::string name);
+	SimpleSRVHandle GetShaderResourceViewHandle(std::string name);
+	SimpleSamplerHandle GetSamplerHandle(std::string name);
+
+	// Setting data and resources through handles
+	bool SetData(SimpleVariableHandle handle, const void* data, unsigned int size);
+	bool SetInt(SimpleVariableHandle handle, int data);
+	bool SetFloat(SimpleVariableHandle handle, float data);
+	bool SetFloat2(SimpleVariableHandle handle, const DirectX::XMFLOAT2& data);
+	bool SetFloat3(SimpleVariableHandle handle, const DirectX::XMFLOAT3& data);
+	bool SetFloat4(SimpleVariableHandle handle, const DirectX::XMFLOAT4& data);
+	bool SetMatrix4x4(SimpleVariableHandle handle, const DirectX::XMFLOAT4X4& data);
+	bool SetShaderResourceView(SimpleSRVHandle handle, ID3D11ShaderResourceView* srv);
+	bool SetSamplerState(SimpleSamplerHandle handle, ID3D11SamplerState* samplerState);
+
 	// Getting data about variables and resources
 	const SimpleShaderVariable* GetVariableInfo(std::string name);
 	
@@ -115,12 +193,21 @@ public:
 	// Misc getters
 	ID3DBlob* GetShaderBlob() { return shaderBlob; }
 
+	// Upload counts since the last reset, for all shaders
+	static const SimpleShaderUploadStats& GetUploadStats() { return uploadStats; }
+	static void ResetUploadStats();
+
 protected:
 	
 	bool shaderValid;
 	ID3DBlob* shaderBlob;
 	ID3D11Device* device;
 	ID3D11DeviceContext* deviceContext;
+	StateCache* stateCache;
+	ID3D11DeviceContext1* deviceContext1;	// Null unless partial buffer updates work
+	ConstantRingBuffer* ringBuffer;
+
+	static SimpleShaderUploadStats uploadStats;
 
 	// Resource counts
 	unsigned int constantBufferCount;
@@ -137,12 +224,17 @@ protected:
 	// Pure virtual functions for dealing with shader types
 	virtual bool CreateShader(ID3DBlob* shaderBlob) = 0;
 	virtual void SetShaderAndCBs() = 0;
+	virtual ShaderStage GetStage() = 0;
 
 	virtual void CleanUp();
 
 	// Helpers for finding data by name
 	SimpleShaderVariable* FindVariable(std::string name, int size);
 	SimpleConstantBuffer* FindConstantBuffer(std::string name);
+
+	void WriteVariable(SimpleConstantBuffer* cb, unsigned int byteOffset, const void* data, unsigned int size);
+	void UploadBuffer(SimpleConstantBuffer* cb);
+	void BindConstantBuffer(SimpleConstantBuffer* cb);
 };
 
 // --------------------------------------------------------
@@ -160,6 +252,8 @@ public:
 
 	bool SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv);
 	bool SetSamplerState(std::string name, ID3D11SamplerState* samplerState);
+	using ISimpleShader::SetShaderResourceView;
+	using ISimpleShader::SetSamplerState;
 
 protected:
 	bool perInstanceCompatible;
@@ -167,6 +261,7 @@ protected:
 	ID3D11VertexShader* shader;
 	bool CreateShader(ID3DBlob* shaderBlob);
 	void SetShaderAndCBs();
+	ShaderStage GetStage() { return SHADER_STAGE_VERTEX; }
 	void CleanUp();
 };
 
@@ -183,11 +278,14 @@ public:
 
 	bool SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv);
 	bool SetSamplerState(std::string name, ID3D11SamplerState* samplerState);
+	using ISimpleShader::SetShaderResourceView;
+	using ISimpleShader::SetSamplerState;
 
 protected:
 	ID3D11PixelShader* shader;
 	bool CreateShader(ID3DBlob* shaderBlob);
 	void SetShaderAndCBs();
+	ShaderStage GetStage() { return SHADER_STAGE_PIXEL; }
 	void CleanUp();
 };
 
@@ -203,11 +301,14 @@ public:
 
 	bool SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv);
 	bool SetSamplerState(std::string name, ID3D11SamplerState* samplerState);
+	using ISimpleShader::SetShaderResourceView;
+	using ISimpleShader::SetSamplerState;
 
 protected:
 	ID3D11DomainShader* shader;
 	bool CreateShader(ID3DBlob* shaderBlob);
 	void SetShaderAndCBs();
+	ShaderStage GetStage() { return SHADER_STAGE_DOMAIN; }
 	void CleanUp();
 };
 
@@ -223,11 +324,14 @@ public:
 
 	bool SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv);
 	bool SetSamplerState(std::string name, ID3D11SamplerState* samplerState);
+	using ISimpleShader::SetShaderResourceView;
+	using ISimpleShader::SetSamplerState;
 
 protected:
 	ID3D11HullShader* shader;
 	bool CreateShader(ID3DBlob* shaderBlob);
 	void SetShaderAndCBs();
+	ShaderStage GetStage() { return SHADER_STAGE_HULL; }
 	void CleanUp();
 };
 
@@ -243,6 +347,8 @@ public:
 
 	bool SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv);
 	bool SetSamplerState(std::string name, ID3D11SamplerState* samplerState);
+	using ISimpleShader::SetShaderResourceView;
+	using ISimpleShader::SetSamplerState;
 
 	bool CreateCompatibleStreamOutBuffer(ID3D11Buffer** buffer, int vertexCount);
 
@@ -260,6 +366,7 @@ protected:
 	bool CreateShader(ID3DBlob* shaderBlob);
 	bool CreateShaderWithStreamOut(ID3DBlob* shaderBlob);
 	void SetShaderAndCBs();
+	ShaderStage GetStage() { return SHADER_STAGE_GEOMETRY; }
 	void CleanUp();
 
 	// Helpers
@@ -282,6 +389,8 @@ public:
 
 	bool SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv);
 	bool SetSamplerState(std::string name, ID3D11SamplerState* samplerState);
+	using ISimpleShader::SetShaderResourceView;
+	using ISimpleShader::SetSamplerState;
 	bool SetUnorderedAccessView(std::string name, ID3D11UnorderedAccessView* uav, unsigned int appendConsumeOffset = -1);
 
 	int GetUnorderedAccessViewIndex(std::string name);
@@ -297,5 +406,6 @@ protected:
 
 	bool CreateShader(ID3DBlob* shaderBlob);
 	void SetShaderAndCBs();
+	ShaderStage GetStage() { return SHADER_STAGE_COMPUTE; }
 	void CleanUp();
 };
\ No newline at end of file
@@ -0,0 +1,319 @@
+#include "StateCache.h"
+
+std::vector<StateCache*> StateCache::caches;
+
+StateCache* StateCache::Get(ID3D11DeviceContext* context)
+{
+	for (unsigned int i = 0; i < caches.size(); i++)
+	{
+		if (caches[i]->context == context)
+			return caches[i];
+	}
+
+	StateCache* cache = new StateCache(context);
+	caches.push_back(cache);
+	return cache;
+}
+
+void StateCache::Destroy(ID3D11DeviceContext* context)
+{
+	for (unsigned int i = 0; i < caches.size(); i++)
+	{
+		if (caches[i]->context == context)
+		{
+			delete caches[i];
+			caches.erase(caches.begin() + i);
+			return;
+		}
+	}
+}
+
+StateCache::StateCache(ID3D11DeviceContext* context)
+{
+	this->context = context;
+	stats = {};
+	Invalidate();
+
+	context1 = 0;
+	context->QueryInterface(__uuidof(ID3D11DeviceContext1), (void**)&context1);
+}
+
+StateCache::~StateCache()
+{
+	if (context1) context1->Release();
+}
+
+// --------------------------------------------------------
+// Forgets everything, so the next bind of each kind always
+// goes through.  Every slot is set to a pointer that can
+// never be a real D3D object, since null is a perfectly
+// good thing to have bound.
+// --------------------------------------------------------
+void StateCache::Invalidate()
+{
+	void* unknown = (void*)-1;
+
+	inputLayout = (ID3D11InputLayout*)unknown;
+	topology = D3D11_PRIMITIVE_TOPOLOGY_UNDEFINED;
+	for (unsigned int i = 0; i < MaxVertexBuffers; i++)
+	{
+		vertexBuffers[i] = (ID3D11Buffer*)unknown;
+		vertexStrides[i] = 0;
+		vertexOffsets[i] = 0;
+	}
+	indexBuffer = (ID3D11Buffer*)unknown;
+	indexFormat = DXGI_FORMAT_UNKNOWN;
+	indexOffset = 0;
+
+	for (int s = 0; s < SHADER_STAGE_COUNT; s++)
+	{
+		shaders[s] = (ID3D11DeviceChild*)unknown;
+		for (unsigned int i = 0; i < MaxConstantBuffers; i++)
+		{
+			constantBuffers[s][i] = (ID3D11Buffer*)unknown;
+			constantFirst[s][i] = 0;
+			constantCount[s][i] = 0;
+		}
+		for (unsigned int i = 0; i < MaxSamplers; i++)
+			samplers[s][i] = (ID3D11SamplerState*)unknown;
+	}
+	InvalidateShaderResources();
+
+	rasterizerState = (ID3D11RasterizerState*)unknown;
+	depthStencilState = (ID3D11DepthStencilState*)unknown;
+	stencilRef = 0;
+	blendState = (ID3D11BlendState*)unknown;
+	for (int i = 0; i < 4; i++)
+		blendFactor[i] = 0;
+	sampleMask = 0;
+}
+
+// --------------------------------------------------------
+// Forgets just the bound SRVs.  Used when something may
+// have unbound them behind our back (render targets, UAVs).
+// --------------------------------------------------------
+void StateCache::InvalidateShaderResources()
+{
+	ID3D11ShaderResourceView* unknown = (ID3D11ShaderResourceView*)-1;
+	for (int s = 0; s < SHADER_STAGE_COUNT; s++)
+	{
+		for (unsigned int i = 0; i < MaxShaderResources; i++)
+			shaderResources[s][i] = unknown;
+	}
+}
+
+void StateCache::ResetStats()
+{
+	stats = {};
+}
+
+bool StateCache::Skip(bool same)
+{
+	if (same)
+		stats.Skipped++;
+	else
+		stats.Issued++;
+	return same;
+}
+
+void StateCache::SetInputLayout(ID3D11InputLayout* layout)
+{
+	if (Skip(inputLayout == layout))
+		return;
+
+	inputLayout = layout;
+	context->IASetInputLayout(layout);
+}
+
+void StateCache::SetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology)
+{
+	if (Skip(this->topology == topology))
+		return;
+
+	this->topology = topology;
+	context->IASetPrimitiveTopology(topology);
+}
+
+void StateCache::SetVertexBuffers(unsigned int startSlot, unsigned int count, ID3D11Buffer* const* buffers, const UINT* strides, const UINT* offsets)
+{
+	bool tracked = startSlot + count <= MaxVertexBuffers;
+	bool same = tracked;
+	for (unsigned int i = 0; same && i < count; i++)
+	{
+		unsigned int slot = startSlot + i;
+		same = vertexBuffers[slot] == buffers[i] &&
+			vertexStrides[slot] == strides[i] &&
+			vertexOffsets[slot] == offsets[i];
+	}
+
+	if (Skip(same))
+		return;
+
+	if (tracked)
+	{
+		for (unsigned int i = 0; i < count; i++)
+		{
+			vertexBuffers[startSlot + i] = buffers[i];
+			vertexStrides[startSlot + i] = strides[i];
+			vertexOffsets[startSlot + i] = offsets[i];
+		}
+	}
+	context->IASetVertexBuffers(startSlot, count, buffers, strides, offsets);
+}
+
+void StateCache::SetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, unsigned int offset)
+{
+	if (Skip(indexBuffer == buffer && indexFormat == format && indexOffset == offset))
+		return;
+
+	indexBuffer = buffer;
+	indexFormat = format;
+	indexOffset = offset;
+	context->IASetIndexBuffer(buffer, format, offset);
+}
+
+void StateCache::SetShader(ShaderStage stage, ID3D11DeviceChild* shader)
+{
+	if (Skip(shaders[stage] == shader))
+		return;
+
+	shaders[stage] = shader;
+	switch (stage)
+	{
+	case SHADER_STAGE_VERTEX:	context->VSSetShader((ID3D11VertexShader*)shader, 0, 0); break;
+	case SHADER_STAGE_HULL:		context->HSSetShader((ID3D11HullShader*)shader, 0, 0); break;
+	case SHADER_STAGE_DOMAIN:	context->DSSetShader((ID3D11DomainShader*)shader, 0, 0); break;
+	case SHADER_STAGE_GEOMETRY:	context->GSSetShader((ID3D11GeometryShader*)shader, 0, 0); break;
+	case SHADER_STAGE_PIXEL:	context->PSSetShader((ID3D11PixelShader*)shader, 0, 0); break;
+	case SHADER_STAGE_COMPUTE:	context->CSSetShader((ID3D11ComputeShader*)shader, 0, 0); break;
+	}
+}
+
+void StateCache::SetConstantBuffer(ShaderStage stage, unsigned int slot, ID3D11Buffer* buffer, unsigned int firstConstant, unsigned int numConstants)
+{
+	bool tracked = slot < MaxConstantBuffers;
+	if (Skip(tracked &&
+		constantBuffers[stage][slot] == buffer &&
+		constantFirst[stage][slot] == firstConstant &&
+		constantCount[stage][slot] == numConstants))
+		return;
+
+	if (tracked)
+	{
+		constantBuffers[stage][slot] = buffer;
+		constantFirst[stage][slot] = firstConstant;
+		constantCount[stage][slot] = numConstants;
+	}
+
+	if (numConstants > 0 && context1)
+	{
+		const UINT* first = &firstConstant;
+		const UINT* count = &numConstants;
+		switch (stage)
+		{
+		case SHADER_STAGE_VERTEX:	context1->VSSetConstantBuffers1(slot, 1, &buffer, first, count); break;
+		case SHADER_STAGE_HULL:		context1->HSSetConstantBuffers1(slot, 1, &buffer, first, count); break;
+		case SHADER_STAGE_DOMAIN:	context1->DSSetConstantBuffers1(slot, 1, &buffer, first, count); break;
+		case SHADER_STAGE_GEOMETRY:	context1->GSSetConstantBuffers1(slot, 1, &buffer, first, count); break;
+		case SHADER_STAGE_PIXEL:	context1->PSSetConstantBuffers1(slot, 1, &buffer, first, count); break;
+		case SHADER_STAGE_COMPUTE:	context1->CSSetConstantBuffers1(slot, 1, &buffer, first, count); break;
+		}
+		return;
+	}
+
+	switch (stage)
+	{
+	case SHADER_STAGE_VERTEX:	context->VSSetConstantBuffers(slot, 1, &buffer); break;
+	case SHADER_STAGE_HULL:		context->HSSetConstantBuffers(slot, 1, &buffer); break;
+	case SHADER_STAGE_DOMAIN:	context->DSSetConstantBuffers(slot, 1, &buffer); break;
+	case SHADER_STAGE_GEOMETRY:	context->GSSetConstantBuffers(slot, 1, &buffer); break;
+	case SHADER_STAGE_PIXEL:	context->PSSetConstantBuffers(slot, 1, &buffer); break;
+	case SHADER_STAGE_COMPUTE:	context->CSSetConstantBuffers(slot, 1, &buffer); break;
+	}
+}
+
+void StateCache::SetShaderResource(ShaderStage stage, unsigned int slot, ID3D11ShaderResourceView* srv)
+{
+	bool tracked = slot < MaxShaderResources;
+	if (Skip(tracked && shaderResources[stage][slot] == srv))
+		return;
+
+	if (tracked)
+		shaderResources[stage][slot] = srv;
+
+	switch (stage)
+	{
+	case SHADER_STAGE_VERTEX:	context->VSSetShaderResources(slot, 1, &srv); break;
+	case SHADER_STAGE_HULL:		context->HSSetShaderResources(slot, 1, &srv); break;
+	case SHADER_STAGE_DOMAIN:	context->DSSetShaderResources(slot, 1, &srv); break;
+	case SHADER_STAGE_GEOMETRY:	context->GSSetShaderResources(slot, 1, &srv); break;
+	case SHADER_STAGE_PIXEL:	context->PSSetShaderResources(slot, 1, &srv); break;
+	case SHADER_STAGE_COMPUTE:	context->CSSetShaderResources(slot, 1, &srv); break;
+	}
+}
+
+void StateCache::SetSampler(ShaderStage stage, unsigned int slot, ID3D11SamplerState* sampler)
+{
+	bool tracked = slot < MaxSamplers;
+	if (Skip(tracked && samplers[stage][slot] == sampler))
+		return;
+
+	if (tracked)
+		samplers[stage][slot] = sampler;
+
+	switch (stage)
+	{
+	case SHADER_STAGE_VERTEX:	context->VSSetSamplers(slot, 1, &sampler); break;
+	case SHADER_STAGE_HULL:		context->HSSetSamplers(slot, 1, &sampler); break;
+	case SHADER_STAGE_DOMAIN:	context->DSSetSamplers(slot, 1, &sampler); break;
+	case SHADER_STAGE_GEOMETRY:	context->GSSetSamplers(slot, 1, &sampler); break;
+	case SHADER_STAGE_PIXEL:	context->PSSetSamplers(slot, 1, &sampler); break;
+	case SHADER_STAGE_COMPUTE:	context->CSSetSamplers(slot, 1, &sampler); break;
+	}
+}
+
+void StateCache::SetRasterizerState(ID3D11RasterizerState* state)
+{
+	if (Skip(rasterizerState == state))
+		return;
+
+	rasterizerState = state;
+	context->RSSetState(state);
+}
+
+void StateCache::SetDepthStencilState(ID3D11DepthStencilState* state, unsigned int stencilRef)
+{
+	if (Skip(depthStencilState == state && this->stencilRef == stencilRef))
+		return;
+
+	depthStencilState = state;
+	this->stencilRef = stencilRef;
+	context->OMSetDepthStencilState(state, stencilRef);
+}
+
+void StateCache::SetBlendState(ID3D11BlendState* state, const float blendFactor[4], unsigned int sampleMask)
+{
+	static const float defaultFactor[4] = { 1, 1, 1, 1 };
+	if (!blendFactor)
+		blendFactor = defaultFactor;
+
+	bool same = blendState == state && this->sampleMask == sampleMask;
+	for (int i = 0; same && i < 4; i++)
+		same = this->blendFactor[i] == blendFactor[i];
+
+	if (Skip(same))
+		return;
+
+	blendState = state;
+	this->sampleMask = sampleMask;
+	for (int i = 0; i < 4; i++)
+		this->blendFactor[i] = blendFactor[i];
+	context->OMSetBlendState(state, blendFactor, sampleMask);
+}
+
+void StateCache::SetRenderTargets(unsigned int count, ID3D11RenderTargetView* const* rtvs, ID3D11DepthStencilView* dsv)
+{
+	stats.Issued++;
+	InvalidateShaderResources();
+	context->OMSetRenderTargets(count, rtvs, dsv);
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <d3d11_1.h>
+#include <vector>
+
+// --------------------------------------------------------
+// Shader stages the cache tracks bindings for
+// --------------------------------------------------------
+enum ShaderStage
+{
+	SHADER_STAGE_VERTEX,
+	SHADER_STAGE_HULL,
+	SHADER_STAGE_DOMAIN,
+	SHADER_STAGE_GEOMETRY,
+	SHADER_STAGE_PIXEL,
+	SHADER_STAGE_COMPUTE,
+	SHADER_STAGE_COUNT
+};
+
+struct StateCacheStats
+{
+	unsigned int Issued;	// Binds that went through to D3D
+	unsigned int Skipped;	// Binds that matched what was already bound
+};
+
+// --------------------------------------------------------
+// Remembers what is bound on a device context and drops
+// any bind that wouldn't change anything.
+//
+// There is one cache per context, shared by everything
+// that binds through it (see Get()).  Code that binds
+// directly on the context must call Invalidate() after,
+// or the cache may skip a bind it shouldn't.
+//
+// Only the low slots are tracked; binds past them always
+// go through.
+// --------------------------------------------------------
+class StateCache
+{
+public:
+	// The cache for a context, created on first use
+	static StateCache* Get(ID3D11DeviceContext* context);
+	static void Destroy(ID3D11DeviceContext* context);
+
+	// Input assembler
+	void SetInputLayout(ID3D11InputLayout* layout);
+	void SetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology);
+	void SetVertexBuffers(unsigned int startSlot, unsigned int count, ID3D11Buffer* const* buffers, const UINT* strides, const UINT* offsets);
+	void SetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, unsigned int offset);
+
+	// Shader stages
+	void SetShader(ShaderStage stage, ID3D11DeviceChild* shader);
+	// A non-zero numConstants binds just that window of the
+	// buffer (in 16-byte constants), which needs D3D 11.1
+	void SetConstantBuffer(ShaderStage stage, unsigned int slot, ID3D11Buffer* buffer, unsigned int firstConstant = 0, unsigned int numConstants = 0);
+	void SetShaderResource(ShaderStage stage, unsigned int slot, ID3D11ShaderResourceView* srv);
+	void SetSampler(ShaderStage stage, unsigned int slot, ID3D11SamplerState* sampler);
+
+	// Fixed function
+	void SetRasterizerState(ID3D11RasterizerState* state);
+	void SetDepthStencilState(ID3D11DepthStencilState* state, unsigned int stencilRef);
+	void SetBlendState(ID3D11BlendState* state, const float blendFactor[4], unsigned int sampleMask);
+
+	// Always issued.  Binding outputs makes D3D unbind any of
+	// the same resources bound as inputs, so this forgets
+	// every tracked SRV.
+	void SetRenderTargets(unsigned int count, ID3D11RenderTargetView* const* rtvs, ID3D11DepthStencilView* dsv);
+
+	// Forget everything (after binding directly on the context)
+	void Invalidate();
+	void InvalidateShaderResources();
+
+	const StateCacheStats& GetStats() { return stats; }
+	void ResetStats();
+
+private:
+	static const unsigned int MaxVertexBuffers = 4;
+	static const unsigned int MaxConstantBuffers = D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT;
+	static const unsigned int MaxShaderResources = 16;
+	static const unsigned int MaxSamplers = D3D11_COMMONSHADER_SAMPLER_SLOT_COUNT;
+
+	static std::vector<StateCache*> caches;
+
+	StateCache(ID3D11DeviceContext* context);
+	~StateCache();
+
+	ID3D11DeviceContext* context;
+	ID3D11DeviceContext1* context1;	// Null before 11.1
+	StateCacheStats stats;
+
+	ID3D11InputLayout* inputLayout;
+	D3D11_PRIMITIVE_TOPOLOGY topology;
+	ID3D11Buffer* vertexBuffers[MaxVertexBuffers];
+	UINT vertexStrides[MaxVertexBuffers];
+	UINT vertexOffsets[MaxVertexBuffers];
+	ID3D11Buffer* indexBuffer;
+	DXGI_FORMAT indexFormat;
+	unsigned int indexOffset;
+
+	ID3D11DeviceChild* shaders[SHADER_STAGE_COUNT];
+	ID3D11Buffer* constantBuffers[SHADER_STAGE_COUNT][MaxConstantBuffers];
+	unsigned int constantFirst[SHADER_STAGE_COUNT][MaxConstantBuffers];
+	unsigned int constantCount[SHADER_STAGE_COUNT][MaxConstantBuffers];
+	ID3D11ShaderResourceView* shaderResources[SHADER_STAGE_COUNT][MaxShaderResources];
+	ID3D11SamplerState* samplers[SHADER_STAGE_COUNT][MaxSamplers];
+
+	ID3D11RasterizerState* rasterizerState;
+	ID3D11DepthStencilState* depthStencilState;
+	unsigned int stencilRef;
+	ID3D11BlendState* blendState;
+	float blendFactor[4];
+	unsigned int sampleMask;
+
+	// Counts the bind; true if it can be dropped
+	bool Skip(bool same);
+};
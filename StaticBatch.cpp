@@ -0,0 +1,80 @@
+#include "StaticBatch.h"
+
+using namespace DirectX;
+
+StaticBatch::StaticBatch()
+{
+}
+
+StaticBatch::~StaticBatch()
+{
+	for (size_t i = 0; i < bakedMeshes.size(); i++)
+		delete bakedMeshes[i];
+}
+
+void StaticBatch::Add(Mesh* mesh, const XMFLOAT4X4& world, Material* material)
+{
+	Piece piece;
+	piece.mesh = mesh;
+	piece.world = world;
+	piece.material = material;
+	pieces.push_back(piece);
+}
+
+// --------------------------------------------------------
+// Positions and tangents go through the world matrix.
+// Normals go through its inverse transpose so non-uniform
+// scale doesn't bend them.  Both get renormalized.  Indices
+// are offset by however many vertices came before them.
+// --------------------------------------------------------
+void StaticBatch::Build(ID3D11Device* device, ID3D11DeviceContext* context, std::vector<Entity*>& drawables)
+{
+	std::vector<bool> baked(pieces.size(), false);
+
+	for (size_t first = 0; first < pieces.size(); first++)
+	{
+		if (baked[first])
+			continue;
+
+		Material* material = pieces[first].material;
+		std::vector<Vertex> vertices;
+		std::vector<unsigned int> indices;
+
+		for (size_t i = first; i < pieces.size(); i++)
+		{
+			if (baked[i] || pieces[i].material != material)
+				continue;
+			baked[i] = true;
+
+			const std::vector<Vertex>& srcVerts = pieces[i].mesh->GetVertices();
+			const std::vector<unsigned int>& srcIndices = pieces[i].mesh->GetIndices();
+
+			// Stored transposed, so flip it back for row vectors
+			XMMATRIX world = XMMatrixTranspose(XMLoadFloat4x4(&pieces[i].world));
+			XMMATRIX normalMatrix = XMMatrixTranspose(XMMatrixInverse(0, world));
+
+			unsigned int baseVertex = (unsigned int)vertices.size();
+			for (size_t v = 0; v < srcVerts.size(); v++)
+			{
+				Vertex vert = srcVerts[v];
+				XMStoreFloat3(&vert.Position, XMVector3TransformCoord(XMLoadFloat3(&vert.Position), world));
+				XMStoreFloat3(&vert.Normal, XMVector3Normalize(XMVector3TransformNormal(XMLoadFloat3(&vert.Normal), normalMatrix)));
+				XMStoreFloat3(&vert.Tangent, XMVector3Normalize(XMVector3TransformNormal(XMLoadFloat3(&vert.Tangent), world)));
+				vertices.push_back(vert);
+			}
+
+			for (size_t n = 0; n < srcIndices.size(); n++)
+				indices.push_back(srcIndices[n] + baseVertex);
+		}
+
+		if (vertices.empty() || indices.empty())
+			continue;
+
+		// Tangents were carried over, so skip recalculating them
+		Mesh* mesh = new Mesh(vertices, indices, device);
+		bakedMeshes.push_back(mesh);
+		drawables.push_back(new Entity(mesh, context, material));
+	}
+
+	pieces.clear();
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <d3d11.h>
+#include <DirectXMath.h>
+#include <vector>
+#include "Mesh.h"
+#include "Material.h"
+#include "Entity.h"
+
+// --------------------------------------------------------
+// Bakes geometry that never moves into one mesh per
+// material at load time.  Every vertex is moved into world
+// space on the CPU, so the result is drawn with an identity
+// transform - one draw call no matter how many pieces went
+// in.
+//
+// The batch owns the meshes it builds, so keep it around
+// for as long as the entities Build() returns.
+// --------------------------------------------------------
+class StaticBatch
+{
+public:
+	StaticBatch();
+	~StaticBatch();
+
+	// World is transposed (HLSL-ready), like every other
+	// world matrix.  The mesh has to have been made with
+	// keepCPUCopy, or it adds nothing.
+	void Add(Mesh* mesh, const DirectX::XMFLOAT4X4& world, Material* material);
+
+	// Makes one mesh and one entity for each material that was
+	// added, in the order they were first seen.  The entities
+	// belong to the caller.  Clears the list of pieces.
+	void Build(ID3D11Device* device, ID3D11DeviceContext* context, std::vector<Entity*>& drawables);
+
+	unsigned int GetPieceCount() { return (unsigned int)pieces.size(); }
+
+private:
+	struct Piece
+	{
+		Mesh* mesh;
+		DirectX::XMFLOAT4X4 world;
+		Material* material;
+	};
+
+	std::vector<Piece> pieces;
+	std::vector<Mesh*> bakedMeshes;
+};
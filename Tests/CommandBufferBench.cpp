@@ -0,0 +1,23 @@
+#include "CommandBuffer.h"
+#include <stdlib.h>
+#include <thread>
+
+// --------------------------------------------------------
+// Usage: CommandBufferBench [threads] [draws per thread]
+// --------------------------------------------------------
+int main(int argc, char* argv[])
+{
+	unsigned int threads = std::thread::hardware_concurrency();
+	unsigned int draws = 2000;
+	if (argc > 1)
+		threads = (unsigned int)atoi(argv[1]);
+	if (argc > 2)
+		draws = (unsigned int)atoi(argv[2]);
+	if (threads == 0)
+		threads = 1;
+
+	CommandBuffer::RunBenchmark(1, draws);
+	if (threads > 1)
+		CommandBuffer::RunBenchmark(threads, draws);
+	return 0;
+}
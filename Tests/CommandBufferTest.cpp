@@ -0,0 +1,195 @@
+#include "CommandBuffer.h"
+#include "NullRenderDevice.h"
+#include <stdio.h>
+#include <string.h>
+
+static int failures = 0;
+
+#define CHECK(condition) \
+	do { if (!(condition)) { printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); failures++; } } while (0)
+
+static CommandHandle Handle(uintptr_t id)
+{
+	return (CommandHandle)id;
+}
+
+// --------------------------------------------------------
+// Reads the next command, checking its type and that its
+// size covers at least the payload
+// --------------------------------------------------------
+static const void* Next(const CommandBuffer& commands, size_t& offset, CommandType type, size_t payloadSize)
+{
+	const CommandHeader* header;
+	const void* payload;
+	if (!commands.Read(offset, header, payload))
+	{
+		printf("Ran out of commands looking for type %d\n", (int)type);
+		failures++;
+		return 0;
+	}
+
+	CHECK(header->Type == (uint32_t)type);
+	CHECK(header->Size >= sizeof(CommandHeader) + payloadSize);
+	CHECK(header->Size % 8 == 0);
+	CHECK((const unsigned char*)payload == (const unsigned char*)header + sizeof(CommandHeader));
+	return header->Type == (uint32_t)type ? payload : 0;
+}
+
+// Every command type once, read back in order
+static void TestRoundTrip()
+{
+	CommandBuffer commands;
+	float constants[5] = { 1.0f, 2.0f, 3.0f, 4.0f, 5.0f };
+
+	commands.SetPipeline(Handle(1), Handle(2), Handle(3));
+	commands.SetRenderState(Handle(4), Handle(5), Handle(6), 7);
+	commands.SetVertexBuffer(1, Handle(8), 44, 16);
+	commands.SetIndexBuffer(Handle(9), 12);
+	unsigned char* patch = commands.SetConstants(COMMAND_STAGE_VERTEX, 1, constants, sizeof(constants));
+	float patched = 42.0f;
+	memcpy(patch + sizeof(float), &patched, sizeof(patched));
+	commands.SetConstantBuffer(COMMAND_STAGE_PIXEL, 0, Handle(10));
+	commands.SetTexture(COMMAND_STAGE_PIXEL, 3, Handle(11));
+	commands.SetSampler(COMMAND_STAGE_PIXEL, 1, Handle(12));
+	commands.DrawIndexed(36, 6, -2);
+	commands.DrawIndexedInstanced(36, 100, 0, 0, 250);
+
+	CHECK(commands.GetCommandCount() == 10);
+
+	size_t offset = 0;
+	const SetPipelineCommand* pipeline = (const SetPipelineCommand*)Next(commands, offset, COMMAND_SET_PIPELINE, sizeof(SetPipelineCommand));
+	CHECK(pipeline && pipeline->InputLayout == Handle(1) && pipeline->VertexShader == Handle(2) && pipeline->PixelShader == Handle(3));
+
+	const SetRenderStateCommand* state = (const SetRenderStateCommand*)Next(commands, offset, COMMAND_SET_RENDER_STATE, sizeof(SetRenderStateCommand));
+	CHECK(state && state->Blend == Handle(4) && state->DepthStencil == Handle(5) && state->Rasterizer == Handle(6) && state->StencilRef == 7);
+
+	const SetVertexBufferCommand* vb = (const SetVertexBufferCommand*)Next(commands, offset, COMMAND_SET_VERTEX_BUFFER, sizeof(SetVertexBufferCommand));
+	CHECK(vb && vb->Slot == 1 && vb->Buffer == Handle(8) && vb->Stride == 44 && vb->Offset == 16);
+
+	const SetIndexBufferCommand* ib = (const SetIndexBufferCommand*)Next(commands, offset, COMMAND_SET_INDEX_BUFFER, sizeof(SetIndexBufferCommand));
+	CHECK(ib && ib->Buffer == Handle(9) && ib->Offset == 12);
+
+	const SetConstantsCommand* cb = (const SetConstantsCommand*)Next(commands, offset, COMMAND_SET_CONSTANTS, sizeof(SetConstantsCommand) + sizeof(constants));
+	CHECK(cb && cb->Stage == COMMAND_STAGE_VERTEX && cb->Slot == 1 && cb->Size == sizeof(constants));
+	if (cb)
+	{
+		const float* data = (const float*)(cb + 1);
+		CHECK(data[0] == 1.0f && data[1] == 42.0f && data[2] == 3.0f && data[4] == 5.0f);
+	}
+
+	const SetConstantBufferCommand* external = (const SetConstantBufferCommand*)Next(commands, offset, COMMAND_SET_CONSTANT_BUFFER, sizeof(SetConstantBufferCommand));
+	CHECK(external && external->Stage == COMMAND_STAGE_PIXEL && external->Slot == 0 && external->Buffer == Handle(10));
+
+	const SetTextureCommand* texture = (const SetTextureCommand*)Next(commands, offset, COMMAND_SET_TEXTURE, sizeof(SetTextureCommand));
+	CHECK(texture && texture->Stage == COMMAND_STAGE_PIXEL && texture->Slot == 3 && texture->Texture == Handle(11));
+
+	const SetSamplerCommand* sampler = (const SetSamplerCommand*)Next(commands, offset, COMMAND_SET_SAMPLER, sizeof(SetSamplerCommand));
+	CHECK(sampler && sampler->Stage == COMMAND_STAGE_PIXEL && sampler->Slot == 1 && sampler->Sampler == Handle(12));
+
+	const DrawIndexedCommand* draw = (const DrawIndexedCommand*)Next(commands, offset, COMMAND_DRAW_INDEXED, sizeof(DrawIndexedCommand));
+	CHECK(draw && draw->IndexCount == 36 && draw->StartIndex == 6 && draw->BaseVertex == -2 && draw->InstanceCount == 1 && draw->StartInstance == 0);
+
+	const DrawIndexedCommand* instanced = (const DrawIndexedCommand*)Next(commands, offset, COMMAND_DRAW_INDEXED, sizeof(DrawIndexedCommand));
+	CHECK(instanced && instanced->IndexCount == 36 && instanced->InstanceCount == 100 && instanced->StartInstance == 250);
+
+	const CommandHeader* header;
+	const void* payload;
+	CHECK(!commands.Read(offset, header, payload));
+	CHECK(offset == commands.GetSize());
+}
+
+// Null constants are zeroed, and Reset() really empties the buffer
+static void TestConstantsAndReset()
+{
+	CommandBuffer commands;
+	unsigned char* data = commands.SetConstants(COMMAND_STAGE_PIXEL, 2, 0, 13);
+	bool zeroed = true;
+	for (int i = 0; i < 13; i++)
+		zeroed = zeroed && data[i] == 0;
+	CHECK(zeroed);
+
+	// Odd sizes still leave the next command aligned
+	commands.DrawIndexed(3);
+	size_t offset = 0;
+	Next(commands, offset, COMMAND_SET_CONSTANTS, sizeof(SetConstantsCommand) + 13);
+	Next(commands, offset, COMMAND_DRAW_INDEXED, sizeof(DrawIndexedCommand));
+
+	commands.Reset();
+	CHECK(commands.GetCommandCount() == 0);
+	CHECK(commands.GetSize() == 0);
+	offset = 0;
+	const CommandHeader* header;
+	const void* payload;
+	CHECK(!commands.Read(offset, header, payload));
+}
+
+// What the null backend counts when it plays a stream back
+static void TestNullDevice()
+{
+	NullRenderDevice device;
+
+	RenderBufferDesc desc;
+	desc.Type = RENDER_BUFFER_VERTEX;
+	desc.Size = 1024;
+	desc.Dynamic = true;
+	CommandHandle vb = device.CreateBuffer(desc, 0);
+	desc.Type = RENDER_BUFFER_INDEX;
+	desc.Size = 256;
+	desc.Dynamic = false;
+	unsigned char indices[256] = {};
+	CommandHandle ib = device.CreateBuffer(desc, indices);
+	CHECK(vb != 0 && ib != 0 && vb != ib);
+	CHECK(device.GetStats().Buffers == 2);
+	CHECK(device.GetStats().ResourceBytes == 1280);
+	CHECK(device.GetStats().UploadedBytes == 256);
+
+	device.UpdateBuffer(vb, indices, 100);
+	CHECK(device.GetStats().UploadedBytes == 356);
+
+	CommandBuffer commands;
+	commands.SetPipeline(Handle(1), Handle(2), Handle(3));
+	commands.SetVertexBuffer(0, vb, 16);
+	commands.SetIndexBuffer(ib);
+	commands.SetConstants(COMMAND_STAGE_VERTEX, 1, 0, 64);
+	commands.DrawIndexed(36);
+	commands.DrawIndexedInstanced(36, 10);
+
+	device.ResetStats();
+	device.Execute(commands);
+	device.Execute(commands);
+	const RenderDeviceStats& stats = device.GetStats();
+	CHECK(stats.CommandBuffers == 2);
+	CHECK(stats.Commands == 12);
+	CHECK(stats.Draws == 4);
+	CHECK(stats.Binds == 8);
+	CHECK(stats.UploadedBytes == 128);
+
+	device.DestroyBuffer(vb);
+	device.DestroyBuffer(vb);	// Twice is harmless
+	CHECK(device.GetStats().Buffers == 1);
+	CHECK(device.GetStats().ResourceBytes == 256);
+
+	// Freed slots get reused
+	desc.Size = 64;
+	CommandHandle reused = device.CreateBuffer(desc, 0);
+	CHECK(reused == vb);
+	device.DestroyBuffer(reused);
+	device.DestroyBuffer(ib);
+	CHECK(device.GetStats().Buffers == 0);
+	CHECK(device.GetStats().ResourceBytes == 0);
+}
+
+int main()
+{
+	TestRoundTrip();
+	TestConstantsAndReset();
+	TestNullDevice();
+
+	if (failures)
+	{
+		printf("%d checks failed\n", failures);
+		return 1;
+	}
+	printf("All command buffer checks passed\n");
+	return 0;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+// --------------------------------------------------------
+// Just enough of d3d11.h for FrameGraph to build off
+// Windows.  Every Create call is counted and hands back an
+// object that only knows how to Release() itself.
+// --------------------------------------------------------
+
+typedef unsigned int UINT;
+typedef long HRESULT;
+
+enum DXGI_FORMAT
+{
+	DXGI_FORMAT_UNKNOWN = 0,
+	DXGI_FORMAT_R32G32B32A32_FLOAT = 2,
+	DXGI_FORMAT_R16G16B16A16_FLOAT = 10,
+	DXGI_FORMAT_R32G32_FLOAT = 16,
+	DXGI_FORMAT_R8G8B8A8_UNORM = 28,
+	DXGI_FORMAT_R8G8_UNORM = 49,
+	DXGI_FORMAT_R16_FLOAT = 54,
+	DXGI_FORMAT_R8_UNORM = 61,
+};
+
+enum D3D11_USAGE
+{
+	D3D11_USAGE_DEFAULT = 0,
+};
+
+enum D3D11_BIND_FLAG
+{
+	D3D11_BIND_SHADER_RESOURCE = 0x8,
+	D3D11_BIND_RENDER_TARGET = 0x20,
+	D3D11_BIND_DEPTH_STENCIL = 0x40,
+};
+
+struct DXGI_SAMPLE_DESC
+{
+	UINT Count;
+	UINT Quality;
+};
+
+struct D3D11_TEXTURE2D_DESC
+{
+	UINT Width;
+	UINT Height;
+	UINT MipLevels;
+	UINT ArraySize;
+	DXGI_FORMAT Format;
+	DXGI_SAMPLE_DESC SampleDesc;
+	D3D11_USAGE Usage;
+	UINT BindFlags;
+	UINT CPUAccessFlags;
+	UINT MiscFlags;
+};
+
+struct FakeD3D11Object
+{
+	static inline int Live = 0;
+
+	FakeD3D11Object() { Live++; }
+	virtual ~FakeD3D11Object() { Live--; }
+	void Release() { delete this; }
+};
+
+struct ID3D11Resource : FakeD3D11Object {};
+struct ID3D11Texture2D : ID3D11Resource {};
+struct ID3D11RenderTargetView : FakeD3D11Object {};
+struct ID3D11ShaderResourceView : FakeD3D11Object {};
+struct ID3D11DepthStencilView : FakeD3D11Object {};
+
+struct ID3D11Device
+{
+	int TexturesCreated = 0;
+
+	HRESULT CreateTexture2D(const D3D11_TEXTURE2D_DESC*, const void*, ID3D11Texture2D** texture)
+	{
+		TexturesCreated++;
+		*texture = new ID3D11Texture2D();
+		return 0;
+	}
+
+	HRESULT CreateRenderTargetView(ID3D11Resource*, const void*, ID3D11RenderTargetView** view)
+	{
+		*view = new ID3D11RenderTargetView();
+		return 0;
+	}
+
+	HRESULT CreateShaderResourceView(ID3D11Resource*, const void*, ID3D11ShaderResourceView** view)
+	{
+		*view = new ID3D11ShaderResourceView();
+		return 0;
+	}
+
+	HRESULT CreateDepthStencilView(ID3D11Resource*, const void*, ID3D11DepthStencilView** view)
+	{
+		*view = new ID3D11DepthStencilView();
+		return 0;
+	}
+};
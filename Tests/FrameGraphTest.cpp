@@ -0,0 +1,121 @@
+#include "FrameGraph.h"
+#include <stdio.h>
+
+static int failures = 0;
+
+#define CHECK(condition) \
+	do { if (!(condition)) { printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); failures++; } } while (0)
+
+// --------------------------------------------------------
+// A chain of three transient targets feeding the back
+// buffer, a pass nobody reads from, and a persistent
+// history texture:
+//
+//   A: -> T1        B: T1 -> T2     C: T2 -> T3
+//   D: T3 -> BackBuffer, History    Unused: -> T4
+//
+// T1 is done with after B, so T3 can have its texture.
+// --------------------------------------------------------
+struct TestFrame
+{
+	FrameGraphResource T1, T2, T3, T4, History;
+	FrameGraphPass A, B, C, D, Unused;
+	int PassesRun = 0;
+};
+
+static void BuildFrame(FrameGraph& graph, TestFrame& frame)
+{
+	graph.Reset();
+	frame.PassesRun = 0;
+
+	FrameGraphResource backBuffer = graph.ImportTexture("BackBuffer", 0, 0, 0, true);
+
+	FrameGraphTextureDesc desc;
+	frame.T1 = graph.CreateTexture("T1", desc);
+	frame.T2 = graph.CreateTexture("T2", desc);
+	frame.T3 = graph.CreateTexture("T3", desc);
+	frame.T4 = graph.CreateTexture("T4", desc);
+
+	FrameGraphTextureDesc historyDesc;
+	historyDesc.Persistent = true;
+	frame.History = graph.CreateTexture("History", historyDesc);
+
+	auto run = [&frame]() { frame.PassesRun++; };
+	frame.A = graph.AddPass("A", run);
+	graph.Write(frame.A, frame.T1);
+	frame.B = graph.AddPass("B", run);
+	graph.Read(frame.B, frame.T1);
+	graph.Write(frame.B, frame.T2);
+	frame.C = graph.AddPass("C", run);
+	graph.Read(frame.C, frame.T2);
+	graph.Write(frame.C, frame.T3);
+	frame.D = graph.AddPass("D", run);
+	graph.Read(frame.D, frame.T3);
+	graph.Write(frame.D, backBuffer);
+	graph.Write(frame.D, frame.History);
+	frame.Unused = graph.AddPass("Unused", run);
+	graph.Write(frame.Unused, frame.T4);
+
+	graph.Compile();
+	graph.Execute();
+}
+
+static void TestPoolingAndCulling()
+{
+	ID3D11Device device;
+	{
+		FrameGraph graph(&device, 64, 32);
+		TestFrame frame;
+		BuildFrame(graph, frame);
+
+		CHECK(graph.IsCulled(frame.Unused));
+		CHECK(!graph.IsCulled(frame.A) && !graph.IsCulled(frame.D));
+		CHECK(frame.PassesRun == 4);
+		CHECK(graph.GetTexture(frame.T4) == 0);
+
+		// T1 and T3 never overlap, T1 and T2 do
+		CHECK(graph.GetTexture(frame.T1) == graph.GetTexture(frame.T3));
+		CHECK(graph.GetTexture(frame.T1) != graph.GetTexture(frame.T2));
+		CHECK(graph.GetTexture(frame.History) != graph.GetTexture(frame.T1));
+		CHECK(graph.GetTexture(frame.History) != graph.GetTexture(frame.T2));
+		CHECK(graph.WasRecreated(frame.History));
+
+		const FrameGraphStats& stats = graph.GetStats();
+		CHECK(stats.Passes == 5);
+		CHECK(stats.CulledPasses == 1);
+		CHECK(stats.TransientTextures == 3);
+		CHECK(stats.PersistentTextures == 1);
+		CHECK(stats.PooledTextures == 3);
+		CHECK(stats.PooledBytes == 3ull * 64 * 32 * 4);
+		CHECK(device.TexturesCreated == 3);
+
+		// Once warm, a frame makes nothing and keeps the history
+		ID3D11Texture2D* history = graph.GetTexture(frame.History);
+		BuildFrame(graph, frame);
+		CHECK(device.TexturesCreated == 3);
+		CHECK(graph.GetTexture(frame.History) == history);
+		CHECK(!graph.WasRecreated(frame.History));
+		CHECK(graph.GetStats().PooledTextures == 3);
+
+		// A resize starts the pool over
+		graph.Resize(32, 16);
+		BuildFrame(graph, frame);
+		CHECK(device.TexturesCreated == 6);
+		CHECK(graph.WasRecreated(frame.History));
+		CHECK(graph.GetStats().PooledBytes == 3ull * 32 * 16 * 4);
+	}
+	CHECK(FakeD3D11Object::Live == 0);
+}
+
+int main()
+{
+	TestPoolingAndCulling();
+
+	if (failures)
+	{
+		printf("%d checks failed\n", failures);
+		return 1;
+	}
+	printf("All frame graph checks passed\n");
+	return 0;
+}
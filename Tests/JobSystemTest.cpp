@@ -0,0 +1,80 @@
+#include "JobSystem.h"
+#include <stdio.h>
+
+static int failures = 0;
+
+#define CHECK(condition) \
+	do { if (!(condition)) { printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); failures++; } } while (0)
+
+// --------------------------------------------------------
+// A thread outside the pool must only run its own jobs while
+// it waits.  The one worker is kept busy, so the other
+// counter's job sits at the front of the deque, right where
+// a plain steal would find it first.
+// --------------------------------------------------------
+static void TestOutsideWaitOnlyRunsOwnJobs()
+{
+	JobSystem jobs(1);
+	std::atomic<bool> release(false);
+	std::atomic<bool> started(false);
+	std::thread::id caller = std::this_thread::get_id();
+
+	JobCounter blocker;
+	jobs.Run([&]() { started = true; while (!release) std::this_thread::yield(); }, &blocker);
+	while (!started)
+		std::this_thread::yield();
+
+	JobCounter other;
+	std::thread::id otherRanOn;
+	jobs.Run([&]() { otherRanOn = std::this_thread::get_id(); }, &other);
+
+	JobCounter mine;
+	std::thread::id mineRanOn;
+	jobs.Run([&]() { mineRanOn = std::this_thread::get_id(); }, &mine);
+
+	jobs.Wait(&mine);
+	CHECK(mineRanOn == caller);
+	CHECK(other.Value == 1);
+
+	release = true;
+	jobs.Wait(&blocker);
+	while (other.Value > 0)
+		std::this_thread::yield();
+	CHECK(otherRanOn != caller);
+}
+
+// Two outside threads fanning out on the same pool at once
+static void TestParallelForFromTwoThreads()
+{
+	JobSystem jobs(2);
+	const unsigned int count = 100000;
+	std::vector<int> a(count, 0), b(count, 0);
+
+	std::thread other([&]()
+	{
+		for (int r = 0; r < 20; r++)
+			jobs.ParallelFor(count, 64, [&](unsigned int begin, unsigned int end) { for (unsigned int i = begin; i < end; i++) a[i]++; });
+	});
+	for (int r = 0; r < 20; r++)
+		jobs.ParallelFor(count, 64, [&](unsigned int begin, unsigned int end) { for (unsigned int i = begin; i < end; i++) b[i]++; });
+	other.join();
+
+	bool allDone = true;
+	for (unsigned int i = 0; i < count; i++)
+		allDone = allDone && a[i] == 20 && b[i] == 20;
+	CHECK(allDone);
+}
+
+int main()
+{
+	TestOutsideWaitOnlyRunsOwnJobs();
+	TestParallelForFromTwoThreads();
+
+	if (failures)
+	{
+		printf("%d checks failed\n", failures);
+		return 1;
+	}
+	printf("All job system checks passed\n");
+	return 0;
+}
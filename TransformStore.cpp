@@ -0,0 +1,297 @@
+#include "TransformStore.h"
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+
+using namespace DirectX;
+
+TransformStore::TransformStore()
+{
+	count = 0;
+	builds = 0;
+}
+
+// --------------------------------------------------------
+// Adds another group of slots, filled with harmless
+// identity transforms so the SIMD loop can read them
+// --------------------------------------------------------
+void TransformStore::Grow()
+{
+	size_t size = positionX.size() + GroupSize;
+
+	positionX.resize(size, 0.0f);
+	positionY.resize(size, 0.0f);
+	positionZ.resize(size, 0.0f);
+	rotationX.resize(size, 0.0f);
+	rotationY.resize(size, 0.0f);
+	rotationZ.resize(size, 0.0f);
+	scaleX.resize(size, 1.0f);
+	scaleY.resize(size, 1.0f);
+	scaleZ.resize(size, 1.0f);
+	dirty.resize(size, 0);
+
+	XMFLOAT4X4 identity;
+	XMStoreFloat4x4(&identity, XMMatrixIdentity());
+	worlds.resize(size, identity);
+}
+
+unsigned int TransformStore::Add(const XMFLOAT3& position, const XMFLOAT3& rotation, const XMFLOAT3& scale)
+{
+	unsigned int index;
+	if (!freeIndices.empty())
+	{
+		index = freeIndices.back();
+		freeIndices.pop_back();
+	}
+	else
+	{
+		index = count++;
+		if (index >= positionX.size())
+			Grow();
+	}
+
+	SetPosition(index, position);
+	SetRotation(index, rotation);
+	SetScale(index, scale);
+	return index;
+}
+
+void TransformStore::Remove(unsigned int index)
+{
+	dirty[index] = 0;
+	freeIndices.push_back(index);
+}
+
+XMFLOAT3 TransformStore::GetPosition(unsigned int index)
+{
+	return XMFLOAT3(positionX[index], positionY[index], positionZ[index]);
+}
+
+XMFLOAT3 TransformStore::GetRotation(unsigned int index)
+{
+	return XMFLOAT3(rotationX[index], rotationY[index], rotationZ[index]);
+}
+
+XMFLOAT3 TransformStore::GetScale(unsigned int index)
+{
+	return XMFLOAT3(scaleX[index], scaleY[index], scaleZ[index]);
+}
+
+void TransformStore::SetPosition(unsigned int index, const XMFLOAT3& position)
+{
+	positionX[index] = position.x;
+	positionY[index] = position.y;
+	positionZ[index] = position.z;
+	dirty[index] = 1;
+}
+
+void TransformStore::SetRotation(unsigned int index, const XMFLOAT3& rotation)
+{
+	rotationX[index] = rotation.x;
+	rotationY[index] = rotation.y;
+	rotationZ[index] = rotation.z;
+	dirty[index] = 1;
+}
+
+void TransformStore::SetScale(unsigned int index, const XMFLOAT3& scale)
+{
+	scaleX[index] = scale.x;
+	scaleY[index] = scale.y;
+	scaleZ[index] = scale.z;
+	dirty[index] = 1;
+}
+
+const XMFLOAT4X4& TransformStore::GetWorldMatrix(unsigned int index)
+{
+	if (dirty[index])
+		BuildOne(index);
+	return worlds[index];
+}
+
+void TransformStore::BuildOne(unsigned int index)
+{
+	worlds[index] = BuildWorldMatrix(GetPosition(index), GetRotation(index), GetScale(index));
+	dirty[index] = 0;
+	builds++;
+}
+
+// --------------------------------------------------------
+// Scale, then rotate around X, Y and Z, then translate -
+// transposed for HLSL
+// --------------------------------------------------------
+XMFLOAT4X4 TransformStore::BuildWorldMatrix(const XMFLOAT3& position, const XMFLOAT3& rotation, const XMFLOAT3& scale)
+{
+	XMMATRIX matTrans = XMMatrixTranslation(position.x, position.y, position.z);
+	XMMATRIX matRot = XMMatrixRotationX(rotation.x) * XMMatrixRotationY(rotation.y) * XMMatrixRotationZ(rotation.z);
+	XMMATRIX matScale = XMMatrixScaling(scale.x, scale.y, scale.z);
+
+	XMMATRIX world = matScale * matRot * matTrans;
+
+	XMFLOAT4X4 result;
+	XMStoreFloat4x4(&result, XMMatrixTranspose(world));
+	return result;
+}
+
+// --------------------------------------------------------
+// Builds the matrices of every group of four with at least
+// one dirty transform.  Each register holds one component
+// for four entities, so the whole product is done with no
+// matrix multiplies - just the expanded terms of
+//
+//   Scale * RotX * RotY * RotZ * Translation
+//
+// Each row of the result gets a 4x4 transpose to turn four
+// entities' worth of one component back into per-entity
+// rows, which is exactly the layout of the (already
+// transposed) matrices we store.
+// --------------------------------------------------------
+unsigned int TransformStore::BuildDirty()
+{
+	unsigned int built = 0;
+	XMVECTOR lastRow = XMVectorSet(0, 0, 0, 1);
+
+	for (unsigned int i = 0; i < count; i += GroupSize)
+	{
+		// Skip whole groups that haven't changed
+		unsigned int groupDirty;
+		memcpy(&groupDirty, &dirty[i], sizeof(groupDirty));
+		if (groupDirty == 0)
+			continue;
+
+		XMVECTOR sinX, cosX, sinY, cosY, sinZ, cosZ;
+		XMVectorSinCos(&sinX, &cosX, XMLoadFloat4((const XMFLOAT4*)&rotationX[i]));
+		XMVectorSinCos(&sinY, &cosY, XMLoadFloat4((const XMFLOAT4*)&rotationY[i]));
+		XMVectorSinCos(&sinZ, &cosZ, XMLoadFloat4((const XMFLOAT4*)&rotationZ[i]));
+
+		XMVECTOR sclX = XMLoadFloat4((const XMFLOAT4*)&scaleX[i]);
+		XMVECTOR sclY = XMLoadFloat4((const XMFLOAT4*)&scaleY[i]);
+		XMVECTOR sclZ = XMLoadFloat4((const XMFLOAT4*)&scaleZ[i]);
+
+		// Rotation matrix terms
+		XMVECTOR sxsy = sinX * sinY;
+		XMVECTOR cxsy = cosX * sinY;
+
+		XMVECTOR r00 = cosY * cosZ;
+		XMVECTOR r01 = cosY * sinZ;
+		XMVECTOR r02 = -sinY;
+		XMVECTOR r10 = sxsy * cosZ - cosX * sinZ;
+		XMVECTOR r11 = sxsy * sinZ + cosX * cosZ;
+		XMVECTOR r12 = sinX * cosY;
+		XMVECTOR r20 = cxsy * cosZ + sinX * sinZ;
+		XMVECTOR r21 = cxsy * sinZ - sinX * cosZ;
+		XMVECTOR r22 = cosX * cosY;
+
+		// Column j of the world matrix (with scale applied to
+		// the rows) is row j of what we store
+		XMMATRIX row0 = XMMatrixTranspose(XMMATRIX(r00 * sclX, r10 * sclY, r20 * sclZ, XMLoadFloat4((const XMFLOAT4*)&positionX[i])));
+		XMMATRIX row1 = XMMatrixTranspose(XMMATRIX(r01 * sclX, r11 * sclY, r21 * sclZ, XMLoadFloat4((const XMFLOAT4*)&positionY[i])));
+		XMMATRIX row2 = XMMatrixTranspose(XMMATRIX(r02 * sclX, r12 * sclY, r22 * sclZ, XMLoadFloat4((const XMFLOAT4*)&positionZ[i])));
+
+		for (unsigned int k = 0; k < GroupSize; k++)
+		{
+			XMFLOAT4X4& world = worlds[i + k];
+			XMStoreFloat4((XMFLOAT4*)world.m[0], row0.r[k]);
+			XMStoreFloat4((XMFLOAT4*)world.m[1], row1.r[k]);
+			XMStoreFloat4((XMFLOAT4*)world.m[2], row2.r[k]);
+			XMStoreFloat4((XMFLOAT4*)world.m[3], lastRow);
+
+			built += dirty[i + k];
+			dirty[i + k] = 0;
+		}
+	}
+
+	builds += built;
+	return built;
+}
+
+// --------------------------------------------------------
+// Roughly what Entity looked like before its transform
+// moved in here - the transform is surrounded by pointers
+// and flags, and each one is its own allocation
+// --------------------------------------------------------
+struct BenchmarkEntity
+{
+	XMFLOAT4X4 worldMatrix;
+	void* mesh;
+	void* material;
+	bool visible;
+	void* context;
+	XMFLOAT3 position;
+	XMFLOAT3 scale;
+	float xRot;
+	float yRot;
+	float zRot;
+	bool hasPrevTick;
+	XMFLOAT3 prevPosition;
+	XMFLOAT3 prevScale;
+	XMFLOAT3 prevRotation;
+};
+
+void TransformStore::RunBenchmark(unsigned int entityCount)
+{
+	const int runs = 10;
+
+	TransformStore store;
+	std::vector<BenchmarkEntity*> entities(entityCount);
+	for (unsigned int i = 0; i < entityCount; i++)
+	{
+		XMFLOAT3 position((float)(i % 100), (float)(i / 100 % 100), (float)(i / 10000));
+		XMFLOAT3 rotation(i * 0.01f, i * 0.02f, i * 0.03f);
+		XMFLOAT3 scale(1.0f + (i % 3), 1.0f, 1.0f + (i % 5));
+
+		BenchmarkEntity* e = new BenchmarkEntity();
+		e->position = position;
+		e->scale = scale;
+		e->xRot = rotation.x;
+		e->yRot = rotation.y;
+		e->zRot = rotation.z;
+		entities[i] = e;
+
+		store.Add(position, rotation, scale);
+	}
+
+	typedef std::chrono::steady_clock Clock;
+	double perEntitySeconds = 0;
+	double batchSeconds = 0;
+
+	for (int r = 0; r < runs; r++)
+	{
+		Clock::time_point start = Clock::now();
+		for (unsigned int i = 0; i < entityCount; i++)
+		{
+			BenchmarkEntity* e = entities[i];
+			e->worldMatrix = BuildWorldMatrix(e->position, XMFLOAT3(e->xRot, e->yRot, e->zRot), e->scale);
+		}
+		Clock::time_point mid = Clock::now();
+
+		// Everything dirty, so it's the same amount of work
+		memset(&store.dirty[0], 1, store.count);
+		store.BuildDirty();
+		Clock::time_point end = Clock::now();
+
+		perEntitySeconds += std::chrono::duration<double>(mid - start).count();
+		batchSeconds += std::chrono::duration<double>(end - mid).count();
+	}
+
+	// Make sure the two actually agree
+	float maxError = 0;
+	for (unsigned int i = 0; i < entityCount; i++)
+	{
+		const float* a = &entities[i]->worldMatrix.m[0][0];
+		const float* b = &store.worlds[i].m[0][0];
+		for (int j = 0; j < 16; j++)
+		{
+			float error = a[j] > b[j] ? a[j] - b[j] : b[j] - a[j];
+			if (error > maxError)
+				maxError = error;
+		}
+	}
+
+	printf("World matrices for %u entities (average of %d runs):\n", entityCount, runs);
+	printf("  Per entity: %.3fms\n", perEntitySeconds * 1000.0 / runs);
+	printf("  SoA batch:  %.3fms (%.1fx), max difference %g\n",
+		batchSeconds * 1000.0 / runs, perEntitySeconds / batchSeconds, maxError);
+
+	for (unsigned int i = 0; i < entityCount; i++)
+		delete entities[i];
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <atomic>
+#include <vector>
+
+// --------------------------------------------------------
+// Every entity's position, rotation and scale, kept as one
+// array per component instead of inside each entity, along
+// with the world matrices built from them.
+//
+// BuildDirty() walks the arrays four entities at a time,
+// building the world matrices of any group with a changed
+// transform in SIMD registers.  Only the transform data
+// comes through the cache, not the rest of the entity.
+//
+// World matrices are transposed, ready for a cbuffer, and
+// match Entity::BuildWorldMatrix().
+// --------------------------------------------------------
+class TransformStore
+{
+public:
+	TransformStore();
+
+	// Returns the new transform's index.  Indices of removed
+	// transforms get reused.
+	unsigned int Add(const DirectX::XMFLOAT3& position, const DirectX::XMFLOAT3& rotation, const DirectX::XMFLOAT3& scale);
+	void Remove(unsigned int index);
+
+	DirectX::XMFLOAT3 GetPosition(unsigned int index);
+	DirectX::XMFLOAT3 GetRotation(unsigned int index);
+	DirectX::XMFLOAT3 GetScale(unsigned int index);
+	void SetPosition(unsigned int index, const DirectX::XMFLOAT3& position);
+	void SetRotation(unsigned int index, const DirectX::XMFLOAT3& rotation);
+	void SetScale(unsigned int index, const DirectX::XMFLOAT3& scale);
+
+	// Builds this one matrix first if BuildDirty() hasn't
+	const DirectX::XMFLOAT4X4& GetWorldMatrix(unsigned int index);
+
+	// Builds every out-of-date world matrix.  Returns how many
+	// transforms were dirty.
+	unsigned int BuildDirty();
+
+	unsigned int GetCount() { return count; }
+
+	// World matrices built by either path (on any thread)
+	// since the last reset
+	unsigned int GetBuildCount() { return builds; }
+	void ResetBuildCount() { builds = 0; }
+
+	// One transposed world matrix, built the plain way
+	static DirectX::XMFLOAT4X4 BuildWorldMatrix(const DirectX::XMFLOAT3& position, const DirectX::XMFLOAT3& rotation, const DirectX::XMFLOAT3& scale);
+
+	// Times BuildDirty() against building each matrix on its
+	// own from entity-sized structs, like Entity used to
+	static void RunBenchmark(unsigned int entityCount);
+
+private:
+	// Everything is padded to a multiple of this, so the
+	// SIMD loop never needs a scalar tail
+	static const unsigned int GroupSize = 4;
+
+	std::vector<float> positionX, positionY, positionZ;
+	std::vector<float> rotationX, rotationY, rotationZ;
+	std::vector<float> scaleX, scaleY, scaleZ;
+	std::vector<unsigned char> dirty;
+	std::vector<DirectX::XMFLOAT4X4> worlds;
+
+	std::vector<unsigned int> freeIndices;
+	unsigned int count;
+	std::atomic<unsigned int> builds;
+
+	void Grow();
+	void BuildOne(unsigned int index);
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+
+// --------------------------------------------------------
+// Lock-free single producer / single consumer triple buffer.
+//
+// The writer always has a private slot to fill, the reader
+// always has a private slot to read, and the third slot is
+// swapped between them atomically.  Neither side ever
+// waits on the other; the reader simply sees the most
+// recently published value.
+// --------------------------------------------------------
+template <typename T>
+class TripleBuffer
+{
+public:
+	TripleBuffer()
+	{
+		writeIndex = 0;
+		middle = 1;
+		readIndex = 2;
+	}
+
+	// Writer side - fill the returned slot, then Publish()
+	T& GetWriteBuffer() { return buffers[writeIndex]; }
+
+	void Publish()
+	{
+		// Hand our slot over (flagged as new) and take whatever was in the middle
+		writeIndex = middle.exchange(writeIndex | NewDataBit, std::memory_order_acq_rel) & IndexMask;
+	}
+
+	// Reader side - grabs the latest published slot, if
+	// there is one.  Returns false if nothing new arrived.
+	bool Acquire()
+	{
+		if ((middle.load(std::memory_order_relaxed) & NewDataBit) == 0)
+			return false;
+
+		readIndex = middle.exchange(readIndex, std::memory_order_acq_rel) & IndexMask;
+		return true;
+	}
+
+	const T& GetReadBuffer() const { return buffers[readIndex]; }
+
+private:
+	static const unsigned int IndexMask = 0x3;
+	static const unsigned int NewDataBit = 0x4;
+
+	T buffers[3];
+	unsigned int writeIndex;
+	unsigned int readIndex;
+	std::atomic<unsigned int> middle;
+};
@@ -1,10 +1,6 @@
 
-// Constant Buffer for external (C++) data
-cbuffer externalData : register(b0)
-{
-	matrix view;
-	matrix projection;
-};
+// View and projection come from the shared per-frame data
+#include "FrameConstants.hlsli"
 
 // Struct representing a single vertex worth of data
 struct VertexShaderInput
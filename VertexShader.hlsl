@@ -1,11 +1,9 @@
+#include "FrameConstants.hlsli"
 
-// Constant Buffer for external (C++) data
-cbuffer externalData : register(b0)
+// Per-object data - view, projection etc. live in perFrame
+cbuffer perObject : register(b1)
 {
 	matrix world;
-	matrix view;
-	matrix projection;
-
 	float2 uvScale;
 };
 